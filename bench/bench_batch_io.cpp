@@ -0,0 +1,105 @@
+// Compares the synchronous and io_uring paths of scan_dir() and
+// move_batch() on a synthetic directory, with warm and cold caches.
+//
+//   bench_batch_io [FILES] [DEPTH]
+//
+// Cold runs drop the page, dentry and inode caches through
+// /proc/sys/vm/drop_caches, which needs root; without it they are skipped.
+
+#include "../src/batch_io.hpp"
+#include "../src/core.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+static bool drop_caches() {
+    ::sync();
+    std::ofstream f("/proc/sys/vm/drop_caches");
+    f << "3\n";
+    f.flush();
+    return f.good();
+}
+
+static double scan_ms(const fs::path& dir, const ft::Config& cfg, size_t* n) {
+    const auto t0 = std::chrono::steady_clock::now();
+    *n = 0;
+    ft::scan_dir(dir, cfg, [n](const ft::ScanEntry&) {
+        (*n)++;
+        return true;
+    });
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+static double move_ms(const std::vector<ft::MoveOp>& ops, const ft::Config& cfg) {
+    const auto t0 = std::chrono::steady_clock::now();
+    std::vector<std::string> errs;
+    if (ft::move_batch(ops, cfg, &errs) != 0) {
+        std::fprintf(stderr, "move_batch: %s\n", errs.front().c_str());
+        std::exit(1);
+    }
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+int main(int argc, char** argv) {
+    const size_t files = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 20000;
+    const unsigned depth = argc > 2 ? static_cast<unsigned>(std::strtoul(argv[2], nullptr, 10)) : 256;
+
+    const fs::path dir = fs::temp_directory_path() / ("filetoggler-bench-" + std::to_string(::getpid()));
+    fs::create_directories(dir / ".disable.d");
+    for (size_t i = 0; i < files; i++) {
+        const std::string name = "entry-" + std::to_string(i) + ".conf";
+        std::ofstream(i % 10 == 0 ? dir / ".disable.d" / name : dir / name) << name;
+    }
+
+    ft::Config sync_cfg;
+    sync_cfg.verbosity = ft::Verbosity::Quiet;
+    ft::Config uring_cfg = sync_cfg;
+    uring_cfg.io_queue_depth = depth;
+
+    std::printf("files=%zu depth=%u io_uring=%s\n", files, depth, ft::BatchIo(depth).uses_uring() ? "yes" : "no (fallback)");
+
+    const bool can_drop = drop_caches();
+    for (const auto* cfg : {&sync_cfg, &uring_cfg}) {
+        const char* label = cfg->io_queue_depth ? "uring" : "sync ";
+        size_t n = 0;
+        if (can_drop) {
+            drop_caches();
+            const double cold = scan_ms(dir, *cfg, &n);
+            std::printf("scan %s cold %9.2f ms  (%zu entries)\n", label, cold, n);
+        }
+        scan_ms(dir, *cfg, &n);
+        const double warm = scan_ms(dir, *cfg, &n);
+        std::printf("scan %s warm %9.2f ms  (%zu entries)\n", label, warm, n);
+    }
+    if (!can_drop) {
+        std::printf("cold runs skipped: cannot write /proc/sys/vm/drop_caches\n");
+    }
+
+    std::vector<ft::MoveOp> disable;
+    std::vector<ft::MoveOp> enable;
+    for (size_t i = 0; i < files; i++) {
+        if (i % 10 != 0) {
+            const std::string name = "entry-" + std::to_string(i) + ".conf";
+            disable.push_back({dir / name, dir / ".disable.d" / name});
+            enable.push_back({dir / ".disable.d" / name, dir / name});
+        }
+    }
+    for (const auto* cfg : {&sync_cfg, &uring_cfg}) {
+        const char* label = cfg->io_queue_depth ? "uring" : "sync ";
+        const double d = move_ms(disable, *cfg);
+        const double e = move_ms(enable, *cfg);
+        std::printf("move %s      %9.2f ms  (%zu renames)\n", label, d + e, disable.size() + enable.size());
+    }
+
+    fs::remove_all(dir);
+    return 0;
+}
@@ -0,0 +1,106 @@
+// Filtering the names of a large directory by substring, as the GUI filter
+// box does on each keystroke: a find per row with string_view::find(),
+// against NameSearch over its packed buffer, typed one letter at a time
+// (each query narrows the previous one) and retyped from scratch.  Names
+// are kept in memory; no filesystem is involved.
+//
+//   bench_name_search [NAMES]
+
+#include "../src/core.hpp"
+#include "../src/name_search.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+constexpr int kRuns = 5;
+
+// Best of kRuns, in microseconds.  fn returns a checksum, pinned between
+// the clock reads so the work is neither dropped nor moved out of the
+// timed region.
+template <typename Fn>
+double best_us(Fn&& fn) {
+    double best = 0;
+    for (int run = 0; run < kRuns; run++) {
+        const auto t0 = std::chrono::steady_clock::now();
+        asm volatile("" ::: "memory");
+        const size_t sum = fn();
+        asm volatile("" : : "r"(sum) : "memory");
+        const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+        best = run == 0 ? us : std::min(best, us);
+    }
+    return best;
+}
+
+}
+
+int main(int argc, char** argv) {
+    const size_t n = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 300000;
+    const char* const words[] = {"plugin", "Module", "extra", "conf", "theme", "Locale", "cache", "driver"};
+
+    ft::Config cfg;
+    ft::EntryTable t(std::filesystem::path("/nowhere"), cfg);
+    const auto now = std::filesystem::file_time_type::clock::now();
+    for (size_t i = 0; i < n; i++) {
+        const std::string name = std::string(words[i % 8]) + "-" + words[(i / 8) % 8] + "-" + std::to_string(i) + ".conf";
+        t.add(name, ft::FileState::Enabled, false, 0, now);
+    }
+
+    // Folded copies for the per-row baseline, so both sides compare the
+    // same bytes.
+    std::vector<std::string> lower;
+    lower.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+        std::string s(t.name(i));
+        for (char& c : s) {
+            c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        }
+        lower.push_back(std::move(s));
+    }
+
+    ft::NameSearch search;
+    const double build = best_us([&] {
+        search.rebuild(t);
+        return search.size();
+    });
+    std::printf("rebuild %zu names: %.0f us\n\n", n, build);
+
+    std::printf("%-16s %8s %12s %12s %12s\n", "query", "rows", "per-row us", "fresh us", "typed us");
+    for (std::string_view query : {"e", "mo", "modu", "module-ca", "module-cache-1", "-12345.", "zzz"}) {
+        size_t rows = 0;
+        const double per_row = best_us([&] {
+            rows = 0;
+            for (const std::string& s : lower) {
+                rows += std::string_view(s).find(query) != std::string_view::npos;
+            }
+            return rows;
+        });
+        const double fresh = best_us([&] {
+            search.filter("");
+            return search.filter(query).size();
+        });
+        // Every prefix of the query in turn; reports the last keystroke.
+        double typed = 0;
+        best_us([&] {
+            search.filter("");
+            for (size_t len = 1; len < query.size(); len++) {
+                search.filter(query.substr(0, len));
+            }
+            const auto t0 = std::chrono::steady_clock::now();
+            const size_t sum = search.filter(query).size();
+            const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+            typed = typed == 0 ? us : std::min(typed, us);
+            return sum;
+        });
+        std::printf("%-16.*s %8zu %12.0f %12.0f %12.0f\n", static_cast<int>(query.size()), query.data(), rows, per_row,
+                    fresh, typed);
+    }
+    return 0;
+}
@@ -0,0 +1,386 @@
+// Times the everyday operations on synthetic directories and writes the
+// results as JSON, for comparing releases.
+//
+//   bench_ops [MAX_ENTRIES] [JSON_FILE]
+//
+// Flat directories of 1k, 100k and 1M entries are generated up to
+// MAX_ENTRIES (default 100000), with several disabled ratios and name
+// decorations, plus one nested tree.  The JSON goes to JSON_FILE, or to
+// stdout; a readable summary goes to stderr.
+//
+// The same listing is also timed on the in-memory backend, at
+// MAX_ENTRIES without latency and at 1k entries with a network-like
+// 200 us per stat.
+//
+// Completion and profile switching live in the CLI and GUI; they are
+// timed here through the same core calls those paths make.  Cross-device
+// moves go to $FT_BENCH_XDEV_DIR (default /dev/shm) and are skipped when
+// it is on the same device as the temp dir.
+
+#include "../src/core.hpp"
+#include "../src/fs_backend.hpp"
+#include "../src/walk.hpp"
+#include "config.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct Result {
+    std::string op;
+    std::string layout;
+    size_t entries{0};
+    double disabled_ratio{0};
+    std::string decoration;
+    size_t items{0};
+    std::vector<double> runs_ms;
+};
+
+std::vector<Result> g_results;
+
+void touch(const fs::path& p, size_t bytes = 0) {
+    const int fd = ::open(p.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::perror(p.c_str());
+        std::exit(1);
+    }
+    if (bytes > 0) {
+        const std::string data(bytes, 'x');
+        if (::write(fd, data.data(), data.size()) != static_cast<ssize_t>(data.size())) {
+            std::perror(p.c_str());
+            std::exit(1);
+        }
+    }
+    ::close(fd);
+}
+
+std::string entry_name(size_t i) {
+    return "entry-" + std::to_string(i) + ".conf";
+}
+
+ft::Config make_config(const std::string& decoration) {
+    ft::Config cfg;
+    cfg.verbosity = ft::Verbosity::Quiet;
+    if (decoration == "prefix" || decoration == "both") {
+        cfg.disabled_prefix = "__";
+    }
+    if (decoration == "suffix" || decoration == "both") {
+        cfg.disabled_suffix = ".off";
+    }
+    return cfg;
+}
+
+// Every step-th entry is disabled; step 0 disables none.
+size_t disabled_step(double ratio) {
+    return ratio > 0 ? static_cast<size_t>(1.0 / ratio + 0.5) : 0;
+}
+
+bool is_disabled(size_t i, size_t step) {
+    return step != 0 && i % step == 0;
+}
+
+void make_flat(const fs::path& dir, size_t n, double ratio, const ft::Config& cfg) {
+    fs::create_directories(dir / cfg.disabled_dir);
+    const size_t step = disabled_step(ratio);
+    for (size_t i = 0; i < n; i++) {
+        const std::string name = entry_name(i);
+        touch(is_disabled(i, step) ? dir / cfg.disabled_dir / ft::decorate_disabled_name(name, cfg) : dir / name);
+    }
+}
+
+// fanout^1 + ... + fanout^depth directories with files_per_dir files each,
+// a tenth of them disabled.
+void make_tree(const fs::path& dir, unsigned depth, unsigned fanout, size_t files_per_dir, const ft::Config& cfg) {
+    make_flat(dir, files_per_dir, 0.1, cfg);
+    if (depth == 0) {
+        return;
+    }
+    for (unsigned i = 0; i < fanout; i++) {
+        make_tree(dir / ("sub-" + std::to_string(i)), depth - 1, fanout, files_per_dir, cfg);
+    }
+}
+
+double time_ms(const std::function<void()>& fn) {
+    const auto t0 = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+void record(Result r, int runs, const std::function<size_t()>& fn) {
+    for (int i = 0; i < runs; i++) {
+        r.runs_ms.push_back(time_ms([&] { r.items = fn(); }));
+    }
+    std::sort(r.runs_ms.begin(), r.runs_ms.end());
+    std::fprintf(stderr, "%-14s %-6s %8zu entries  ratio %.2f  %-6s  %9.2f ms  (%zu items)\n",
+                 r.op.c_str(), r.layout.c_str(), r.entries, r.disabled_ratio, r.decoration.c_str(),
+                 r.runs_ms[r.runs_ms.size() / 2], r.items);
+    g_results.push_back(std::move(r));
+}
+
+void check(bool ok, const std::string& err) {
+    if (!ok) {
+        std::fprintf(stderr, "bench_ops: %s\n", err.c_str());
+        std::exit(1);
+    }
+}
+
+void bench_flat(const fs::path& root, size_t n, double ratio, const std::string& decoration) {
+    const ft::Config cfg = make_config(decoration);
+    const fs::path dir = root / ("flat-" + std::to_string(n) + "-" + std::to_string(disabled_step(ratio)) + "-" + decoration);
+    make_flat(dir, n, ratio, cfg);
+
+    Result base;
+    base.layout = "flat";
+    base.entries = n;
+    base.disabled_ratio = ratio;
+    base.decoration = decoration;
+    const int runs = n >= 1000000 ? 1 : n >= 100000 ? 3 : 10;
+
+    Result r = base;
+    r.op = "list";
+    record(r, runs, [&] { return ft::list_dir_entries_with_disabled(dir, cfg).size(); });
+
+    // Disable and re-enable a batch of enabled entries.
+    const size_t step = disabled_step(ratio);
+    std::vector<fs::path> batch;
+    for (size_t i = 0; i < n && batch.size() < 1000; i++) {
+        if (!is_disabled(i, step)) {
+            batch.push_back(dir / entry_name(i));
+        }
+    }
+    r = base;
+    r.op = "toggle_batch";
+    record(r, runs, [&] {
+        std::string err;
+        for (int pass = 0; pass < 2; pass++) {
+            for (const fs::path& p : batch) {
+                check(ft::toggle_one(p, cfg, &err), err);
+            }
+        }
+        return batch.size() * 2;
+    });
+
+    // What `ft <TAB>` does without a daemon: a names-only scan filtered by
+    // the typed prefix.
+    r = base;
+    r.op = "complete";
+    record(r, runs, [&] {
+        ft::Config names_cfg = cfg;
+        names_cfg.meta_scan = ft::MetaScan::NamesOnly;
+        size_t matches = 0;
+        ft::scan_dir(dir, names_cfg, [&](const ft::ScanEntry& e) {
+            matches += e.name.starts_with("entry-1") ? 1 : 0;
+            return true;
+        });
+        return matches;
+    });
+
+    if (n > 100000) {
+        return;
+    }
+    // Switch between two profiles the way the GUI does: scan, enable what
+    // the target leaves enabled, disable the rest of the target.
+    std::set<std::string> profiles[2];
+    for (size_t i = 0; i < n; i++) {
+        if (is_disabled(i, step)) {
+            profiles[0].insert(entry_name(i));
+        }
+        if (is_disabled(i + 1, step)) {
+            profiles[1].insert(entry_name(i));
+        }
+    }
+    r = base;
+    r.op = "profile_switch";
+    record(r, runs, [&] {
+        size_t moved = 0;
+        for (const std::set<std::string>* target : {&profiles[1], &profiles[0]}) {
+            const ft::EntryTable entries = ft::scan_dir_table(dir, cfg);
+            std::string err;
+            for (size_t i = 0; i < entries.size(); i++) {
+                const bool want = target->count(std::string(entries.name(i))) != 0;
+                if (!want && entries.state(i) == ft::FileState::Disabled) {
+                    check(ft::enable_one(entries.enabled_path(i), cfg, &err), err);
+                    moved++;
+                }
+            }
+            for (size_t i = 0; i < entries.size(); i++) {
+                const bool want = target->count(std::string(entries.name(i))) != 0;
+                if (want && entries.state(i) == ft::FileState::Enabled) {
+                    check(ft::disable_one(entries.enabled_path(i), cfg, &err), err);
+                    moved++;
+                }
+            }
+        }
+        return moved;
+    });
+}
+
+void bench_memory(size_t n, std::chrono::microseconds stat_latency) {
+    ft::MemoryBackend mem;
+    ft::Config cfg = make_config("none");
+    cfg.backend = &mem;
+    const size_t step = disabled_step(0.1);
+    const auto now = fs::file_time_type::clock::now();
+    for (size_t i = 0; i < n; i++) {
+        const std::string name = entry_name(i);
+        const fs::path dir = "/mem";
+        mem.add_file(is_disabled(i, step) ? dir / cfg.disabled_dir / name : dir / name, i, now);
+    }
+    ft::MemoryBackend::Latency latency;
+    latency.stat = stat_latency;
+    mem.set_latency(latency);
+
+    Result r;
+    r.op = "list";
+    r.layout = stat_latency.count() ? "memory+latency" : "memory";
+    r.entries = n;
+    r.disabled_ratio = 0.1;
+    r.decoration = "none";
+    record(r, n >= 1000000 || stat_latency.count() ? 1 : 3, [&] {
+        return ft::list_dir_entries_with_disabled("/mem", cfg).size();
+    });
+}
+
+void bench_tree(const fs::path& root) {
+    const ft::Config cfg = make_config("suffix");
+    const fs::path dir = root / "tree";
+    make_tree(dir, 3, 8, 20, cfg);
+
+    Result r;
+    r.op = "walk";
+    r.layout = "tree";
+    r.disabled_ratio = 0.1;
+    r.decoration = "suffix";
+    std::atomic<size_t> count{0};
+    ft::walk_tree(dir, cfg, {}, [&](const ft::EntryTable& t) { count += t.size(); });
+    r.entries = count;
+    record(r, 5, [&] {
+        std::atomic<size_t> n{0};
+        ft::walk_tree(dir, cfg, {}, [&](const ft::EntryTable& t) { n += t.size(); });
+        return n.load();
+    });
+}
+
+void bench_cross_device(const fs::path& root) {
+    const char* env = std::getenv("FT_BENCH_XDEV_DIR");
+    const fs::path other_base = env ? env : "/dev/shm";
+    struct stat a, b;
+    if (::stat(root.c_str(), &a) != 0 || ::stat(other_base.c_str(), &b) != 0 || a.st_dev == b.st_dev) {
+        std::fprintf(stderr, "cross-device moves skipped: %s is not on another device\n", other_base.c_str());
+        return;
+    }
+    const fs::path other = other_base / root.filename();
+    fs::create_directories(other);
+
+    const size_t n = 1000;
+    const ft::Config cfg = make_config("none");
+    fs::create_directories(root / "xdev");
+    for (size_t i = 0; i < n; i++) {
+        touch(root / "xdev" / entry_name(i), 4096);
+    }
+
+    Result r;
+    r.op = "move_xdev";
+    r.layout = "flat";
+    r.entries = n;
+    r.decoration = "none";
+    record(r, 3, [&] {
+        for (size_t i = 0; i < n; i++) {
+            ft::move_path(root / "xdev" / entry_name(i), other / entry_name(i), cfg);
+        }
+        for (size_t i = 0; i < n; i++) {
+            ft::move_path(other / entry_name(i), root / "xdev" / entry_name(i), cfg);
+        }
+        return n * 2;
+    });
+    fs::remove_all(other);
+}
+
+std::string json_string(const std::string& s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+        }
+        out += c;
+    }
+    return out + "\"";
+}
+
+void write_json(std::ostream& out) {
+    out << "{\"version\":" << json_string(FILETOGGLER_VERSION) << ",\"results\":[";
+    for (size_t i = 0; i < g_results.size(); i++) {
+        const Result& r = g_results[i];
+        double total = 0;
+        for (double ms : r.runs_ms) {
+            total += ms;
+        }
+        out << (i ? ",\n" : "\n") << "{\"op\":" << json_string(r.op) << ",\"layout\":" << json_string(r.layout)
+            << ",\"entries\":" << r.entries << ",\"disabled_ratio\":" << r.disabled_ratio
+            << ",\"decoration\":" << json_string(r.decoration) << ",\"items\":" << r.items
+            << ",\"runs\":" << r.runs_ms.size() << ",\"min_ms\":" << r.runs_ms.front()
+            << ",\"median_ms\":" << r.runs_ms[r.runs_ms.size() / 2]
+            << ",\"mean_ms\":" << total / static_cast<double>(r.runs_ms.size()) << "}";
+    }
+    out << "\n]}\n";
+}
+
+}
+
+int main(int argc, char** argv) {
+    const size_t max_entries = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+    const char* json_file = argc > 2 ? argv[2] : nullptr;
+
+    const fs::path root = fs::temp_directory_path() / ("filetoggler-bench-ops-" + std::to_string(::getpid()));
+    fs::create_directories(root);
+
+    for (size_t n : {size_t(1000), size_t(100000), size_t(1000000)}) {
+        if (n > max_entries) {
+            break;
+        }
+        bench_flat(root, n, 0.1, "none");
+        if (n > 100000) {
+            continue;
+        }
+        bench_flat(root, n, 0.0, "none");
+        bench_flat(root, n, 0.5, "none");
+        bench_flat(root, n, 0.1, "prefix");
+        bench_flat(root, n, 0.1, "suffix");
+        bench_flat(root, n, 0.1, "both");
+    }
+    bench_tree(root);
+    bench_cross_device(root);
+    bench_memory(max_entries, std::chrono::microseconds(0));
+    bench_memory(1000, std::chrono::microseconds(200));
+
+    fs::remove_all(root);
+
+    if (json_file) {
+        std::ofstream out(json_file);
+        write_json(out);
+        if (!out) {
+            std::fprintf(stderr, "bench_ops: cannot write %s\n", json_file);
+            return 1;
+        }
+    } else {
+        write_json(std::cout);
+    }
+    return 0;
+}
@@ -0,0 +1,348 @@
+#include "batch_io.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <string_view>
+#include <unordered_set>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define FT_HAVE_IO_URING 1
+#endif
+
+namespace fs = std::filesystem;
+
+namespace ft {
+
+namespace {
+
+fs::file_time_type to_file_time(int64_t sec, uint32_t nsec) {
+    const auto sys = std::chrono::sys_time<std::chrono::nanoseconds>(std::chrono::seconds(sec) + std::chrono::nanoseconds(nsec));
+    return std::chrono::time_point_cast<fs::file_time_type::duration>(std::chrono::file_clock::from_sys(sys));
+}
+
+void from_statx(const struct statx& stx, StatResult* r) {
+    r->error = 0;
+    r->is_dir = S_ISDIR(stx.stx_mode);
+    r->is_symlink = S_ISLNK(stx.stx_mode);
+    r->size = S_ISREG(stx.stx_mode) ? stx.stx_size : 0;
+    r->mtime = to_file_time(stx.stx_mtime.tv_sec, stx.stx_mtime.tv_nsec);
+}
+
+constexpr unsigned kStatxMask = STATX_TYPE | STATX_SIZE | STATX_MTIME;
+
+void statx_sync(const fs::path& p, int flags, StatResult* r) {
+    struct statx stx;
+    if (::statx(AT_FDCWD, p.c_str(), flags, kStatxMask, &stx) != 0) {
+        *r = StatResult{};
+        r->error = errno;
+        return;
+    }
+    from_statx(stx, r);
+}
+
+// A followed stat that failed with ENOENT may have hit a dangling symlink.
+void stat_dangling(const fs::path& p, StatResult* r) {
+    StatResult l;
+    statx_sync(p, AT_SYMLINK_NOFOLLOW, &l);
+    if (l.error == 0 && l.is_symlink) {
+        *r = l;
+    }
+}
+
+void stat_sync(const fs::path& p, bool follow, StatResult* r) {
+    statx_sync(p, follow ? 0 : AT_SYMLINK_NOFOLLOW, r);
+    if (follow && r->error == ENOENT) {
+        stat_dangling(p, r);
+    }
+}
+
+int rename_sync(const MoveOp& op) {
+    return ::rename(op.from.c_str(), op.to.c_str()) == 0 ? 0 : errno;
+}
+
+#ifdef FT_HAVE_IO_URING
+
+// Number of ops from begin on, at most max, that can run in any order:
+// io_uring does not keep submission order, so an op that names a path an
+// earlier op of the same batch names too (a file disabled and enabled
+// again, say) starts the next batch.  Paths are compared as spelled.
+unsigned independent_run(const std::vector<MoveOp>& ops, size_t begin, unsigned max) {
+    std::unordered_set<std::string_view> seen;
+    size_t end = begin;
+    while (end < ops.size() && end - begin < max) {
+        const std::string_view from = ops[end].from.native();
+        const std::string_view to = ops[end].to.native();
+        if (seen.count(from) || seen.count(to)) {
+            break;
+        }
+        seen.insert(from);
+        seen.insert(to);
+        end++;
+    }
+    return static_cast<unsigned>(end - begin);
+}
+
+#endif
+
+}
+
+#ifdef FT_HAVE_IO_URING
+
+// Just enough of an io_uring to submit a batch and wait for all of it.
+struct BatchIo::Ring {
+    int fd{-1};
+    unsigned entries{0};
+
+    void* sq_ptr{MAP_FAILED};
+    size_t sq_len{0};
+    void* cq_ptr{MAP_FAILED};
+    size_t cq_len{0};
+    struct io_uring_sqe* sqes{static_cast<struct io_uring_sqe*>(MAP_FAILED)};
+    size_t sqes_len{0};
+
+    unsigned* sq_tail{nullptr};
+    unsigned sq_mask{0};
+    unsigned* sq_array{nullptr};
+    unsigned* cq_head{nullptr};
+    unsigned* cq_tail{nullptr};
+    unsigned cq_mask{0};
+    struct io_uring_cqe* cqes{nullptr};
+
+    ~Ring() {
+        if (sqes != MAP_FAILED) {
+            ::munmap(sqes, sqes_len);
+        }
+        if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr) {
+            ::munmap(cq_ptr, cq_len);
+        }
+        if (sq_ptr != MAP_FAILED) {
+            ::munmap(sq_ptr, sq_len);
+        }
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+
+    bool init(unsigned depth) {
+        struct io_uring_params p;
+        std::memset(&p, 0, sizeof(p));
+        fd = static_cast<int>(::syscall(__NR_io_uring_setup, depth, &p));
+        if (fd < 0) {
+            return false;
+        }
+        entries = p.sq_entries;
+
+        sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+        const bool single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single) {
+            sq_len = cq_len = std::max(sq_len, cq_len);
+        }
+        sq_ptr = ::mmap(nullptr, sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sq_ptr == MAP_FAILED) {
+            return false;
+        }
+        cq_ptr = single ? sq_ptr : ::mmap(nullptr, cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cq_ptr == MAP_FAILED) {
+            return false;
+        }
+        sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+        sqes = static_cast<struct io_uring_sqe*>(::mmap(nullptr, sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+        if (sqes == MAP_FAILED) {
+            return false;
+        }
+
+        char* sq = static_cast<char*>(sq_ptr);
+        char* cq = static_cast<char*>(cq_ptr);
+        sq_tail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        sq_mask = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        sq_array = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        cq_head = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        cq_tail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        cq_mask = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        cqes = reinterpret_cast<struct io_uring_cqe*>(cq + p.cq_off.cqes);
+        return true;
+    }
+
+    // Queue n SQEs prepared by prep(sqe, i), submit them and wait for all
+    // completions; res(i, result) receives each one.  n <= entries.  False
+    // if io_uring_enter() failed; res() has then been called for the
+    // completions that had arrived, and only for those.
+    template <typename Prep, typename Res>
+    bool run(unsigned n, Prep&& prep, Res&& res) {
+        unsigned tail = std::atomic_ref<unsigned>(*sq_tail).load(std::memory_order_relaxed);
+        for (unsigned i = 0; i < n; i++) {
+            const unsigned idx = tail & sq_mask;
+            struct io_uring_sqe* sqe = &sqes[idx];
+            std::memset(sqe, 0, sizeof(*sqe));
+            prep(sqe, i);
+            sqe->user_data = i;
+            sq_array[idx] = idx;
+            tail++;
+        }
+        std::atomic_ref<unsigned>(*sq_tail).store(tail, std::memory_order_release);
+
+        unsigned done = 0;
+        auto reap = [&] {
+            unsigned head = std::atomic_ref<unsigned>(*cq_head).load(std::memory_order_relaxed);
+            const unsigned ctail = std::atomic_ref<unsigned>(*cq_tail).load(std::memory_order_acquire);
+            for (; head != ctail; head++) {
+                const struct io_uring_cqe& cqe = cqes[head & cq_mask];
+                res(static_cast<unsigned>(cqe.user_data), cqe.res);
+                done++;
+            }
+            std::atomic_ref<unsigned>(*cq_head).store(head, std::memory_order_release);
+        };
+
+        unsigned to_submit = n;
+        while (done < n) {
+            const long r = ::syscall(__NR_io_uring_enter, fd, to_submit, n - done, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (r < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                reap();
+                return false;
+            }
+            to_submit -= std::min<unsigned>(to_submit, static_cast<unsigned>(r));
+            reap();
+        }
+        return true;
+    }
+};
+
+BatchIo::BatchIo(unsigned queue_depth) : m_depth(queue_depth) {
+    if (queue_depth == 0) {
+        return;
+    }
+    auto ring = std::make_unique<Ring>();
+    if (ring->init(queue_depth)) {
+        m_ring = std::move(ring);
+    }
+}
+
+#else
+
+struct BatchIo::Ring {};
+
+BatchIo::BatchIo(unsigned queue_depth) : m_depth(queue_depth) {}
+
+#endif
+
+BatchIo::~BatchIo() = default;
+
+void BatchIo::stat(const std::vector<fs::path>& paths, std::vector<StatResult>* out, bool follow) {
+    out->assign(paths.size(), StatResult{});
+
+#ifdef FT_HAVE_IO_URING
+    if (m_ring) {
+        const uint32_t flags = follow ? 0 : AT_SYMLINK_NOFOLLOW;
+        std::vector<struct statx> bufs(std::min<size_t>(paths.size(), m_ring->entries));
+        for (size_t begin = 0; begin < paths.size(); begin += bufs.size()) {
+            const unsigned n = static_cast<unsigned>(std::min(bufs.size(), paths.size() - begin));
+            std::vector<char> completed(n, 0);
+            const bool ok = m_ring->run(n,
+                [&](struct io_uring_sqe* sqe, unsigned i) {
+                    sqe->opcode = IORING_OP_STATX;
+                    sqe->fd = AT_FDCWD;
+                    sqe->addr = reinterpret_cast<uint64_t>(paths[begin + i].c_str());
+                    sqe->len = kStatxMask;
+                    sqe->off = reinterpret_cast<uint64_t>(&bufs[i]);
+                    sqe->statx_flags = flags;
+                },
+                [&](unsigned i, int res) {
+                    completed[i] = 1;
+                    StatResult& r = (*out)[begin + i];
+                    if (res == -EINVAL || res == -EOPNOTSUPP) {
+                        // Kernel without IORING_OP_STATX.
+                        stat_sync(paths[begin + i], follow, &r);
+                    } else if (res == -ENOENT && follow) {
+                        r.error = ENOENT;
+                        stat_dangling(paths[begin + i], &r);
+                    } else if (res < 0) {
+                        r.error = -res;
+                    } else {
+                        from_statx(bufs[i], &r);
+                    }
+                });
+            if (!ok) {
+                // The ring is unusable.  Stat whatever has no result yet
+                // the plain way, and stop using it.
+                m_ring.reset();
+                for (size_t i = begin; i < paths.size(); i++) {
+                    if (i >= begin + n || !completed[i - begin]) {
+                        stat_sync(paths[i], follow, &(*out)[i]);
+                    }
+                }
+                return;
+            }
+        }
+        return;
+    }
+#endif
+
+    for (size_t i = 0; i < paths.size(); i++) {
+        stat_sync(paths[i], follow, &(*out)[i]);
+    }
+}
+
+void BatchIo::rename(const std::vector<MoveOp>& ops, std::vector<int>* errnos) {
+    errnos->assign(ops.size(), 0);
+
+#ifdef FT_HAVE_IO_URING
+    if (m_ring) {
+        for (size_t begin = 0; begin < ops.size();) {
+            const unsigned n = independent_run(ops, begin, m_ring->entries);
+            std::vector<char> completed(n, 0);
+            const bool ok = m_ring->run(n,
+                [&](struct io_uring_sqe* sqe, unsigned i) {
+                    sqe->opcode = IORING_OP_RENAMEAT;
+                    sqe->fd = AT_FDCWD;
+                    sqe->addr = reinterpret_cast<uint64_t>(ops[begin + i].from.c_str());
+                    sqe->len = static_cast<uint32_t>(AT_FDCWD);
+                    sqe->off = reinterpret_cast<uint64_t>(ops[begin + i].to.c_str());
+                    sqe->rename_flags = 0;
+                },
+                [&](unsigned i, int res) {
+                    completed[i] = 1;
+                    if (res == -EINVAL || res == -EOPNOTSUPP) {
+                        // Kernel without IORING_OP_RENAMEAT.
+                        (*errnos)[begin + i] = rename_sync(ops[begin + i]);
+                    } else {
+                        (*errnos)[begin + i] = res < 0 ? -res : 0;
+                    }
+                });
+            if (!ok) {
+                // The ring is unusable.  A rename that completed must not
+                // run again (its source is gone, so it would fail with
+                // ENOENT); the ones without a completion run the plain way.
+                m_ring.reset();
+                for (size_t i = begin; i < ops.size(); i++) {
+                    if (i >= begin + n || !completed[i - begin]) {
+                        (*errnos)[i] = rename_sync(ops[i]);
+                    }
+                }
+                return;
+            }
+            begin += n;
+        }
+        return;
+    }
+#endif
+
+    for (size_t i = 0; i < ops.size(); i++) {
+        (*errnos)[i] = rename_sync(ops[i]);
+    }
+}
+
+}
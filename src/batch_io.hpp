@@ -0,0 +1,55 @@
+#pragma once
+
+#include "core.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+namespace ft {
+
+// Result of one stat in a batch; follows symlinks like fs::status() unless
+// asked not to.
+struct StatResult {
+    int error{0};  // errno, 0 on success
+    bool is_dir{false};
+    // Same meaning as ScanEntry::is_symlink.
+    bool is_symlink{false};
+    // Size of regular files, 0 for anything else.
+    std::uintmax_t size{0};
+    std::filesystem::file_time_type mtime{};
+};
+
+// Runs batches of stat and rename calls.  With a non-zero queue depth the
+// calls are submitted to an io_uring, up to queue_depth at a time, and
+// complete with one io_uring_enter() per batch instead of one syscall each.
+// Without io_uring support (old kernel, seccomp, queue_depth 0) every call
+// is made synchronously instead; results are the same either way.
+class BatchIo {
+ public:
+    explicit BatchIo(unsigned queue_depth);
+    ~BatchIo();
+    BatchIo(const BatchIo&) = delete;
+    BatchIo& operator=(const BatchIo&) = delete;
+
+    bool uses_uring() const { return m_ring != nullptr; }
+    unsigned queue_depth() const { return m_depth; }
+
+    // out is resized to paths.size().  The paths must stay alive until the
+    // call returns.  Without follow, symlinks are not followed; with it, a
+    // symlink whose target is missing is reported as the link itself.
+    void stat(const std::vector<std::filesystem::path>& paths, std::vector<StatResult>* out, bool follow = true);
+
+    // rename(2) every op; errnos receives 0 or the errno of each op.  An
+    // op that names a path an earlier op also names runs after it.
+    void rename(const std::vector<MoveOp>& ops, std::vector<int>* errnos);
+
+ private:
+    struct Ring;
+
+    unsigned m_depth{0};
+    std::unique_ptr<Ring> m_ring;
+};
+
+}
@@ -1,13 +1,24 @@
 #include "cli.hpp"
 
 #include "core.hpp"
+#include "daemon.hpp"
+#include "fs_backend.hpp"
+#include "list_format.hpp"
+#include "stats.hpp"
+#include "walk.hpp"
 #include "config.h"
 
+#include <algorithm>
+#include <chrono>
 #include <cstdlib>
 #include <filesystem>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <regex>
 #include <set>
+#include <sstream>
 #include <string>
 #include <vector>
 
@@ -30,6 +41,35 @@ static void print_help() {
     << "    -e/--enable                  Enable the specified files\n"
     << "    -d/--disable                 Disable the specified files\n"
     << "    -t/--toggle                  Toggle between enabled/disabled for the specified files\n"
+    << "    -l/--list [DIR...]           List enabled and disabled entries of DIR (default: .)\n"
+    << "    --format tsv|nul|json        Output format for --list (default: tsv)\n"
+    << "    --state enabled|disabled     Only list entries in this state\n"
+    << "    --type file|dir|link         Only list entries of this type\n"
+    << "    -r/--recursive               Descend into subdirectories; with -e/-d/-t the\n"
+    << "                                 arguments are PATTERN [ROOT...]\n"
+    << "    --match GLOB                 Select entries whose name matches GLOB\n"
+    << "    --exclude GLOB               Skip entries whose name matches GLOB\n"
+    << "    --match-regex RE             Select entries whose name matches RE\n"
+    << "    --exclude-regex RE           Skip entries whose name matches RE\n"
+    << "                                 With selectors, -e/-d/-t take DIRs (default: .)\n"
+    << "    --manifest                   Keep an index of disabled names in the disabled\n"
+    << "                                 dir and use it instead of reading the dir\n"
+    << "    --io-uring[=DEPTH]           Batch stat and rename calls through io_uring,\n"
+    << "                                 DEPTH at a time (default: 256)\n"
+    << "    --metadata auto|full|names   Stat entries (full), only report names, or\n"
+    << "                                 report names only on network/FUSE mounts (auto)\n"
+    << "    --probe-timeout MS           Report entries whose stat takes longer than MS\n"
+    << "                                 with unknown size and mtime\n"
+    << "    --serve SOCKET               Run as a daemon serving requests on SOCKET\n"
+    << "    --no-daemon                  Do not forward commands to a running daemon\n"
+    << "    --no-dereference             Report symlinks as links instead of stat'ing\n"
+    << "                                 their targets\n"
+    << "    --stats[=json]               Print entry counts, moves, filesystem calls and\n"
+    << "                                 per-phase timings to stderr (implies --no-daemon)\n"
+    << "    --trace FILE                 Write a Chrome trace (Perfetto, chrome://tracing)\n"
+    << "                                 of the run to FILE (also: $FILETOGGLER_TRACE)\n"
+    << "    --stall-timeout MS           GUI: log the UI thread's stack when it is busy\n"
+    << "                                 for more than MS (default: 2000, 0: off)\n"
     << "    -n/--dry-run\n"
     << "    -v/--verbose\n"
     << "    -q/--quiet\n"
@@ -51,6 +91,10 @@ bool parse_args(int argc, char** argv, ParsedArgs* out, std::string* err) {
 
     ParsedArgs a;
 
+    if (const char* trace = std::getenv("FILETOGGLER_TRACE"); trace && *trace) {
+        a.trace_file = trace;
+    }
+
     // First pass: handle -C/--chdir to set working directory before parsing other paths
     for (int i = 1; i < argc; i++) {
         std::string arg = argv[i];
@@ -76,6 +120,27 @@ bool parse_args(int argc, char** argv, ParsedArgs* out, std::string* err) {
         }
     }
 
+    // Long-only options
+    enum {
+        OPT_FORMAT = 256,
+        OPT_STATE,
+        OPT_TYPE,
+        OPT_MATCH,
+        OPT_EXCLUDE,
+        OPT_MATCH_REGEX,
+        OPT_EXCLUDE_REGEX,
+        OPT_MANIFEST,
+        OPT_IO_URING,
+        OPT_METADATA,
+        OPT_PROBE_TIMEOUT,
+        OPT_SERVE,
+        OPT_NO_DAEMON,
+        OPT_NO_DEREFERENCE,
+        OPT_STATS,
+        OPT_TRACE,
+        OPT_STALL_TIMEOUT,
+    };
+
     // Define long options for getopt_long
     static struct option long_options[] = {
         {"chdir",            required_argument, nullptr, 'C'},
@@ -86,6 +151,25 @@ bool parse_args(int argc, char** argv, ParsedArgs* out, std::string* err) {
         {"enable",           no_argument,       nullptr, 'e'},
         {"disable",          no_argument,       nullptr, 'd'},
         {"toggle",           no_argument,       nullptr, 't'},
+        {"list",             no_argument,       nullptr, 'l'},
+        {"recursive",        no_argument,       nullptr, 'r'},
+        {"format",           required_argument, nullptr, OPT_FORMAT},
+        {"state",            required_argument, nullptr, OPT_STATE},
+        {"type",             required_argument, nullptr, OPT_TYPE},
+        {"match",            required_argument, nullptr, OPT_MATCH},
+        {"exclude",          required_argument, nullptr, OPT_EXCLUDE},
+        {"match-regex",      required_argument, nullptr, OPT_MATCH_REGEX},
+        {"exclude-regex",    required_argument, nullptr, OPT_EXCLUDE_REGEX},
+        {"manifest",         no_argument,       nullptr, OPT_MANIFEST},
+        {"io-uring",         optional_argument, nullptr, OPT_IO_URING},
+        {"metadata",         required_argument, nullptr, OPT_METADATA},
+        {"probe-timeout",    required_argument, nullptr, OPT_PROBE_TIMEOUT},
+        {"serve",            required_argument, nullptr, OPT_SERVE},
+        {"no-daemon",        no_argument,       nullptr, OPT_NO_DAEMON},
+        {"no-dereference",   no_argument,       nullptr, OPT_NO_DEREFERENCE},
+        {"stats",            optional_argument, nullptr, OPT_STATS},
+        {"trace",            required_argument, nullptr, OPT_TRACE},
+        {"stall-timeout",    required_argument, nullptr, OPT_STALL_TIMEOUT},
         {"dry-run",          no_argument,       nullptr, 'n'},
         {"verbose",          no_argument,       nullptr, 'v'},
         {"quiet",            no_argument,       nullptr, 'q'},
@@ -100,7 +184,7 @@ bool parse_args(int argc, char** argv, ParsedArgs* out, std::string* err) {
     opterr = 0;  // Disable automatic error printing
 
     int c;
-    while ((c = getopt_long(argc, argv, "C:o:D:p:s:edtnvqhVc:", long_options, nullptr)) != -1) {
+    while ((c = getopt_long(argc, argv, "C:o:D:p:s:edtlrnvqhVc:", long_options, nullptr)) != -1) {
         switch (c) {
             case 'C':
                 // Already handled in first pass, skip argument
@@ -137,6 +221,181 @@ bool parse_args(int argc, char** argv, ParsedArgs* out, std::string* err) {
                 a.action = Action::Toggle;
                 break;
 
+            case 'l':
+                a.list = true;
+                break;
+
+            case 'r':
+                a.recursive = true;
+                break;
+
+            case OPT_FORMAT: {
+                const std::string v = optarg;
+                if (v == "tsv") {
+                    a.list_opts.format = ListFormat::Tsv;
+                } else if (v == "nul" || v == "0") {
+                    a.list_opts.format = ListFormat::Nul;
+                } else if (v == "json") {
+                    a.list_opts.format = ListFormat::Json;
+                } else {
+                    if (err) {
+                        *err = "invalid --format (expected tsv, nul or json): " + v;
+                    }
+                    return false;
+                }
+                break;
+            }
+
+            case OPT_STATE: {
+                const std::string v = optarg;
+                if (v == "enabled") {
+                    a.list_opts.state = FileState::Enabled;
+                } else if (v == "disabled") {
+                    a.list_opts.state = FileState::Disabled;
+                } else {
+                    if (err) {
+                        *err = "invalid --state (expected enabled or disabled): " + v;
+                    }
+                    return false;
+                }
+                break;
+            }
+
+            case OPT_TYPE: {
+                const std::string v = optarg;
+                if (v == "file" || v == "f") {
+                    a.list_opts.type = EntryType::File;
+                } else if (v == "dir" || v == "d") {
+                    a.list_opts.type = EntryType::Dir;
+                } else if (v == "link" || v == "l") {
+                    a.list_opts.type = EntryType::Link;
+                } else {
+                    if (err) {
+                        *err = "invalid --type (expected file, dir or link): " + v;
+                    }
+                    return false;
+                }
+                break;
+            }
+
+            case OPT_MATCH:
+                a.select.add_match_glob(optarg);
+                break;
+
+            case OPT_EXCLUDE:
+                a.select.add_exclude_glob(optarg);
+                break;
+
+            case OPT_MATCH_REGEX:
+            case OPT_EXCLUDE_REGEX:
+                try {
+                    if (c == OPT_MATCH_REGEX) {
+                        a.select.add_match_regex(optarg);
+                    } else {
+                        a.select.add_exclude_regex(optarg);
+                    }
+                } catch (const std::regex_error& e) {
+                    if (err) {
+                        *err = std::string("invalid regex: ") + optarg + ": " + e.what();
+                    }
+                    return false;
+                }
+                break;
+
+            case OPT_MANIFEST:
+                a.cfg.manifest = true;
+                break;
+
+            case OPT_IO_URING: {
+                a.cfg.io_queue_depth = 256;
+                if (optarg) {
+                    char* end = nullptr;
+                    const unsigned long v = std::strtoul(optarg, &end, 10);
+                    if (*optarg == '\0' || *end != '\0' || v == 0 || v > 32768) {
+                        if (err) {
+                            *err = std::string("invalid --io-uring depth (expected 1-32768): ") + optarg;
+                        }
+                        return false;
+                    }
+                    a.cfg.io_queue_depth = static_cast<unsigned>(v);
+                }
+                break;
+            }
+
+            case OPT_METADATA: {
+                const std::string v = optarg;
+                if (v == "auto") {
+                    a.cfg.meta_scan = MetaScan::Auto;
+                } else if (v == "full") {
+                    a.cfg.meta_scan = MetaScan::Full;
+                } else if (v == "names") {
+                    a.cfg.meta_scan = MetaScan::NamesOnly;
+                } else {
+                    if (err) {
+                        *err = "invalid --metadata (expected auto, full or names): " + v;
+                    }
+                    return false;
+                }
+                break;
+            }
+
+            case OPT_PROBE_TIMEOUT: {
+                char* end = nullptr;
+                const unsigned long v = std::strtoul(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || v > 3600000) {
+                    if (err) {
+                        *err = std::string("invalid --probe-timeout (expected milliseconds): ") + optarg;
+                    }
+                    return false;
+                }
+                a.cfg.probe_timeout_ms = static_cast<unsigned>(v);
+                break;
+            }
+
+            case OPT_SERVE:
+                a.serve_socket = optarg;
+                break;
+
+            case OPT_NO_DAEMON:
+                a.use_daemon = false;
+                break;
+
+            case OPT_NO_DEREFERENCE:
+                a.cfg.follow_symlinks = false;
+                break;
+
+            case OPT_STATS: {
+                const std::string v = optarg ? optarg : "text";
+                if (v == "text") {
+                    a.stats = StatsFormat::Text;
+                } else if (v == "json") {
+                    a.stats = StatsFormat::Json;
+                } else {
+                    if (err) {
+                        *err = "invalid --stats format (expected text or json): " + v;
+                    }
+                    return false;
+                }
+                break;
+            }
+
+            case OPT_TRACE:
+                a.trace_file = optarg;
+                break;
+
+            case OPT_STALL_TIMEOUT: {
+                char* end = nullptr;
+                const unsigned long v = std::strtoul(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || v > 3600000) {
+                    if (err) {
+                        *err = std::string("invalid --stall-timeout (expected milliseconds): ") + optarg;
+                    }
+                    return false;
+                }
+                a.stall_timeout_ms = static_cast<unsigned>(v);
+                break;
+            }
+
             case 'n':
                 a.cfg.dry_run = true;
                 break;
@@ -193,7 +452,7 @@ bool parse_args(int argc, char** argv, ParsedArgs* out, std::string* err) {
     if (a.mode != RunMode::Completion) {
         const bool has_tty = (::isatty(STDIN_FILENO) == 1) && (::isatty(STDOUT_FILENO) == 1);
 
-        if (a.show_help || a.show_version) {
+        if (a.show_help || a.show_version || a.serve_socket || a.list || a.recursive || !a.select.empty()) {
             a.mode = RunMode::Cli;
         } else if (!has_tty) {
             a.mode = RunMode::Gui;
@@ -239,6 +498,302 @@ static int apply_action_to_files(Action act, const std::vector<std::string>& fil
     return rc;
 }
 
+// Connection to a running daemon for this command, or nullptr to work on
+// the filesystem directly.  Dry runs never go through the daemon, nor do
+// verbose runs: the moves would be logged by the daemon's process.
+static std::unique_ptr<DaemonClient> connect_daemon(const ParsedArgs& args) {
+    if (!args.use_daemon || args.cfg.dry_run || args.cfg.verbosity == Verbosity::Verbose) {
+        return nullptr;
+    }
+    return DaemonClient::connect(default_daemon_socket(), args.cfg);
+}
+
+static const char* action_request(Action act) {
+    switch (act) {
+        case Action::Enable: return "ENABLE";
+        case Action::Disable: return "DISABLE";
+        case Action::Toggle: break;
+        case Action::None: return nullptr;
+    }
+    return "TOGGLE";
+}
+
+// Same as apply_action_to_files(), but the requests are pipelined to the
+// daemon, which performs consecutive moves as one batch.
+static int apply_action_via_daemon(DaemonClient& client, Action act, const std::vector<std::string>& files, const Config& cfg) {
+    const char* req = action_request(act);
+    if (!req) {
+        return 0;
+    }
+
+    // Bound the number of requests in flight so neither side's socket
+    // buffer fills up while the other is still writing.
+    constexpr size_t kWindow = 256;
+    int rc = 0;
+    for (size_t begin = 0; begin < files.size(); begin += kWindow) {
+        const size_t end = std::min(files.size(), begin + kWindow);
+        if (client.lost()) {
+            // Nothing of this window was sent yet; do it here instead.
+            const std::vector<std::string> rest(files.begin() + static_cast<std::ptrdiff_t>(begin), files.end());
+            return std::max(rc, apply_action_to_files(act, rest, cfg));
+        }
+        for (size_t i = begin; i < end; i++) {
+            client.send({req, fs::absolute(files[i]).lexically_normal().string()});
+        }
+        for (size_t i = begin; i < end; i++) {
+            std::string e;
+            if (!client.receive(nullptr, &e)) {
+                if (cfg.verbosity != Verbosity::Quiet) {
+                    std::cerr << (client.lost() ? e + ": " + files[i] : e) << "\n";
+                }
+                rc = 2;
+            }
+        }
+    }
+    return rc;
+}
+
+static bool list_entry_selected(const ScanEntry& e, const ParsedArgs& args) {
+    const ListOptions& opts = args.list_opts;
+    if (opts.state && e.state != *opts.state) {
+        return false;
+    }
+    if (opts.type && entry_type(e) != *opts.type) {
+        return false;
+    }
+    return args.select.selects(e.name);
+}
+
+// args.cfg with the name selectors as the scan's name filter, so entries
+// they reject are never stat'ed.  Not for walks: a directory the selectors
+// reject must still be descended.
+static Config with_name_filter(const ParsedArgs& args) {
+    Config cfg = args.cfg;
+    if (!args.select.empty()) {
+        cfg.name_filter = [&select = args.select](std::string_view name) { return select.selects(name); };
+    }
+    return cfg;
+}
+
+// Printed path prefix for entries of dir: relative to the current
+// directory, except that the implicit "." is left out.
+static std::string list_prefix(const fs::path& dir) {
+    std::string prefix = dir.string();
+    if (prefix == ".") {
+        return "";
+    }
+    if (prefix.starts_with("./")) {
+        prefix.erase(0, 2);
+    }
+    if (!prefix.empty() && prefix.back() != '/') {
+        prefix += '/';
+    }
+    return prefix;
+}
+
+static std::vector<std::string> dirs_or_current(const std::vector<std::string>& dirs) {
+    if (dirs.empty()) {
+        return {"."};
+    }
+    return dirs;
+}
+
+static bool check_dir_arg(const std::string& d, const Config& cfg) {
+    std::error_code ec;
+    if (fs::is_directory(d, ec)) {
+        return true;
+    }
+    if (cfg.verbosity != Verbosity::Quiet) {
+        std::cerr << "not a directory: " << d << "\n";
+    }
+    return false;
+}
+
+// Non-recursive listing from the daemon's in-memory state.  Returns false
+// if the daemon could not answer, so the caller scans the directory itself.
+static bool list_via_daemon(DaemonClient& client, const std::string& d, const ParsedArgs& args) {
+    std::vector<std::vector<std::string>> rows;
+    client.send({"LIST", fs::absolute(d).lexically_normal().string()});
+    if (!client.receive(&rows, nullptr)) {
+        return false;
+    }
+
+    const std::string prefix = list_prefix(d);
+    for (const auto& r : rows) {
+        if (r.size() != 5) {
+            continue;
+        }
+        ScanEntry e;
+        e.state = (r[0] == "disabled") ? FileState::Disabled : FileState::Enabled;
+        e.is_dir = (r[1] == "dir");
+        e.is_symlink = (r[1] == "link");
+        if (r[2] == "-") {
+            e.meta_pending = true;
+        } else {
+            e.size = std::strtoull(r[2].c_str(), nullptr, 10);
+            e.mtime = std::chrono::file_clock::from_sys(std::chrono::sys_seconds(std::chrono::seconds(std::strtoll(r[3].c_str(), nullptr, 10))));
+        }
+        e.name = r[4];
+        if (list_entry_selected(e, args)) {
+            write_list_entry(std::cout, prefix, e, args.list_opts.format);
+        }
+    }
+    return true;
+}
+
+static int run_list(const ParsedArgs& args) {
+    std::unique_ptr<DaemonClient> client;
+    if (!args.recursive) {
+        client = connect_daemon(args);
+    }
+
+    int rc = 0;
+    std::mutex out_mu;
+    for (const auto& d : dirs_or_current(args.files)) {
+        if (!check_dir_arg(d, args.cfg)) {
+            rc = 2;
+            continue;
+        }
+
+        if (client && list_via_daemon(*client, d, args)) {
+            continue;
+        }
+
+        if (!args.recursive) {
+            const std::string prefix = list_prefix(d);
+            ft::scan_dir(d, with_name_filter(args), [&](const ScanEntry& e) {
+                if (list_entry_selected(e, args)) {
+                    write_list_entry(std::cout, prefix, e, args.list_opts.format);
+                }
+                return true;
+            });
+            continue;
+        }
+
+        WalkOptions wo;
+        wo.disabled_only = (args.list_opts.state == FileState::Disabled);
+        walk_tree(d, args.cfg, wo, [&](const EntryTable& entries) {
+            // Format the whole directory first so output of concurrent
+            // workers does not interleave mid-directory.
+            const std::string prefix = list_prefix(entries.dir());
+            std::ostringstream buf;
+            for (size_t i = 0; i < entries.size(); i++) {
+                ScanEntry e;
+                e.name = entries.name(i);
+                e.state = entries.state(i);
+                e.is_dir = entries.is_dir(i);
+                e.is_symlink = entries.is_symlink(i);
+                e.size = entries.file_size(i);
+                e.mtime = entries.mtime(i);
+                e.meta_pending = entries.meta_pending(i);
+                if (list_entry_selected(e, args)) {
+                    write_list_entry(buf, prefix, e, args.list_opts.format);
+                }
+            }
+            std::lock_guard<std::mutex> lk(out_mu);
+            std::cout << buf.str();
+        });
+    }
+    std::cout.flush();
+    return rc;
+}
+
+// Apply the action to the selected rows of one scanned directory as one
+// batch.  Returns the number of failed moves.
+static size_t apply_action_to_table(Action act, const EntryTable& entries, const NameSelector& select, const Config& cfg, std::vector<std::string>* errs) {
+    const bool want_enabled = (act == Action::Disable || act == Action::Toggle);
+    const bool want_disabled = (act == Action::Enable || act == Action::Toggle);
+
+    std::vector<MoveOp> ops;
+    bool need_disabled_dir = false;
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (!select.selects(entries.name(i))) {
+            continue;
+        }
+        if (entries.state(i) == FileState::Enabled && want_enabled) {
+            ops.push_back({entries.enabled_path(i), entries.disabled_path(i)});
+            need_disabled_dir = true;
+        } else if (entries.state(i) == FileState::Disabled && want_disabled) {
+            ops.push_back({entries.disabled_path(i), entries.enabled_path(i)});
+        }
+    }
+    if (ops.empty()) {
+        return 0;
+    }
+    if (need_disabled_dir) {
+        ensure_disabled_dir_exists(entries.dir(), cfg, cfg.dry_run);
+    }
+    return move_batch(ops, cfg, errs);
+}
+
+static void print_errors(const std::vector<std::string>& errs, const Config& cfg) {
+    if (cfg.verbosity == Verbosity::Quiet) {
+        return;
+    }
+    for (const auto& e : errs) {
+        std::cerr << e << "\n";
+    }
+}
+
+// -e/-d/-t --match/--exclude [DIR...]: one scan per directory, then one
+// batch of moves for the selected entries.
+static int run_selected_action(Action act, const ParsedArgs& args) {
+    int rc = 0;
+    for (const auto& d : dirs_or_current(args.files)) {
+        if (!check_dir_arg(d, args.cfg)) {
+            rc = 2;
+            continue;
+        }
+        EntryTable entries = scan_dir_table(d, with_name_filter(args));
+        std::vector<std::string> errs;
+        if (apply_action_to_table(act, entries, args.select, args.cfg, &errs) > 0) {
+            print_errors(errs, args.cfg);
+            rc = 2;
+        }
+    }
+    return rc;
+}
+
+// -e/-d/-t -r PATTERN [ROOT...], or -r with selectors and [ROOT...]:
+// apply the action to every selected entry anywhere below the roots.
+static int run_recursive_action(Action act, const ParsedArgs& args) {
+    NameSelector select = args.select;
+    std::vector<std::string> roots = args.files;
+    if (!select.has_match()) {
+        if (roots.empty()) {
+            if (args.cfg.verbosity != Verbosity::Quiet) {
+                std::cerr << "no pattern specified\n";
+            }
+            return 2;
+        }
+        select.add_match_glob(roots.front());
+        roots.erase(roots.begin());
+    }
+
+    const bool want_enabled = (act == Action::Disable || act == Action::Toggle);
+
+    int rc = 0;
+    std::mutex err_mu;
+    for (const auto& root : dirs_or_current(roots)) {
+        if (!check_dir_arg(root, args.cfg)) {
+            rc = 2;
+            continue;
+        }
+
+        WalkOptions wo;
+        wo.disabled_only = !want_enabled;
+        walk_tree(root, args.cfg, wo, [&](const EntryTable& entries) {
+            std::vector<std::string> errs;
+            if (apply_action_to_table(act, entries, select, args.cfg, &errs) > 0) {
+                std::lock_guard<std::mutex> lk(err_mu);
+                rc = 2;
+                print_errors(errs, args.cfg);
+            }
+        });
+    }
+    return rc;
+}
+
 int run_cli(const ParsedArgs& args) {
     if (args.show_help) {
         print_help();
@@ -249,11 +804,46 @@ int run_cli(const ParsedArgs& args) {
         return 0;
     }
 
+    if (args.serve_socket) {
+        return run_daemon(fs::absolute(*args.serve_socket), args.cfg);
+    }
+
+    if (args.stats != StatsFormat::Off && !args.cfg.stats) {
+        // The work is measured here, so it is not handed to a daemon.
+        RunStats stats;
+        CountingBackend counting(backend_of(args.cfg));
+        ParsedArgs measured = args;
+        measured.cfg.stats = &stats;
+        measured.cfg.backend = &counting;
+        measured.use_daemon = false;
+        const int rc = run_cli(measured);
+        stats.set_fs_calls(counting.counts());
+        std::cout.flush();
+        if (args.stats == StatsFormat::Json) {
+            stats.write_json(std::cerr);
+        } else {
+            stats.write_text(std::cerr);
+        }
+        return rc;
+    }
+
+    if (args.list) {
+        return run_list(args);
+    }
+
     Action act = args.action;
     if (act == Action::None) {
         act = Action::Toggle;
     }
 
+    if (args.recursive) {
+        return run_recursive_action(act, args);
+    }
+
+    if (!args.select.empty()) {
+        return run_selected_action(act, args);
+    }
+
     if (args.files.empty()) {
         if (args.cfg.verbosity != Verbosity::Quiet) {
             std::cerr << "no files specified\n";
@@ -261,6 +851,9 @@ int run_cli(const ParsedArgs& args) {
         return 2;
     }
 
+    if (auto client = connect_daemon(args)) {
+        return apply_action_via_daemon(*client, act, args.files, args.cfg);
+    }
     return apply_action_to_files(act, args.files, args.cfg);
 }
 
@@ -273,6 +866,20 @@ static std::vector<std::string> complete_options(std::string_view prefix) {
         "-e", "--enable",
         "-d", "--disable",
         "-t", "--toggle",
+        "-l", "--list",
+        "-r", "--recursive",
+        "--match", "--exclude",
+        "--match-regex", "--exclude-regex",
+        "--format",
+        "--state",
+        "--manifest",
+        "--io-uring",
+        "--metadata", "--probe-timeout",
+        "--serve", "--no-daemon",
+        "--no-dereference",
+        "--stats", "--trace",
+        "--stall-timeout",
+        "--type",
         "-n", "--dry-run",
         "-v", "--verbose",
         "-q", "--quiet",
@@ -395,19 +1002,40 @@ static std::vector<std::string> complete_files(std::string_view prefix, const Co
 
     fs::path scan_dir = parent.empty() ? base_dir : (base_dir / parent);
 
-    std::error_code ec;
-    auto entries = list_dir_entries_with_disabled(scan_dir, cfg);
-    for (const auto& e : entries) {
-        if (!leaf.empty()) {
-            if (!std::string_view(e.display_name).starts_with(leaf.string())) {
-                continue;
+    const std::string leaf_str = leaf.string();
+
+    // A running daemon answers from memory instead of rescanning.
+    if (auto client = DaemonClient::connect(default_daemon_socket(), cfg)) {
+        std::vector<std::vector<std::string>> rows;
+        client->send({"LIST", scan_dir.lexically_normal().string()});
+        if (client->receive(&rows, nullptr)) {
+            for (const auto& r : rows) {
+                if (r.size() == 5 && r[4].starts_with(leaf_str)) {
+                    out.push_back((parent.empty() ? fs::path(r[4]) : (parent / r[4])).string());
+                }
+            }
+            std::sort(out.begin(), out.end());
+            return out;
+        }
+    }
+
+    // Completion needs names only; never wait for a stat.
+    Config names_cfg = cfg;
+    names_cfg.meta_scan = MetaScan::NamesOnly;
+    ft::scan_dir(scan_dir, names_cfg, [&](const ScanEntry& e) {
+        if (!leaf_str.empty()) {
+            if (!e.name.starts_with(leaf_str)) {
+                return true;
             }
         }
 
-        fs::path candidate = parent.empty() ? fs::path(e.display_name) : (parent / e.display_name);
+        fs::path candidate = parent.empty() ? fs::path(e.name) : (parent / e.name);
         out.push_back(candidate.string());
-    }
+        return true;
+    });
 
+    // The scan yields readdir order.
+    std::sort(out.begin(), out.end());
     return out;
 }
 
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "core.hpp"
+#include "list_format.hpp"
+#include "select.hpp"
 
 #include <filesystem>
 #include <optional>
@@ -24,12 +26,42 @@ enum class Action {
     Toggle,
 };
 
+enum class StatsFormat {
+    Off,
+    Text,
+    Json,
+};
+
+struct ListOptions {
+    ListFormat format{ListFormat::Tsv};
+    std::optional<FileState> state;
+    std::optional<EntryType> type;
+};
+
 struct ParsedArgs {
     RunMode mode{RunMode::Gui};
     Action action{Action::None};
     Config cfg;
     std::vector<std::string> files;
 
+    bool list{false};
+    ListOptions list_opts;
+    bool recursive{false};
+    NameSelector select;
+
+    // --serve SOCKET: run the daemon instead of a command.
+    std::optional<fs::path> serve_socket;
+    // Commands go through a running daemon when one is reachable.
+    bool use_daemon{true};
+    // --stats[=json]: report counters and timings on stderr after the run.
+    StatsFormat stats{StatsFormat::Off};
+    // --trace FILE, or $FILETOGGLER_TRACE: write a Chrome trace of the run
+    // (see trace.hpp).
+    std::optional<fs::path> trace_file;
+    // GUI: report the UI thread when it does not get back to the event
+    // loop for this long (see watchdog.hpp); 0 disables.
+    unsigned stall_timeout_ms{2000};
+
     bool show_help{false};
     bool show_version{false};
 
@@ -1,12 +1,27 @@
 #include "core.hpp"
 
+#include "batch_io.hpp"
+#include "fs_backend.hpp"
+#include "manifest.hpp"
+#include "probe.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
+
 #include <algorithm>
+#include <atomic>
 #include <cerrno>
+#include <chrono>
+#include <condition_variable>
 #include <cstring>
 #include <filesystem>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <system_error>
-#include <unordered_map>
+
+#include <dirent.h>
+#include <sys/stat.h>
 
 namespace fs = std::filesystem;
 
@@ -19,6 +34,18 @@ static void log_line(const Config& cfg, std::string_view msg) {
     std::cerr << msg << "\n";
 }
 
+// The entry named name passes cfg.name_filter.
+static bool keeps(const Config& cfg, std::string_view name) {
+    return !cfg.name_filter || cfg.name_filter(name);
+}
+
+// The path names something, through the backend.  Symlinks are not
+// followed: a dangling link is listed, so it must toggle like any entry.
+static bool exists(const Config& cfg, const fs::path& p) {
+    FsStat st;
+    return !backend_of(cfg).stat(p, false, &st);
+}
+
 std::string decorate_disabled_name(std::string_view original, const Config& cfg) {
     std::string out;
     out.reserve(cfg.disabled_prefix.size() + original.size() + cfg.disabled_suffix.size());
@@ -29,31 +56,15 @@ std::string decorate_disabled_name(std::string_view original, const Config& cfg)
 }
 
 std::optional<std::string> undecorate_disabled_name(std::string_view decorated, const Config& cfg) {
-    if (decorated.size() < cfg.disabled_prefix.size() + cfg.disabled_suffix.size()) {
-        return std::nullopt;
-    }
-
-    if (!cfg.disabled_prefix.empty()) {
-        if (!decorated.starts_with(cfg.disabled_prefix)) {
-            return std::nullopt;
-        }
+    if (auto original = DisabledNameMatcher(cfg)(decorated)) {
+        return std::string(*original);
     }
-
-    if (!cfg.disabled_suffix.empty()) {
-        if (!decorated.ends_with(cfg.disabled_suffix)) {
-            return std::nullopt;
-        }
-    }
-
-    const size_t start = cfg.disabled_prefix.size();
-    const size_t end = decorated.size() - cfg.disabled_suffix.size();
-    if (end < start) {
-        return std::nullopt;
-    }
-
-    return std::string(decorated.substr(start, end - start));
+    return std::nullopt;
 }
 
+DisabledNameMatcher::DisabledNameMatcher(const Config& cfg)
+    : m_prefix(cfg.disabled_prefix), m_suffix(cfg.disabled_suffix) {}
+
 fs::path disabled_path_for(const fs::path& enabled_path, const Config& cfg) {
     fs::path base = enabled_path.parent_path();
     fs::path dd = base / cfg.disabled_dir;
@@ -62,13 +73,12 @@ fs::path disabled_path_for(const fs::path& enabled_path, const Config& cfg) {
 }
 
 FileState get_state(const fs::path& enabled_path, const Config& cfg) {
-    std::error_code ec;
-    if (fs::exists(enabled_path, ec)) {
+    if (exists(cfg, enabled_path)) {
         return FileState::Enabled;
     }
 
     fs::path dp = disabled_path_for(enabled_path, cfg);
-    if (fs::exists(dp, ec)) {
+    if (exists(cfg, dp)) {
         return FileState::Disabled;
     }
 
@@ -76,15 +86,15 @@ FileState get_state(const fs::path& enabled_path, const Config& cfg) {
 }
 
 void ensure_disabled_dir_exists(const fs::path& base_dir, const Config& cfg, bool dry_run) {
+    RunStats::Timer timer(cfg.stats, RunStats::Mkdir);
     fs::path dd = base_dir / cfg.disabled_dir;
-    std::error_code ec;
-    if (fs::exists(dd, ec)) {
+    if (exists(cfg, dd)) {
         return;
     }
     if (dry_run) {
         return;
     }
-    fs::create_directories(dd, ec);
+    backend_of(cfg).create_directories(dd);
 }
 
 void move_path(const fs::path& from, const fs::path& to, const Config& cfg) {
@@ -96,18 +106,31 @@ void move_path(const fs::path& from, const fs::path& to, const Config& cfg) {
         return;
     }
 
+    TraceSpan span("move_path");
+    FsBackend& backend = backend_of(cfg);
     std::error_code ec;
-    fs::rename(from, to, ec);
+    {
+        RunStats::Timer timer(cfg.stats, RunStats::Rename);
+        ec = backend.rename(from, to);
+    }
     if (!ec) {
+        if (cfg.stats) {
+            cfg.stats->count_move(false);
+        }
         return;
     }
 
     if (ec == std::errc::cross_device_link) {
-        fs::copy_file(from, to, fs::copy_options::overwrite_existing, ec);
+        RunStats::Timer timer(cfg.stats, RunStats::Copy);
+        FsStat st;
+        if (cfg.stats && !backend.stat(from, false, &st)) {
+            cfg.stats->count_move(true, st.size);
+        }
+        ec = backend.copy_file(from, to);
         if (ec) {
             throw fs::filesystem_error("copy_file", from, to, ec);
         }
-        fs::remove(from, ec);
+        ec = backend.remove(from);
         if (ec) {
             throw fs::filesystem_error("remove", from, ec);
         }
@@ -117,18 +140,157 @@ void move_path(const fs::path& from, const fs::path& to, const Config& cfg) {
     throw fs::filesystem_error("rename", from, to, ec);
 }
 
+// The manifests a batch of moves touches: per op, the directory whose
+// disabled dir it moves into or out of and the original name, and per
+// directory the disabled dir's mtime ahead of the batch.
+class BatchManifests {
+ public:
+    BatchManifests(const std::vector<MoveOp>& ops, const Config& cfg) : m_cfg(cfg) {
+        if (!cfg.manifest || cfg.dry_run || !uses_posix_backend(cfg)) {
+            return;
+        }
+        m_ops.resize(ops.size());
+        for (size_t i = 0; i < ops.size(); i++) {
+            const fs::path from_dir = ops[i].from.parent_path();
+            const fs::path to_dir = ops[i].to.parent_path();
+            Op& op = m_ops[i];
+            fs::path dir;
+            if (to_dir == from_dir / cfg.disabled_dir) {
+                dir = from_dir;
+                op.name = ops[i].from.filename().native();
+                op.disabling = true;
+            } else if (from_dir == to_dir / cfg.disabled_dir) {
+                dir = to_dir;
+                op.name = ops[i].to.filename().native();
+            } else {
+                continue;
+            }
+            auto [it, inserted] = m_dirs.try_emplace(std::move(dir));
+            if (inserted) {
+                it->second.before = disabled_dir_mtime(it->first, cfg);
+            }
+            op.dir = &*it;
+        }
+    }
+
+    void failed(size_t i) {
+        if (i < m_ops.size() && m_ops[i].dir) {
+            m_ops[i].dir->second.failed = true;
+            m_ops[i].dir = nullptr;
+        }
+    }
+
+    // Journal the moves that were made, or rebuild the manifest of a
+    // directory where one failed: it may have been half done.
+    void commit() {
+        for (const Op& op : m_ops) {
+            if (op.dir) {
+                op.dir->second.moves.push_back(op.disabling ? ManifestMove{{}, op.name} : ManifestMove{op.name, {}});
+            }
+        }
+        for (const auto& [dir, d] : m_dirs) {
+            if (d.failed) {
+                rebuild_manifest(dir, m_cfg);
+            } else {
+                update_manifest(dir, m_cfg, d.before, d.moves);
+            }
+        }
+    }
+
+ private:
+    struct Dir {
+        struct timespec before{};
+        bool failed{false};
+        std::vector<ManifestMove> moves;
+    };
+    struct Op {
+        std::pair<const fs::path, Dir>* dir{nullptr};
+        std::string name;
+        bool disabling{false};
+    };
+
+    const Config& m_cfg;
+    std::map<fs::path, Dir> m_dirs;
+    std::vector<Op> m_ops;
+};
+
+size_t move_batch(const std::vector<MoveOp>& ops, const Config& cfg, std::vector<std::string>* errs, std::vector<size_t>* failed) {
+    TraceSpan span("move_batch");
+    span.set_count(ops.size());
+    BatchManifests manifests(ops, cfg);
+    size_t nfailed = 0;
+    auto fail = [&](size_t i, const char* what) {
+        nfailed++;
+        manifests.failed(i);
+        if (errs) {
+            errs->emplace_back(what);
+        }
+        if (failed) {
+            failed->push_back(i);
+        }
+    };
+
+    if (cfg.io_queue_depth > 0 && !cfg.dry_run && uses_posix_backend(cfg)) {
+        if (cfg.verbosity == Verbosity::Verbose) {
+            for (const auto& op : ops) {
+                log_line(cfg, std::string("move: ") + op.from.string() + " -> " + op.to.string());
+            }
+        }
+        BatchIo io(cfg.io_queue_depth);
+        std::vector<int> errnos;
+        {
+            RunStats::Timer timer(cfg.stats, RunStats::RenameBatch);
+            io.rename(ops, &errnos);
+        }
+        for (size_t i = 0; i < ops.size(); i++) {
+            if (errnos[i] == 0) {
+                if (cfg.stats) {
+                    cfg.stats->count_move(false);
+                }
+                continue;
+            }
+            const std::error_code ec(errnos[i], std::generic_category());
+            try {
+                if (ec != std::errc::cross_device_link) {
+                    throw fs::filesystem_error("rename", ops[i].from, ops[i].to, ec);
+                }
+                // move_path() knows how to copy across devices; the move
+                // was logged above already.
+                Config no_log = cfg;
+                no_log.verbosity = Verbosity::Normal;
+                move_path(ops[i].from, ops[i].to, no_log);
+            } catch (const std::exception& e) {
+                fail(i, e.what());
+            }
+        }
+        manifests.commit();
+        return nfailed;
+    }
+
+    for (size_t i = 0; i < ops.size(); i++) {
+        try {
+            move_path(ops[i].from, ops[i].to, cfg);
+        } catch (const std::exception& e) {
+            fail(i, e.what());
+        }
+    }
+    manifests.commit();
+    return nfailed;
+}
+
 bool enable_one(const fs::path& enabled_path, const Config& cfg, std::string* err) {
     try {
         fs::path dp = disabled_path_for(enabled_path, cfg);
-        std::error_code ec;
-        if (!fs::exists(dp, ec)) {
+        if (!exists(cfg, dp)) {
             if (err) {
                 *err = "disabled file not found: " + dp.string();
             }
             return false;
         }
 
+        const struct timespec before = disabled_dir_mtime(enabled_path.parent_path(), cfg);
         move_path(dp, enabled_path, cfg);
+        update_manifest(enabled_path.parent_path(), cfg, before, enabled_path.filename().native(), {});
         return true;
     } catch (const std::exception& e) {
         if (err) {
@@ -140,8 +302,7 @@ bool enable_one(const fs::path& enabled_path, const Config& cfg, std::string* er
 
 bool disable_one(const fs::path& enabled_path, const Config& cfg, std::string* err) {
     try {
-        std::error_code ec;
-        if (!fs::exists(enabled_path, ec)) {
+        if (!exists(cfg, enabled_path)) {
             if (err) {
                 *err = "enabled file not found: " + enabled_path.string();
             }
@@ -151,7 +312,9 @@ bool disable_one(const fs::path& enabled_path, const Config& cfg, std::string* e
         ensure_disabled_dir_exists(enabled_path.parent_path(), cfg, cfg.dry_run);
 
         fs::path dp = disabled_path_for(enabled_path, cfg);
+        const struct timespec before = disabled_dir_mtime(enabled_path.parent_path(), cfg);
         move_path(enabled_path, dp, cfg);
+        update_manifest(enabled_path.parent_path(), cfg, before, {}, enabled_path.filename().native());
         return true;
     } catch (const std::exception& e) {
         if (err) {
@@ -188,24 +351,21 @@ bool rename_one(const fs::path& enabled_path, std::string_view new_display_name,
     if (new_enabled == enabled_path) {
         return true;
     }
+    FsBackend& backend = backend_of(cfg);
     std::error_code ec;
     switch (get_state(enabled_path, cfg)) {
         case FileState::Enabled: {
-            if (fs::exists(new_enabled, ec)) {
+            if (exists(cfg, new_enabled)) {
                 if (err) {
                     *err = "target already exists: " + new_enabled.string();
                 }
                 return false;
             }
-            fs::rename(enabled_path, new_enabled, ec);
+            ec = backend.rename(enabled_path, new_enabled);
             if (ec && ec == std::errc::cross_device_link) {
-                if (fs::is_directory(enabled_path, ec)) {
-                    fs::copy(enabled_path, new_enabled, fs::copy_options::recursive, ec);
-                } else {
-                    fs::copy_file(enabled_path, new_enabled, fs::copy_options::overwrite_existing, ec);
-                }
+                ec = backend.copy_tree(enabled_path, new_enabled);
                 if (!ec) {
-                    fs::remove_all(enabled_path, ec);
+                    ec = backend.remove_all(enabled_path);
                 }
             }
             if (ec) {
@@ -219,21 +379,18 @@ bool rename_one(const fs::path& enabled_path, std::string_view new_display_name,
         case FileState::Disabled: {
             fs::path old_disabled = disabled_path_for(enabled_path, cfg);
             fs::path new_disabled = base / cfg.disabled_dir / decorate_disabled_name(std::string(new_display_name), cfg);
-            if (fs::exists(new_disabled, ec)) {
+            if (exists(cfg, new_disabled)) {
                 if (err) {
                     *err = "target already exists: " + new_disabled.string();
                 }
                 return false;
             }
-            fs::rename(old_disabled, new_disabled, ec);
+            const struct timespec before = disabled_dir_mtime(base, cfg);
+            ec = backend.rename(old_disabled, new_disabled);
             if (ec && ec == std::errc::cross_device_link) {
-                if (fs::is_directory(old_disabled, ec)) {
-                    fs::copy(old_disabled, new_disabled, fs::copy_options::recursive, ec);
-                } else {
-                    fs::copy_file(old_disabled, new_disabled, fs::copy_options::overwrite_existing, ec);
-                }
+                ec = backend.copy_tree(old_disabled, new_disabled);
                 if (!ec) {
-                    fs::remove_all(old_disabled, ec);
+                    ec = backend.remove_all(old_disabled);
                 }
             }
             if (ec) {
@@ -242,6 +399,7 @@ bool rename_one(const fs::path& enabled_path, std::string_view new_display_name,
                 }
                 return false;
             }
+            update_manifest(base, cfg, before, enabled_path.filename().native(), new_display_name);
             return true;
         }
         case FileState::Missing:
@@ -253,119 +411,886 @@ bool rename_one(const fs::path& enabled_path, std::string_view new_display_name,
     return false;
 }
 
-static std::optional<FileEntry> build_enabled_entry(const fs::path& p, const Config& cfg) {
-    std::error_code ec;
-    fs::file_status st = fs::status(p, ec);
-    if (ec) {
-        return std::nullopt;
+static bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+void append_name_key(std::string_view name, NameOrder order, std::string* out) {
+    if (order == NameOrder::Bytes) {
+        out->append(name);
+        return;
     }
+    const bool fold = order == NameOrder::NaturalIgnoreCase;
+    size_t i = 0;
+    while (i < name.size()) {
+        const char c = name[i];
+        if (!is_digit(c)) {
+            out->push_back(fold && c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c);
+            i++;
+            continue;
+        }
+        size_t first = i;
+        size_t end = i;
+        while (end < name.size() && is_digit(name[end])) {
+            end++;
+        }
+        while (first < end && name[first] == '0') {
+            first++;
+        }
+        // The digit count takes one byte up to 254; longer counts (not in
+        // a file name, which has at most 255 bytes) spill into more bytes
+        // without breaking the order.
+        out->push_back('0');
+        size_t digits = end - first;
+        for (; digits >= 0xff; digits -= 0xff) {
+            out->push_back(static_cast<char>(0xff));
+        }
+        out->push_back(static_cast<char>(digits));
+        out->append(name.substr(first, end - first));
+        i = end;
+    }
+}
+
+EntryTable::EntryTable(fs::path dir, const Config& cfg)
+    : m_dir(std::move(dir)),
+      m_disabled_dir(cfg.disabled_dir),
+      m_disabled_prefix(cfg.disabled_prefix),
+      m_disabled_suffix(cfg.disabled_suffix),
+      m_order(cfg.name_order) {}
 
+void EntryTable::clear() {
+    m_names.clear();
+    m_name_off.clear();
+    m_name_len.clear();
+    m_keys.clear();
+    m_key_off.clear();
+    m_key_len.clear();
+    m_sizes.clear();
+    m_mtimes.clear();
+    m_flags.clear();
+}
+
+void EntryTable::reserve(size_t rows, size_t name_bytes) {
+    m_names.reserve(name_bytes);
+    m_name_off.reserve(rows);
+    m_name_len.reserve(rows);
+    if (m_order != NameOrder::Bytes) {
+        m_keys.reserve(name_bytes);
+        m_key_off.reserve(rows);
+        m_key_len.reserve(rows);
+    }
+    m_sizes.reserve(rows);
+    m_mtimes.reserve(rows);
+    m_flags.reserve(rows);
+}
+
+size_t EntryTable::add(std::string_view name, FileState state, bool is_dir, std::uintmax_t size, fs::file_time_type mtime,
+                       bool meta_pending, bool is_symlink) {
+    const size_t row = m_name_off.size();
+    m_name_off.push_back(static_cast<uint32_t>(m_names.size()));
+    m_name_len.push_back(static_cast<uint32_t>(name.size()));
+    m_names.append(name);
+    if (m_order != NameOrder::Bytes) {
+        const size_t off = m_keys.size();
+        append_name_key(name, m_order, &m_keys);
+        m_key_off.push_back(static_cast<uint32_t>(off));
+        m_key_len.push_back(static_cast<uint32_t>(m_keys.size() - off));
+    }
+    m_sizes.push_back(size);
+    m_mtimes.push_back(mtime);
+    m_flags.push_back(static_cast<uint8_t>(static_cast<uint8_t>(state) | (is_dir ? kDirBit : 0) | (meta_pending ? kPendingBit : 0)
+                                          | (is_symlink ? kLinkBit : 0)));
+    return row;
+}
+
+void EntryTable::set_state(size_t i, FileState state) {
+    m_flags[i] = static_cast<uint8_t>((m_flags[i] & ~kStateMask) | static_cast<uint8_t>(state));
+}
+
+void EntryTable::set_meta(size_t i, bool is_dir, std::uintmax_t size, fs::file_time_type mtime, bool is_symlink) {
+    constexpr uint8_t kMetaBits = kDirBit | kPendingBit | kLinkBit | kTreeSizeBit | kPartialBit;
+    m_flags[i] = static_cast<uint8_t>((m_flags[i] & ~kMetaBits) | (is_dir ? kDirBit : 0) | (is_symlink ? kLinkBit : 0));
+    m_sizes[i] = size;
+    m_mtimes[i] = mtime;
+}
+
+void EntryTable::set_tree_size(size_t i, std::uintmax_t size, bool complete) {
+    m_flags[i] = static_cast<uint8_t>((m_flags[i] & ~kPartialBit) | kTreeSizeBit | (complete ? 0 : kPartialBit));
+    m_sizes[i] = size;
+}
+
+fs::path EntryTable::enabled_path(size_t i) const {
+    return m_dir / name(i);
+}
+
+fs::path EntryTable::disabled_path(size_t i) const {
+    std::string decorated;
+    decorated.reserve(m_disabled_prefix.size() + m_name_len[i] + m_disabled_suffix.size());
+    decorated.append(m_disabled_prefix);
+    decorated.append(name(i));
+    decorated.append(m_disabled_suffix);
+    return m_dir / m_disabled_dir / decorated;
+}
+
+FileEntry EntryTable::entry(size_t i) const {
     FileEntry e;
-    e.display_name = p.filename().string();
-    e.enabled_path = p;
-    e.disabled_path = disabled_path_for(p, cfg);
-    e.is_dir = fs::is_directory(st);
-    e.state = FileState::Enabled;
-    if (!e.is_dir) {
-        e.size = fs::file_size(p, ec);
-        if (ec) {
-            e.size = 0;
+    e.display_name = std::string(name(i));
+    e.enabled_path = enabled_path(i);
+    e.disabled_path = disabled_path(i);
+    e.mtime = m_mtimes[i];
+    e.size = m_sizes[i];
+    e.is_dir = is_dir(i);
+    e.is_symlink = is_symlink(i);
+    e.state = state(i);
+    return e;
+}
+
+template <typename T>
+static std::vector<T> gather(const std::vector<T>& src, const std::vector<uint32_t>& order) {
+    std::vector<T> out;
+    out.reserve(order.size());
+    for (uint32_t k : order) {
+        out.push_back(src[k]);
+    }
+    return out;
+}
+
+// Compact an arena of slices once more than half of it belongs to
+// dropped rows.
+static void compact_arena(std::string* arena, std::vector<uint32_t>* off, const std::vector<uint32_t>& len) {
+    size_t live = 0;
+    for (uint32_t n : len) {
+        live += n;
+    }
+    if (live * 2 < arena->size()) {
+        std::string packed;
+        packed.reserve(live);
+        for (size_t i = 0; i < off->size(); i++) {
+            const uint32_t at = static_cast<uint32_t>(packed.size());
+            packed.append(*arena, (*off)[i], len[i]);
+            (*off)[i] = at;
         }
+        *arena = std::move(packed);
     }
-    e.mtime = fs::last_write_time(p, ec);
-    return e;
 }
 
-static std::optional<FileEntry> build_disabled_entry(const fs::path& disabled_file, const std::string& original_name, const fs::path& dir, const Config&) {
-    std::error_code ec;
-    fs::file_status st = fs::status(disabled_file, ec);
-    if (ec) {
-        return std::nullopt;
+void EntryTable::permute(const std::vector<uint32_t>& order) {
+    m_name_off = gather(m_name_off, order);
+    m_name_len = gather(m_name_len, order);
+    m_sizes = gather(m_sizes, order);
+    m_mtimes = gather(m_mtimes, order);
+    m_flags = gather(m_flags, order);
+    compact_arena(&m_names, &m_name_off, m_name_len);
+    if (m_order != NameOrder::Bytes) {
+        m_key_off = gather(m_key_off, order);
+        m_key_len = gather(m_key_len, order);
+        compact_arena(&m_keys, &m_key_off, m_key_len);
     }
+}
 
-    FileEntry e;
-    e.display_name = original_name;
-    e.enabled_path = dir / original_name;
-    e.disabled_path = disabled_file;
-    e.is_dir = fs::is_directory(st);
-    e.state = FileState::Disabled;
-    if (!e.is_dir) {
-        e.size = fs::file_size(disabled_file, ec);
-        if (ec) {
-            e.size = 0;
+void EntryTable::sort_by_name() {
+    const bool bytes = m_order == NameOrder::Bytes;
+    const std::string_view arena = bytes ? std::string_view(m_names) : std::string_view(m_keys);
+    const std::vector<uint32_t>& off = bytes ? m_name_off : m_key_off;
+    const std::vector<uint32_t>& len = bytes ? m_name_len : m_key_len;
+
+    // Most comparisons are settled by the first 16 bytes of the keys, read
+    // big-endian into two integers once per row, without touching the
+    // arena.
+    constexpr size_t kHead = 16;
+    struct Item {
+        uint64_t hi;
+        uint64_t lo;
+        uint32_t row;
+    };
+    std::vector<Item> items(size());
+    for (size_t i = 0; i < items.size(); i++) {
+        uint64_t head[2] = {0, 0};
+        for (size_t k = 0; k < kHead; k++) {
+            head[k / 8] = (head[k / 8] << 8) | (k < len[i] ? static_cast<unsigned char>(arena[off[i] + k]) : 0u);
         }
+        items[i] = {head[0], head[1], static_cast<uint32_t>(i)};
     }
-    e.mtime = fs::last_write_time(disabled_file, ec);
-    return e;
+    std::sort(items.begin(), items.end(), [&](const Item& a, const Item& b) {
+        if (a.hi != b.hi) {
+            return a.hi < b.hi;
+        }
+        if (a.lo != b.lo) {
+            return a.lo < b.lo;
+        }
+        // Equal heads: the rest decides, unless a key is shorter than the
+        // head and padded (then compare it whole).
+        const size_t skip = std::min<size_t>({kHead, len[a.row], len[b.row]});
+        const int c = arena.substr(off[a.row] + skip, len[a.row] - skip).compare(arena.substr(off[b.row] + skip, len[b.row] - skip));
+        if (c != 0 || bytes) {
+            return c < 0;
+        }
+        return name(a.row) < name(b.row);
+    });
+
+    std::vector<uint32_t> order(items.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = items[i].row;
+    }
+    permute(order);
 }
 
-std::vector<FileEntry> list_dir_entries_with_disabled(const fs::path& dir, const Config& cfg) {
-    std::vector<FileEntry> out;
+void EntryTable::reverse() {
+    std::reverse(m_name_off.begin(), m_name_off.end());
+    std::reverse(m_name_len.begin(), m_name_len.end());
+    std::reverse(m_sizes.begin(), m_sizes.end());
+    std::reverse(m_mtimes.begin(), m_mtimes.end());
+    std::reverse(m_flags.begin(), m_flags.end());
+    std::reverse(m_key_off.begin(), m_key_off.end());
+    std::reverse(m_key_len.begin(), m_key_len.end());
+}
+
+size_t EntryTable::memory_usage() const {
+    return m_names.capacity()
+        + m_name_off.capacity() * sizeof(uint32_t)
+        + m_name_len.capacity() * sizeof(uint32_t)
+        + m_keys.capacity()
+        + m_key_off.capacity() * sizeof(uint32_t)
+        + m_key_len.capacity() * sizeof(uint32_t)
+        + m_sizes.capacity() * sizeof(std::uintmax_t)
+        + m_mtimes.capacity() * sizeof(fs::file_time_type)
+        + m_flags.capacity() * sizeof(uint8_t);
+}
 
-    std::unordered_map<std::string, size_t> by_name;
+void EntryNameIndex::clear() {
+    m_rows.clear();
+    m_sorted_names.clear();
+    m_sorted_rows.clear();
+    m_block_min.clear();
+}
+
+void EntryNameIndex::rebuild(const EntryTable& table) {
+    clear();
+    const size_t n = table.size();
+    m_rows.reserve(n);
+    m_sorted_rows.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        m_rows.emplace(table.name(i), static_cast<uint32_t>(i));
+        m_sorted_rows[i] = static_cast<uint32_t>(i);
+    }
+    std::sort(m_sorted_rows.begin(), m_sorted_rows.end(), [&](uint32_t a, uint32_t b) {
+        return table.name(a) < table.name(b);
+    });
+    m_sorted_names.reserve(n);
+    for (uint32_t row : m_sorted_rows) {
+        m_sorted_names.push_back(table.name(row));
+    }
+    m_block_min.reserve(n / kBlock + 1);
+    for (size_t b = 0; b < n; b += kBlock) {
+        const auto end = m_sorted_rows.begin() + static_cast<std::ptrdiff_t>(std::min(n, b + kBlock));
+        m_block_min.push_back(*std::min_element(m_sorted_rows.begin() + static_cast<std::ptrdiff_t>(b), end));
+    }
+}
+
+size_t EntryNameIndex::find(std::string_view name) const {
+    auto it = m_rows.find(name);
+    return it == m_rows.end() ? npos : it->second;
+}
+
+size_t EntryNameIndex::first_with_prefix(std::string_view prefix) const {
+    const auto begin = std::lower_bound(m_sorted_names.begin(), m_sorted_names.end(), prefix);
+    const auto end = std::partition_point(begin, m_sorted_names.end(), [&](std::string_view n) {
+        return n.starts_with(prefix);
+    });
+    size_t lo = static_cast<size_t>(begin - m_sorted_names.begin());
+    const size_t hi = static_cast<size_t>(end - m_sorted_names.begin());
+    if (lo == hi) {
+        return npos;
+    }
+
+    uint32_t best = UINT32_MAX;
+    // Partial block at the start, whole blocks, partial block at the end.
+    for (; lo < hi && lo % kBlock != 0; lo++) {
+        best = std::min(best, m_sorted_rows[lo]);
+    }
+    for (; lo + kBlock <= hi; lo += kBlock) {
+        best = std::min(best, m_block_min[lo / kBlock]);
+    }
+    for (; lo < hi; lo++) {
+        best = std::min(best, m_sorted_rows[lo]);
+    }
+    return best;
+}
+
+struct EntryMeta {
+    bool is_dir{false};
+    bool is_symlink{false};
+    std::uintmax_t size{0};
+    fs::file_time_type mtime{};
+};
+
+// One stat(2), or lstat(2) without follow.  A symlink whose target is
+// missing is reported as the link itself rather than dropped.
+static bool read_entry_meta(FsBackend& backend, const fs::path& p, bool follow, EntryMeta* out) {
+    FsStat st;
+    if (!follow || backend.stat(p, true, &st)) {
+        if (backend.stat(p, false, &st) || (follow && st.type != FsType::Symlink)) {
+            return false;
+        }
+    }
+
+    out->is_symlink = st.type == FsType::Symlink;
+    out->is_dir = st.type == FsType::Dir;
+    out->size = st.size;
+    out->mtime = st.mtime;
+    return true;
+}
+
+// An enabled entry with a disabled copy shows the copy's mtime and size.
+static void merge_disabled_copy(FsBackend& backend, const fs::path& dp, bool follow, EntryMeta* m) {
+    EntryMeta d;
+    const bool ok = read_entry_meta(backend, dp, follow, &d);
+    m->mtime = ok ? d.mtime : fs::file_time_type::min();
+    if (!m->is_dir) {
+        m->size = ok ? d.size : 0;
+    }
+}
 
+// Undecorated names found in the disabled dir, packed into one buffer and
+// sorted for binary search.
+class DisabledNameSet {
+ public:
+    void add(std::string_view name) {
+        m_rows.push_back({static_cast<uint32_t>(m_buf.size()), static_cast<uint32_t>(name.size()), false});
+        m_buf.append(name);
+    }
+
+    void seal() {
+        std::sort(m_rows.begin(), m_rows.end(), [this](const Row& a, const Row& b) {
+            return name(a) < name(b);
+        });
+    }
+
+    bool contains(std::string_view n) const { return find(n) != kNotFound; }
+
+    // Marks the name as matched by an enabled entry.
+    bool take(std::string_view n) {
+        const size_t i = find(n);
+        if (i == kNotFound) {
+            return false;
+        }
+        m_rows[i].matched = true;
+        return true;
+    }
+
+    template <typename Fn>
+    bool for_each_unmatched(Fn&& fn) const {
+        for (const Row& r : m_rows) {
+            if (!r.matched && !fn(name(r))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool empty() const { return m_rows.empty(); }
+
+ private:
+    struct Row {
+        uint32_t off;
+        uint32_t len;
+        bool matched;
+    };
+
+    static constexpr size_t kNotFound = static_cast<size_t>(-1);
+
+    std::string_view name(const Row& r) const { return std::string_view(m_buf).substr(r.off, r.len); }
+
+    size_t find(std::string_view n) const {
+        auto it = std::lower_bound(m_rows.begin(), m_rows.end(), n, [this](const Row& r, std::string_view key) {
+            return name(r) < key;
+        });
+        return (it == m_rows.end() || name(*it) != n) ? kNotFound : static_cast<size_t>(it - m_rows.begin());
+    }
+
+    std::string m_buf;
+    std::vector<Row> m_rows;
+};
+
+// Undecorated names of dir's disabled entries, from the manifest when
+// there is one, else from the disabled dir itself.
+static void read_disabled_names(const fs::path& dir, const Config& cfg, DisabledNameSet* disabled) {
+    const fs::path dd = dir / cfg.disabled_dir;
+    DisabledManifest manifest;
+    if (uses_posix_backend(cfg) && load_manifest(dir, cfg, &manifest)) {
+        for (size_t i = 0; i < manifest.size(); i++) {
+            if (keeps(cfg, manifest.name(i))) {
+                disabled->add(manifest.name(i));
+            }
+        }
+        disabled->seal();
+        return;
+    }
+    const std::error_code ec = DisabledNameMatcher(cfg).dispatch([&](const auto& undecorate) {
+        return backend_of(cfg).read_dir(dd, [&](std::string_view name, FsType) {
+            if (is_manifest_name(name)) {
+                return true;
+            }
+            if (const auto original = undecorate(name); original && keeps(cfg, *original)) {
+                disabled->add(*original);
+            }
+            return true;
+        });
+    });
+    if (!ec) {
+        disabled->seal();
+    }
+}
+
+// scan_dir() with the stat calls of up to cfg.io_queue_depth entries
+// issued as one BatchIo batch.  Entries are visited batch by batch, in the
+// same order and with the same metadata as the one-at-a-time scan.
+static bool scan_dir_batched(const fs::path& dir, const Config& cfg, DisabledNameSet& disabled, const ScanVisitor& visit) {
     std::error_code ec;
+    const fs::path dd = dir / cfg.disabled_dir;
+    BatchIo io(cfg.io_queue_depth);
+    const bool follow = cfg.follow_symlinks;
+
+    // Per pending entry: its name, the index of its own stat and, for an
+    // enabled entry with a disabled copy, the index of the copy's stat.
+    struct Pending {
+        std::string name;
+        size_t stat;
+        size_t disabled_stat;
+        FileState state;
+    };
+    constexpr size_t kNone = static_cast<size_t>(-1);
+    std::vector<Pending> pending;
+    std::vector<fs::path> paths;
+    std::vector<StatResult> results;
+
+    auto flush = [&]() {
+        io.stat(paths, &results, follow);
+        bool more = true;
+        for (const Pending& pe : pending) {
+            const StatResult& r = results[pe.stat];
+            if (r.error != 0) {
+                // Like the one-at-a-time scan: a disabled copy is then
+                // still listed, from the unmatched names below.
+                continue;
+            }
+            ScanEntry e;
+            e.name = pe.name;
+            e.state = pe.state;
+            e.is_dir = r.is_dir;
+            e.is_symlink = r.is_symlink;
+            e.size = r.size;
+            e.mtime = r.mtime;
+            if (pe.disabled_stat != kNone) {
+                const StatResult& d = results[pe.disabled_stat];
+                disabled.take(pe.name);
+                e.state = FileState::Disabled;
+                e.mtime = d.error ? fs::file_time_type::min() : d.mtime;
+                if (!e.is_dir) {
+                    e.size = d.error ? 0 : d.size;
+                }
+            }
+            if (!visit(e)) {
+                more = false;
+                break;
+            }
+        }
+        pending.clear();
+        paths.clear();
+        return more;
+    };
+
     for (const auto& de : fs::directory_iterator(dir, fs::directory_options::skip_permission_denied, ec)) {
         if (ec) {
             break;
         }
-
-        fs::path p = de.path();
-        if (p.filename() == cfg.disabled_dir) {
+        const fs::path& p = de.path();
+        if (p.filename() == cfg.disabled_dir || !keeps(cfg, p.filename().native())) {
             continue;
         }
 
-        auto eopt = build_enabled_entry(p, cfg);
-        if (!eopt) {
-            continue;
+        Pending pe{p.filename().native(), paths.size(), kNone, FileState::Enabled};
+        paths.push_back(p);
+        if (!disabled.empty() && disabled.contains(pe.name)) {
+            pe.disabled_stat = paths.size();
+            paths.push_back(dd / decorate_disabled_name(pe.name, cfg));
         }
+        pending.push_back(std::move(pe));
+        if (paths.size() >= io.queue_depth() && !flush()) {
+            return false;
+        }
+    }
+    if (!pending.empty() && !flush()) {
+        return false;
+    }
+
+    bool more = disabled.for_each_unmatched([&](std::string_view original) {
+        std::string name(original);
+        pending.push_back({name, paths.size(), kNone, FileState::Disabled});
+        paths.push_back(dd / decorate_disabled_name(name, cfg));
+        return paths.size() < io.queue_depth() || flush();
+    });
+    return more && (pending.empty() || flush());
+}
+
+// One entry's metadata probe, shared between the scanning thread and the
+// probe thread; whichever side is second decides who reports the result.
+struct MetaProbe {
+    enum Phase { Pending, Done, Abandoned };
 
-        by_name[eopt->display_name] = out.size();
-        out.push_back(std::move(*eopt));
+    std::string name;
+    fs::path path;           // stat'ed for the type (and the metadata)
+    fs::path disabled_path;  // disabled copy of an enabled entry, if any
+    FileState state{FileState::Enabled};
+    bool dtype_dir{false};
+    bool dtype_link{false};
+    bool follow{true};
+    FsBackend* backend{nullptr};
+    // Allowed from the moment a worker starts the probe, not from when it
+    // is queued.
+    std::chrono::milliseconds timeout{0};
+    LateMetaVisitor late;
+
+    std::mutex mu;
+    std::condition_variable cv;
+    Phase phase{Pending};
+    bool started{false};
+    std::chrono::steady_clock::time_point deadline;
+    bool found{false};
+    EntryMeta meta;
+
+    ScanEntry entry() const {
+        ScanEntry e;
+        e.name = name;
+        e.state = found ? state : FileState::Missing;
+        e.is_dir = meta.is_dir;
+        e.is_symlink = meta.is_symlink;
+        e.size = meta.size;
+        e.mtime = meta.mtime;
+        return e;
     }
 
-    fs::path dd = dir / cfg.disabled_dir;
-    if (fs::exists(dd, ec) && fs::is_directory(dd, ec)) {
-        for (const auto& de : fs::directory_iterator(dd, fs::directory_options::skip_permission_denied, ec)) {
-            if (ec) {
+    ScanEntry placeholder() const {
+        ScanEntry e;
+        e.name = name;
+        e.state = state;
+        e.is_dir = dtype_dir;
+        e.is_symlink = dtype_link && !follow;
+        e.meta_pending = true;
+        return e;
+    }
+
+    // Runs on a probe thread.
+    void run() {
+        {
+            std::lock_guard<std::mutex> lk(mu);
+            if (phase == Abandoned && !late) {
+                return;  // cancelled while queued
+            }
+            started = true;
+            deadline = std::chrono::steady_clock::now() + timeout;
+        }
+        cv.notify_all();
+
+        EntryMeta m;
+        bool ok = read_entry_meta(*backend, path, follow, &m);
+        if (ok && !disabled_path.empty()) {
+            merge_disabled_copy(*backend, disabled_path, follow, &m);
+        }
+
+        std::unique_lock<std::mutex> lk(mu);
+        found = ok;
+        meta = m;
+        if (phase == Abandoned) {
+            LateMetaVisitor visit = std::move(late);
+            lk.unlock();
+            if (visit) {
+                visit(entry());
+            }
+            return;
+        }
+        phase = Done;
+        cv.notify_all();
+    }
+
+    // The entry is visited as a placeholder without waiting.  Returns true
+    // if the probe is already done, so the caller reports it to late.
+    bool abandon() {
+        std::lock_guard<std::mutex> lk(mu);
+        if (phase == Done) {
+            return true;
+        }
+        phase = Abandoned;
+        return false;
+    }
+
+    // The entry will not be visited at all: drop the result.
+    void cancel() {
+        std::lock_guard<std::mutex> lk(mu);
+        phase = Abandoned;
+        late = nullptr;
+    }
+
+    // Wait for the probe until its deadline.  Returns true if it finished;
+    // otherwise the probe is abandoned to the late visitor.  While it is
+    // still queued, the pool is asked to replace stuck workers every
+    // timeout; it is given up on when the pool can start no more.
+    bool wait() {
+        std::unique_lock<std::mutex> lk(mu);
+        while (!started && phase == Pending) {
+            if (cv.wait_for(lk, timeout, [this] { return started || phase != Pending; })) {
+                break;
+            }
+            lk.unlock();
+            const bool can_start = ProbePool::instance().replace_stuck();
+            lk.lock();
+            if (!can_start) {
                 break;
             }
+        }
+        if (started) {
+            cv.wait_until(lk, deadline, [this] { return phase != Pending; });
+        }
+        if (phase == Done) {
+            return true;
+        }
+        phase = Abandoned;
+        if (started) {
+            // Overran while running: the worker may be stuck for good.
+            lk.unlock();
+            ProbePool::instance().replace_stuck();
+        }
+        return false;
+    }
+};
+
+// scan_dir() with a deadline on every entry's metadata, or without
+// waiting for metadata at all (names_only).  Stats run on the ProbePool;
+// whatever is not done by an entry's deadline is visited as a placeholder
+// and handed to late when it completes.
+static bool scan_dir_deadline(const fs::path& dir, const Config& cfg, DisabledNameSet& disabled, bool names_only,
+                              const ScanVisitor& visit, const LateMetaVisitor& late) {
+    const fs::path dd = dir / cfg.disabled_dir;
+    const auto timeout = std::chrono::milliseconds(names_only ? 0 : cfg.probe_timeout_ms);
+    const bool probe = !names_only || late;
+    // After this long a probe's worker is taken for stuck and replaced.
+    const auto stuck_after = std::chrono::milliseconds(cfg.probe_timeout_ms > 0 ? cfg.probe_timeout_ms : 1000);
 
-            fs::path p = de.path();
-            std::string decorated = p.filename().string();
-            auto original_opt = undecorate_disabled_name(decorated, cfg);
-            if (!original_opt) {
+    // Probes are submitted a chunk ahead of the visitor, so a slow entry
+    // overlaps with its neighbours instead of delaying them.
+    constexpr size_t kChunk = 64;
+    std::vector<std::shared_ptr<MetaProbe>> chunk;
+
+    auto submit = [&](std::shared_ptr<MetaProbe> p) {
+        p->follow = cfg.follow_symlinks;
+        p->backend = &backend_of(cfg);
+        p->timeout = timeout;
+        p->late = late;
+        if (probe) {
+            ProbePool::instance().submit([p] { p->run(); }, stuck_after);
+        }
+        chunk.push_back(std::move(p));
+    };
+    auto drain = [&]() {
+        bool more = true;
+        for (const auto& p : chunk) {
+            if (!more) {
+                p->cancel();
                 continue;
             }
-
-            auto it = by_name.find(*original_opt);
-            if (it != by_name.end()) {
-                FileEntry& existing = out[it->second];
-                existing.state = FileState::Disabled;
-                existing.disabled_path = p;
-                existing.mtime = fs::last_write_time(p, ec);
-                if (!existing.is_dir) {
-                    existing.size = fs::file_size(p, ec);
-                    if (ec) {
-                        existing.size = 0;
-                    }
+            if (probe && !names_only && p->wait()) {
+                if (p->found) {
+                    more = visit(p->entry());
                 }
                 continue;
             }
-
-            auto eopt2 = build_disabled_entry(p, *original_opt, dir, cfg);
-            if (!eopt2) {
-                continue;
+            more = visit(p->placeholder());
+            if (probe && names_only && p->abandon()) {
+                late(p->entry());
             }
-            by_name[eopt2->display_name] = out.size();
-            out.push_back(std::move(*eopt2));
         }
+        chunk.clear();
+        return more;
+    };
+
+    bool stopped = false;
+    backend_of(cfg).read_dir(dir, [&](std::string_view name, FsType type) {
+        if (name == cfg.disabled_dir.native() || !keeps(cfg, name)) {
+            return true;
+        }
+        auto p = std::make_shared<MetaProbe>();
+        p->name = name;
+        p->path = dir / name;
+        p->dtype_dir = (type == FsType::Dir);
+        p->dtype_link = (type == FsType::Symlink);
+        if (!disabled.empty() && disabled.take(name)) {
+            p->state = FileState::Disabled;
+            p->disabled_path = dd / decorate_disabled_name(name, cfg);
+        }
+        submit(std::move(p));
+        stopped = chunk.size() >= kChunk && !drain();
+        return !stopped;
+    });
+    if (stopped) {
+        return false;
+    }
+
+    const bool more = disabled.for_each_unmatched([&](std::string_view original) {
+        auto p = std::make_shared<MetaProbe>();
+        p->name = original;
+        p->path = dd / decorate_disabled_name(original, cfg);
+        p->state = FileState::Disabled;
+        submit(std::move(p));
+        return chunk.size() < kChunk || drain();
+    });
+    return drain() && more;
+}
+
+bool scan_dir(const fs::path& dir, const Config& cfg, const ScanVisitor& visit) {
+    return scan_dir(dir, cfg, visit, {});
+}
+
+static bool scan_dir_impl(const fs::path& dir, const Config& cfg, const ScanVisitor& visit, const LateMetaVisitor& late);
+
+bool scan_dir(const fs::path& dir, const Config& cfg, const ScanVisitor& visit, const LateMetaVisitor& late) {
+    TraceSpan span("scan_dir");
+    if (!cfg.stats) {
+        return scan_dir_impl(dir, cfg, visit, late);
+    }
+    RunStats::Timer timer(cfg.stats, RunStats::Scan);
+    return scan_dir_impl(dir, cfg, [&](const ScanEntry& e) {
+        cfg.stats->count_entry(e.state);
+        return visit(e);
+    }, late);
+}
+
+static bool scan_dir_impl(const fs::path& dir, const Config& cfg, const ScanVisitor& visit, const LateMetaVisitor& late) {
+    // The disabled dir is read first so enabled entries can be merged with
+    // their disabled counterpart as soon as they are seen.
+    DisabledNameSet disabled;
+    {
+        TraceSpan span("read_disabled_names");
+        read_disabled_names(dir, cfg, &disabled);
+    }
+    const bool names_only = cfg.meta_scan == MetaScan::NamesOnly
+        || (cfg.meta_scan == MetaScan::Auto && uses_posix_backend(cfg) && is_slow_mount(dir));
+    if (names_only || cfg.probe_timeout_ms > 0) {
+        return scan_dir_deadline(dir, cfg, disabled, names_only, visit, late);
+    }
+    if (cfg.io_queue_depth > 0 && uses_posix_backend(cfg)) {
+        return scan_dir_batched(dir, cfg, disabled, visit);
+    }
+
+    FsBackend& backend = backend_of(cfg);
+    const fs::path dd = dir / cfg.disabled_dir;
+    bool stopped = false;
+    backend.read_dir(dir, [&](std::string_view name, FsType) {
+        if (name == cfg.disabled_dir.native() || !keeps(cfg, name)) {
+            return true;
+        }
+
+        EntryMeta m;
+        if (!read_entry_meta(backend, dir / name, cfg.follow_symlinks, &m)) {
+            return true;
+        }
+
+        ScanEntry e;
+        e.name = name;
+        e.state = FileState::Enabled;
+        if (!disabled.empty() && disabled.take(e.name)) {
+            e.state = FileState::Disabled;
+            merge_disabled_copy(backend, dd / decorate_disabled_name(e.name, cfg), cfg.follow_symlinks, &m);
+        }
+        e.is_dir = m.is_dir;
+        e.is_symlink = m.is_symlink;
+        e.size = m.size;
+        e.mtime = m.mtime;
+
+        stopped = !visit(e);
+        return !stopped;
+    });
+    if (stopped) {
+        return false;
     }
 
-    std::sort(out.begin(), out.end(), [](const FileEntry& a, const FileEntry& b) {
-        return a.display_name < b.display_name;
+    return disabled.for_each_unmatched([&](std::string_view original) {
+        EntryMeta m;
+        if (!read_entry_meta(backend, dd / decorate_disabled_name(original, cfg), cfg.follow_symlinks, &m)) {
+            return true;
+        }
+        ScanEntry e;
+        e.name = original;
+        e.state = FileState::Disabled;
+        e.is_dir = m.is_dir;
+        e.is_symlink = m.is_symlink;
+        e.size = m.size;
+        e.mtime = m.mtime;
+        return visit(e);
     });
+}
 
+bool probe_entry(const fs::path& dir, std::string_view name, const Config& cfg, ScanEntry* out) {
+    FsBackend& backend = backend_of(cfg);
+    EntryMeta enabled;
+    const bool has_enabled = read_entry_meta(backend, dir / name, cfg.follow_symlinks, &enabled);
+
+    EntryMeta disabled;
+    const bool has_disabled = read_entry_meta(backend, dir / cfg.disabled_dir / decorate_disabled_name(name, cfg), cfg.follow_symlinks, &disabled);
+
+    if (!has_enabled && !has_disabled) {
+        return false;
+    }
+
+    out->name = name;
+    if (has_disabled) {
+        // Like scan_dir(): the disabled copy wins, the type of an enabled
+        // namesake is kept.
+        out->state = FileState::Disabled;
+        out->is_dir = has_enabled ? enabled.is_dir : disabled.is_dir;
+        out->is_symlink = has_enabled ? enabled.is_symlink : disabled.is_symlink;
+        out->size = out->is_dir ? 0 : disabled.size;
+        out->mtime = disabled.mtime;
+    } else {
+        out->state = FileState::Enabled;
+        out->is_dir = enabled.is_dir;
+        out->is_symlink = enabled.is_symlink;
+        out->size = enabled.size;
+        out->mtime = enabled.mtime;
+    }
+    return true;
+}
+
+std::optional<LinkTarget> resolve_link(const fs::path& path) {
+    std::error_code ec;
+    LinkTarget t;
+    t.target = fs::read_symlink(path, ec);
+    if (ec) {
+        return std::nullopt;
+    }
+    const fs::file_status st = fs::status(path, ec);
+    t.dangling = !fs::exists(st);
+    t.is_dir = fs::is_directory(st);
+    return t;
+}
+
+EntryTable scan_dir_table(const fs::path& dir, const Config& cfg, const LateMetaVisitor& late) {
+    EntryTable out(dir, cfg);
+    scan_dir(dir, cfg, [&out](const ScanEntry& e) {
+        out.add(e.name, e.state, e.is_dir, e.size, e.mtime, e.meta_pending, e.is_symlink);
+        return true;
+    }, late);
+    out.sort_by_name();
+    return out;
+}
+
+std::vector<FileEntry> list_dir_entries_with_disabled(const fs::path& dir, const Config& cfg) {
+    EntryTable table = scan_dir_table(dir, cfg);
+
+    std::vector<FileEntry> out;
+    out.reserve(table.size());
+    for (size_t i = 0; i < table.size(); i++) {
+        out.push_back(table.entry(i));
+    }
     return out;
 }
 
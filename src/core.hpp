@@ -1,19 +1,47 @@
 #pragma once
 
+#include <cstdint>
 #include <filesystem>
+#include <functional>
 #include <optional>
 #include <string>
 #include <string_view>
+#include <unordered_map>
 #include <vector>
 
 namespace ft {
 
+class FsBackend;
+class RunStats;
+
 enum class Verbosity {
     Quiet,
     Normal,
     Verbose,
 };
 
+// Decides from an entry's original (undecorated) name alone whether a
+// scan reports it.
+using NameFilter = std::function<bool(std::string_view name)>;
+
+enum class MetaScan {
+    // Stat entries, except in directories on network or FUSE mounts.
+    Auto,
+    Full,
+    // Report names (and the type from readdir) without waiting for stat.
+    NamesOnly,
+};
+
+// How names sort in EntryTable::sort_by_name() and the GUI.
+enum class NameOrder {
+    // Byte order: "mod10" before "mod2".
+    Bytes,
+    // Runs of digits compare by their value: "mod2" before "mod10".
+    Natural,
+    // Natural, and ASCII letters compare regardless of case.
+    NaturalIgnoreCase,
+};
+
 struct Config {
     std::filesystem::path chdir;
     std::filesystem::path disabled_dir{ ".disable.d" };
@@ -21,6 +49,31 @@ struct Config {
     std::string disabled_suffix;
     bool dry_run{false};
     Verbosity verbosity{Verbosity::Normal};
+    // Keep and use a manifest of disabled names in the disabled dir (see
+    // manifest.hpp).
+    bool manifest{false};
+    // io_uring queue depth for the stat calls of scan_dir() and the renames
+    // of move_batch(); 0 makes one blocking call at a time (see batch_io.hpp).
+    unsigned io_queue_depth{0};
+    // Per-entry deadline for the stat calls of scan_dir().  Entries whose
+    // metadata takes longer are reported with placeholder metadata; 0 waits
+    // as long as the filesystem takes (see probe.hpp).
+    unsigned probe_timeout_ms{0};
+    MetaScan meta_scan{MetaScan::Auto};
+    // Stat symlink targets.  When off, entries are lstat'ed and symlinks are
+    // reported as links of their own, size 0, whatever they point to.
+    bool follow_symlinks{true};
+    // Filesystem the core operations go through (see fs_backend.hpp); null
+    // for the real one.  Must outlive the scans made with this Config,
+    // including their late metadata.
+    FsBackend* backend{nullptr};
+    // Counters and timings for --stats (see stats.hpp); null to collect
+    // nothing.
+    RunStats* stats{nullptr};
+    // Entries whose name fails this are dropped by scan_dir() as they are
+    // read, before they are stat'ed; empty keeps every entry.
+    NameFilter name_filter;
+    NameOrder name_order{NameOrder::Bytes};
 };
 
 enum class FileState {
@@ -36,12 +89,86 @@ struct FileEntry {
     std::filesystem::file_time_type mtime{};
     std::uintmax_t size{0};
     bool is_dir{false};
+    bool is_symlink{false};
     FileState state{FileState::Missing};
 };
 
+// Append to out the collation key of name: keys of two names compare as
+// byte strings the way the names compare under order.  A run of digits
+// becomes '0', its number of significant digits and those digits, so the
+// run sorts by value and still sorts where a digit would among other
+// bytes.  Names differing only in leading zeros (or, ignoring case, in
+// case) get the same key.
+void append_name_key(std::string_view name, NameOrder order, std::string* out);
+
 std::string decorate_disabled_name(std::string_view original, const Config& cfg);
 std::optional<std::string> undecorate_disabled_name(std::string_view decorated, const Config& cfg);
 
+// undecorate_disabled_name() for one of the four shapes of decoration,
+// chosen at compile time: only the affix checks that shape needs are made,
+// and the original name is returned as a slice of decorated.
+template <bool HasPrefix, bool HasSuffix>
+struct DecorationMatcher {
+    std::string_view prefix;
+    std::string_view suffix;
+
+    std::optional<std::string_view> operator()(std::string_view decorated) const {
+        if constexpr (HasPrefix && HasSuffix) {
+            if (decorated.size() < prefix.size() + suffix.size()
+                || !decorated.starts_with(prefix) || !decorated.ends_with(suffix)) {
+                return std::nullopt;
+            }
+            return decorated.substr(prefix.size(), decorated.size() - prefix.size() - suffix.size());
+        } else if constexpr (HasPrefix) {
+            if (!decorated.starts_with(prefix)) {
+                return std::nullopt;
+            }
+            return decorated.substr(prefix.size());
+        } else if constexpr (HasSuffix) {
+            if (!decorated.ends_with(suffix)) {
+                return std::nullopt;
+            }
+            return decorated.substr(0, decorated.size() - suffix.size());
+        } else {
+            return decorated;
+        }
+    }
+};
+
+// Undecorates the names of a disabled dir for one Config, without
+// allocating.  Refers to cfg's prefix and suffix, so cfg must outlive it.
+class DisabledNameMatcher {
+ public:
+    explicit DisabledNameMatcher(const Config& cfg);
+
+    // f(match) with the DecorationMatcher for cfg's shape, so a loop inside
+    // f is compiled once per shape with the checks hoisted out of it.
+    template <typename Fn>
+    decltype(auto) dispatch(Fn&& f) const {
+        if (!m_prefix.empty() && !m_suffix.empty()) {
+            return f(DecorationMatcher<true, true>{m_prefix, m_suffix});
+        }
+        if (!m_prefix.empty()) {
+            return f(DecorationMatcher<true, false>{m_prefix, m_suffix});
+        }
+        if (!m_suffix.empty()) {
+            return f(DecorationMatcher<false, true>{m_prefix, m_suffix});
+        }
+        return f(DecorationMatcher<false, false>{m_prefix, m_suffix});
+    }
+
+    // The original name, a slice of decorated, or nullopt if decorated is
+    // not decorated for cfg.  Branches on the shape per call; loops should
+    // use dispatch().
+    std::optional<std::string_view> operator()(std::string_view decorated) const {
+        return dispatch([decorated](const auto& match) { return match(decorated); });
+    }
+
+ private:
+    std::string_view m_prefix;
+    std::string_view m_suffix;
+};
+
 std::filesystem::path disabled_path_for(const std::filesystem::path& enabled_path, const Config& cfg);
 
 FileState get_state(const std::filesystem::path& enabled_path, const Config& cfg);
@@ -50,11 +177,199 @@ void ensure_disabled_dir_exists(const std::filesystem::path& base_dir, const Con
 
 void move_path(const std::filesystem::path& from, const std::filesystem::path& to, const Config& cfg);
 
+struct MoveOp {
+    std::filesystem::path from;
+    std::filesystem::path to;
+};
+
+// Perform every move of a batch whose source state is already known, e.g.
+// from a scan, without probing each path again.  The caller creates the
+// disabled dir.  Returns the number of failed moves; messages are
+// appended to errs and the indices of failed ops to failed.
+size_t move_batch(const std::vector<MoveOp>& ops, const Config& cfg, std::vector<std::string>* errs, std::vector<size_t>* failed = nullptr);
+
 bool enable_one(const std::filesystem::path& enabled_path, const Config& cfg, std::string* err);
 bool disable_one(const std::filesystem::path& enabled_path, const Config& cfg, std::string* err);
 bool toggle_one(const std::filesystem::path& enabled_path, const Config& cfg, std::string* err);
 bool rename_one(const std::filesystem::path& enabled_path, std::string_view new_display_name, const Config& cfg, std::string* err);
 
+// Columnar store for the entries of one directory.
+//
+// Names are packed into a single arena and the per-row metadata lives in
+// parallel arrays, so a row costs ~25 bytes plus its name instead of three
+// heap allocations.  The enabled/disabled paths are not stored; they are
+// derived on demand from the directory, the name and the Config.  Under a
+// natural Config::name_order, each row's collation key is made once as it
+// is added and kept in a second arena, so sorting compares flat bytes.
+class EntryTable {
+ public:
+    EntryTable() = default;
+    EntryTable(std::filesystem::path dir, const Config& cfg);
+
+    size_t size() const { return m_name_off.size(); }
+    bool empty() const { return m_name_off.empty(); }
+    void clear();
+    void reserve(size_t rows, size_t name_bytes = 0);
+
+    size_t add(std::string_view name, FileState state, bool is_dir, std::uintmax_t size, std::filesystem::file_time_type mtime,
+               bool meta_pending = false, bool is_symlink = false);
+
+    std::string_view name(size_t i) const { return std::string_view(m_names).substr(m_name_off[i], m_name_len[i]); }
+    // What rows sort by: the name, or its key (see append_name_key()).
+    std::string_view sort_key(size_t i) const {
+        return m_order == NameOrder::Bytes ? name(i) : std::string_view(m_keys).substr(m_key_off[i], m_key_len[i]);
+    }
+    NameOrder name_order() const { return m_order; }
+    FileState state(size_t i) const { return static_cast<FileState>(m_flags[i] & kStateMask); }
+    bool is_dir(size_t i) const { return (m_flags[i] & kDirBit) != 0; }
+    std::uintmax_t file_size(size_t i) const { return m_sizes[i]; }
+    std::filesystem::file_time_type mtime(size_t i) const { return m_mtimes[i]; }
+    // Size and mtime are placeholders; is_dir is readdir's guess.
+    bool meta_pending(size_t i) const { return (m_flags[i] & kPendingBit) != 0; }
+    bool is_symlink(size_t i) const { return (m_flags[i] & kLinkBit) != 0; }
+    // file_size() of a directory holds its recursive size (see du.hpp);
+    // a partial one is a running total.
+    bool has_tree_size(size_t i) const { return (m_flags[i] & kTreeSizeBit) != 0; }
+    bool tree_size_partial(size_t i) const { return (m_flags[i] & kPartialBit) != 0; }
+
+    void set_state(size_t i, FileState state);
+    // Also clears meta_pending.
+    void set_meta(size_t i, bool is_dir, std::uintmax_t size, std::filesystem::file_time_type mtime, bool is_symlink = false);
+    void set_tree_size(size_t i, std::uintmax_t size, bool complete);
+
+    const std::filesystem::path& dir() const { return m_dir; }
+    std::filesystem::path enabled_path(size_t i) const;
+    std::filesystem::path disabled_path(size_t i) const;
+    FileEntry entry(size_t i) const;
+
+    // Reorder rows so that new row k is old row order[k].  Rows not listed
+    // in order are dropped.
+    void permute(const std::vector<uint32_t>& order);
+    // By sort_key(), then by name.
+    void sort_by_name();
+    void reverse();
+
+    template <typename Pred>
+    void erase_if(Pred pred) {
+        std::vector<uint32_t> keep;
+        keep.reserve(size());
+        for (size_t i = 0; i < size(); i++) {
+            if (!pred(i)) {
+                keep.push_back(static_cast<uint32_t>(i));
+            }
+        }
+        if (keep.size() != size()) {
+            permute(keep);
+        }
+    }
+
+    // Approximate heap bytes held by the table.
+    size_t memory_usage() const;
+
+ private:
+    static constexpr uint8_t kStateMask = 0x03;
+    static constexpr uint8_t kDirBit = 0x04;
+    static constexpr uint8_t kPendingBit = 0x08;
+    static constexpr uint8_t kLinkBit = 0x10;
+    static constexpr uint8_t kTreeSizeBit = 0x20;
+    static constexpr uint8_t kPartialBit = 0x40;
+
+    std::filesystem::path m_dir;
+    std::filesystem::path m_disabled_dir;
+    std::string m_disabled_prefix;
+    std::string m_disabled_suffix;
+    NameOrder m_order{NameOrder::Bytes};
+
+    std::string m_names;
+    std::vector<uint32_t> m_name_off;
+    std::vector<uint32_t> m_name_len;
+    // Empty under NameOrder::Bytes.
+    std::string m_keys;
+    std::vector<uint32_t> m_key_off;
+    std::vector<uint32_t> m_key_len;
+    std::vector<std::uintmax_t> m_sizes;
+    std::vector<std::filesystem::file_time_type> m_mtimes;
+    std::vector<uint8_t> m_flags;
+};
+
+// Name lookups on the rows of an EntryTable in their current order.  Holds
+// views into the table: rebuild after the table is sorted, filtered or
+// refilled.
+class EntryNameIndex {
+ public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    void rebuild(const EntryTable& table);
+    void clear();
+
+    // Row of the entry called name, or npos.
+    size_t find(std::string_view name) const;
+    // Lowest row whose name starts with prefix, or npos.
+    size_t first_with_prefix(std::string_view prefix) const;
+
+ private:
+    // Rows in name order are cut into blocks of kBlock; m_block_min holds
+    // the lowest row of each, so the lowest row in a range of matches
+    // costs O(kBlock + matches / kBlock).
+    static constexpr size_t kBlock = 64;
+
+    std::unordered_map<std::string_view, uint32_t> m_rows;
+    std::vector<std::string_view> m_sorted_names;
+    std::vector<uint32_t> m_sorted_rows;
+    std::vector<uint32_t> m_block_min;
+};
+
+// One merged entry as seen by a scan visitor.  The name is only valid for
+// the duration of the callback.
+struct ScanEntry {
+    std::string_view name;
+    FileState state{FileState::Missing};
+    bool is_dir{false};
+    // With follow_symlinks the entry is a symlink whose target is missing
+    // (is_dir false, size 0, the link's own mtime); without, any symlink.
+    bool is_symlink{false};
+    std::uintmax_t size{0};
+    std::filesystem::file_time_type mtime{};
+    // Metadata was not available in time: size and mtime are zero and
+    // is_dir comes from readdir.
+    bool meta_pending{false};
+};
+
+// Return false from the visitor to stop the scan early.
+using ScanVisitor = std::function<bool(const ScanEntry&)>;
+
+// Receives the metadata of an entry that scan_dir() reported as pending,
+// once its probe finishes: usually on a probe thread and after scan_dir()
+// has returned.  state is Missing if the entry could not be stat'ed.
+using LateMetaVisitor = std::function<void(const ScanEntry&)>;
+
+// Stream the merged enabled/disabled entries of dir, unsorted.  Enabled
+// entries are yielded while the directory is read; disabled-only entries
+// follow.  Only the undecorated names found in the disabled dir are held
+// in memory.  Returns false if the visitor stopped the scan.
+bool scan_dir(const std::filesystem::path& dir, const Config& cfg, const ScanVisitor& visit);
+// Same; pending entries are completed later through late.
+bool scan_dir(const std::filesystem::path& dir, const Config& cfg, const ScanVisitor& visit, const LateMetaVisitor& late);
+
+// Stat a single display name of dir the way scan_dir() would report it.
+// Returns false if neither its enabled nor its disabled path exists.
+bool probe_entry(const std::filesystem::path& dir, std::string_view name, const Config& cfg, ScanEntry* out);
+
+// Where a symlink points, read on demand for entries scan_dir() reported
+// as links.  target is the link text as stored; dangling is set when it
+// does not resolve, is_dir when it resolves to a directory.
+struct LinkTarget {
+    std::filesystem::path target;
+    bool dangling{false};
+    bool is_dir{false};
+};
+
+// nullopt if path is not a symlink.
+std::optional<LinkTarget> resolve_link(const std::filesystem::path& path);
+
+// scan_dir() collected into a table, sorted by name.
+EntryTable scan_dir_table(const std::filesystem::path& dir, const Config& cfg, const LateMetaVisitor& late = {});
+
 std::vector<FileEntry> list_dir_entries_with_disabled(const std::filesystem::path& dir, const Config& cfg);
 
 }
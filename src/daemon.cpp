@@ -0,0 +1,831 @@
+#include "daemon.hpp"
+
+#include "manifest.hpp"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace ft {
+
+namespace {
+
+std::string escape_field(std::string_view s) {
+    std::string out;
+    out.reserve(s.size());
+    for (char c : s) {
+        switch (c) {
+            case '\t': out += "\\t"; break;
+            case '\n': out += "\\n"; break;
+            case '\\': out += "\\\\"; break;
+            default: out += c; break;
+        }
+    }
+    return out;
+}
+
+std::vector<std::string> split_fields(std::string_view line) {
+    std::vector<std::string> fields(1);
+    for (size_t i = 0; i < line.size(); i++) {
+        const char c = line[i];
+        if (c == '\t') {
+            fields.emplace_back();
+        } else if (c == '\\' && i + 1 < line.size()) {
+            const char n = line[++i];
+            fields.back() += (n == 't') ? '\t' : (n == 'n') ? '\n' : n;
+        } else {
+            fields.back() += c;
+        }
+    }
+    return fields;
+}
+
+std::string join_fields(const std::vector<std::string>& fields) {
+    std::string out;
+    for (size_t i = 0; i < fields.size(); i++) {
+        if (i != 0) {
+            out += '\t';
+        }
+        out += escape_field(fields[i]);
+    }
+    return out;
+}
+
+bool set_nonblocking(int fd) {
+    const int flags = ::fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+bool make_sockaddr(const fs::path& path, struct sockaddr_un* addr) {
+    std::memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (path.native().size() >= sizeof(addr->sun_path)) {
+        return false;
+    }
+    std::memcpy(addr->sun_path, path.c_str(), path.native().size());
+    return true;
+}
+
+int connect_socket(const fs::path& path) {
+    struct sockaddr_un addr;
+    if (!make_sockaddr(path, &addr)) {
+        return -1;
+    }
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// The process at the other end of fd runs as this user.  Anyone can
+// create a socket under /tmp; a daemon of another user must neither be
+// handed our requests nor be sent ones by us.
+bool peer_is_us(int fd) {
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    return ::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0 && cred.uid == ::getuid();
+}
+
+// path is a socket owned by this user.
+bool socket_is_ours(const fs::path& path) {
+    struct stat st;
+    return ::lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode) && st.st_uid == ::getuid();
+}
+
+const char* meta_scan_name(MetaScan m) {
+    switch (m) {
+        case MetaScan::Full: return "full";
+        case MetaScan::NamesOnly: return "names";
+        case MetaScan::Auto: break;
+    }
+    return "auto";
+}
+
+// The HELLO request for cfg: every setting that changes what the daemon
+// does with a request.  The daemon compares the whole line with its own.
+std::vector<std::string> hello_fields(const Config& cfg) {
+    return {"HELLO", cfg.disabled_dir.string(), cfg.disabled_prefix, cfg.disabled_suffix,
+            cfg.manifest ? "manifest" : "-", meta_scan_name(cfg.meta_scan),
+            std::to_string(cfg.probe_timeout_ms), std::to_string(cfg.io_queue_depth),
+            cfg.follow_symlinks ? "follow" : "nofollow"};
+}
+
+// A client gives up on a daemon that has not answered for this long and
+// does the work itself.
+constexpr int kClientTimeoutMs = 5000;
+
+const char* state_name(FileState s) {
+    switch (s) {
+        case FileState::Enabled: return "enabled";
+        case FileState::Disabled: return "disabled";
+        case FileState::Missing: break;
+    }
+    return "missing";
+}
+
+long long unix_seconds(fs::file_time_type t) {
+    const auto sys = std::chrono::file_clock::to_sys(t);
+    return std::chrono::duration_cast<std::chrono::seconds>(sys.time_since_epoch()).count();
+}
+
+volatile std::sig_atomic_t g_stop = 0;
+
+void on_stop_signal(int) {
+    g_stop = 1;
+}
+
+struct Row {
+    FileState state{FileState::Missing};
+    bool is_dir{false};
+    bool is_symlink{false};
+    std::uintmax_t size{0};
+    fs::file_time_type mtime{};
+    // The scan gave up waiting for the stat (--probe-timeout, slow mount):
+    // size and mtime are unknown, not zero.
+    bool meta_pending{false};
+};
+
+// In-memory state of one registered directory, kept current by inotify.
+struct DirState {
+    fs::path dir;
+    int wd_dir{-1};
+    int wd_disabled{-1};
+    // Set when incremental updates cannot be trusted (new watch, queue
+    // overflow, disabled dir created or removed); the next query rescans.
+    bool dirty{true};
+    // Some row was loaded without its metadata; the next LIST rescans
+    // rather than serving the gap from the cache.
+    bool meta_pending{false};
+    std::map<std::string, Row, std::less<>> rows;
+};
+
+struct Client {
+    int fd{-1};
+    std::string in;
+    std::string out;
+};
+
+struct Response {
+    std::vector<std::string> data;
+    std::string status{"OK"};
+};
+
+// A move waiting for the batch to be flushed.
+struct PendingMove {
+    size_t response;
+    DirState* ds;
+    std::string name;
+    FileState new_state;
+};
+
+class Daemon {
+ public:
+    explicit Daemon(const Config& cfg) : m_cfg(cfg) {}
+
+    int run(const fs::path& socket_path);
+
+ private:
+    DirState* dir_state(const fs::path& dir);
+    void load(DirState& ds);
+    void refresh_name(DirState& ds, std::string_view name);
+    void watch_disabled_dir(DirState& ds);
+    void handle_inotify();
+
+    void handle_client_input(Client& c);
+    void handle_request(const std::vector<std::string>& req, std::vector<Response>* responses);
+    void queue_move(std::string_view cmd, const fs::path& path, std::vector<Response>* responses);
+    void queue_profile(const fs::path& dir, const std::string& name, std::vector<Response>* responses);
+    void flush_moves(std::vector<Response>* responses);
+
+    Config m_cfg;
+    int m_inotify{-1};
+    std::unordered_map<std::string, DirState> m_dirs;
+    std::unordered_map<int, DirState*> m_by_wd;
+
+    std::vector<MoveOp> m_ops;
+    std::vector<PendingMove> m_pending;
+    std::set<DirState*> m_need_disabled_dir;
+};
+
+DirState* Daemon::dir_state(const fs::path& dir) {
+    if (!dir.is_absolute()) {
+        return nullptr;
+    }
+    const fs::path norm = dir.lexically_normal();
+    auto it = m_dirs.find(norm.native());
+    if (it == m_dirs.end()) {
+        std::error_code ec;
+        if (!fs::is_directory(norm, ec)) {
+            return nullptr;
+        }
+        it = m_dirs.emplace(norm.native(), DirState{}).first;
+        it->second.dir = norm;
+    }
+
+    DirState& ds = it->second;
+    if (ds.wd_dir < 0) {
+        const uint32_t mask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF;
+        ds.wd_dir = ::inotify_add_watch(m_inotify, ds.dir.c_str(), mask);
+        if (ds.wd_dir >= 0) {
+            m_by_wd[ds.wd_dir] = &ds;
+        }
+        ds.dirty = true;
+    }
+    if (ds.wd_disabled < 0) {
+        watch_disabled_dir(ds);
+    }
+    if (ds.dirty) {
+        load(ds);
+    }
+    return &ds;
+}
+
+void Daemon::watch_disabled_dir(DirState& ds) {
+    const fs::path dd = ds.dir / m_cfg.disabled_dir;
+    const uint32_t mask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE | IN_ATTRIB;
+    ds.wd_disabled = ::inotify_add_watch(m_inotify, dd.c_str(), mask | IN_ONLYDIR);
+    if (ds.wd_disabled >= 0) {
+        m_by_wd[ds.wd_disabled] = &ds;
+    }
+}
+
+void Daemon::load(DirState& ds) {
+    ds.rows.clear();
+    ds.meta_pending = false;
+    scan_dir(ds.dir, m_cfg, [&ds](const ScanEntry& e) {
+        ds.rows.emplace(std::string(e.name), Row{e.state, e.is_dir, e.is_symlink, e.size, e.mtime, e.meta_pending});
+        ds.meta_pending |= e.meta_pending;
+        return true;
+    });
+    ds.dirty = false;
+}
+
+void Daemon::refresh_name(DirState& ds, std::string_view name) {
+    if (ds.dirty) {
+        return;
+    }
+    ScanEntry e;
+    if (!probe_entry(ds.dir, name, m_cfg, &e)) {
+        auto it = ds.rows.find(name);
+        if (it != ds.rows.end()) {
+            ds.rows.erase(it);
+        }
+        return;
+    }
+    ds.rows.insert_or_assign(std::string(name), Row{e.state, e.is_dir, e.is_symlink, e.size, e.mtime});
+}
+
+void Daemon::handle_inotify() {
+    alignas(struct inotify_event) char buf[64 * 1024];
+    for (;;) {
+        const ssize_t n = ::read(m_inotify, buf, sizeof(buf));
+        if (n <= 0) {
+            return;
+        }
+        for (ssize_t off = 0; off < n;) {
+            const auto* ev = reinterpret_cast<const struct inotify_event*>(buf + off);
+            off += static_cast<ssize_t>(sizeof(struct inotify_event) + ev->len);
+
+            if (ev->mask & IN_Q_OVERFLOW) {
+                for (auto& [key, ds] : m_dirs) {
+                    ds.dirty = true;
+                }
+                continue;
+            }
+
+            auto it = m_by_wd.find(ev->wd);
+            if (it == m_by_wd.end()) {
+                continue;
+            }
+            DirState& ds = *it->second;
+            const bool in_disabled = (ev->wd == ds.wd_disabled);
+
+            if (ev->mask & IN_IGNORED) {
+                m_by_wd.erase(it);
+                if (in_disabled) {
+                    ds.wd_disabled = -1;
+                } else {
+                    ds.wd_dir = -1;
+                }
+                ds.dirty = true;
+                continue;
+            }
+            if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+                ds.dirty = true;
+                continue;
+            }
+            if (ev->len == 0) {
+                continue;
+            }
+
+            const std::string_view name = ev->name;
+            if (!in_disabled) {
+                if (name == m_cfg.disabled_dir.native()) {
+                    if (ds.wd_disabled < 0) {
+                        watch_disabled_dir(ds);
+                    }
+                    ds.dirty = true;
+                    continue;
+                }
+                refresh_name(ds, name);
+                continue;
+            }
+
+            if (is_manifest_name(name)) {
+                continue;
+            }
+            if (const auto original = DisabledNameMatcher(m_cfg)(name)) {
+                refresh_name(ds, *original);
+            }
+        }
+    }
+}
+
+void Daemon::handle_request(const std::vector<std::string>& req, std::vector<Response>* responses) {
+    const std::string& cmd = req[0];
+    const bool is_move = (cmd == "ENABLE" || cmd == "DISABLE" || cmd == "TOGGLE" || cmd == "PROFILE");
+    if (!is_move) {
+        flush_moves(responses);
+    }
+
+    responses->emplace_back();
+    Response& r = responses->back();
+    auto fail = [&r](const std::string& msg) {
+        r.status = "ERR " + msg;
+    };
+
+    if (cmd == "HELLO") {
+        const std::vector<std::string> ours = hello_fields(m_cfg);
+        if (req.size() != ours.size()) {
+            return fail("usage: HELLO disabled-dir prefix suffix manifest metadata probe-timeout io-depth follow");
+        }
+        if (req != ours) {
+            return fail("config mismatch");
+        }
+        return;
+    }
+
+    if (cmd == "WATCH" || cmd == "LIST") {
+        if (req.size() != 2) {
+            return fail("usage: " + cmd + " dir");
+        }
+        DirState* ds = dir_state(req[1]);
+        if (!ds) {
+            return fail("not an absolute directory: " + req[1]);
+        }
+        if (cmd == "LIST") {
+            if (ds->meta_pending) {
+                load(*ds);
+            }
+            // "-" for metadata still pending, as --list prints it.
+            for (const auto& [name, row] : ds->rows) {
+                r.data.push_back(join_fields({state_name(row.state), row.is_symlink ? "link" : row.is_dir ? "dir" : "file",
+                    row.meta_pending ? "-" : std::to_string(row.size),
+                    row.meta_pending ? "-" : std::to_string(unix_seconds(row.mtime)), name}));
+            }
+        }
+        return;
+    }
+
+    if (cmd == "STATE") {
+        if (req.size() != 2) {
+            return fail("usage: STATE path");
+        }
+        const fs::path p = req[1];
+        DirState* ds = dir_state(p.parent_path());
+        if (!ds) {
+            return fail("not an absolute path: " + req[1]);
+        }
+        auto it = ds->rows.find(p.filename().native());
+        r.data.push_back(state_name(it == ds->rows.end() ? FileState::Missing : it->second.state));
+        return;
+    }
+
+    if (cmd == "PROFILE") {
+        if (req.size() != 3) {
+            return fail("usage: PROFILE dir name");
+        }
+        responses->pop_back();
+        queue_profile(req[1], req[2], responses);
+        return;
+    }
+
+    if (is_move) {
+        if (req.size() != 2) {
+            return fail("usage: " + cmd + " path");
+        }
+        responses->pop_back();
+        queue_move(cmd, req[1], responses);
+        return;
+    }
+
+    fail("unknown request: " + cmd);
+}
+
+void Daemon::queue_move(std::string_view cmd, const fs::path& path, std::vector<Response>* responses) {
+    responses->emplace_back();
+    Response& r = responses->back();
+
+    DirState* ds = dir_state(path.parent_path());
+    if (!ds) {
+        r.status = "ERR not an absolute path: " + path.string();
+        return;
+    }
+    const std::string name = path.filename().string();
+    auto it = ds->rows.find(name);
+    const FileState state = (it == ds->rows.end()) ? FileState::Missing : it->second.state;
+    const fs::path dp = ds->dir / m_cfg.disabled_dir / decorate_disabled_name(name, m_cfg);
+
+    bool enable = false;
+    if (cmd == "ENABLE") {
+        if (state != FileState::Disabled) {
+            r.status = "ERR disabled file not found: " + dp.string();
+            return;
+        }
+        enable = true;
+    } else if (cmd == "DISABLE") {
+        if (state != FileState::Enabled) {
+            r.status = "ERR enabled file not found: " + path.string();
+            return;
+        }
+    } else {
+        if (state == FileState::Missing) {
+            r.status = "ERR file not found (enabled or disabled): " + path.string();
+            return;
+        }
+        enable = (state == FileState::Disabled);
+    }
+
+    if (enable) {
+        m_ops.push_back({dp, ds->dir / name});
+    } else {
+        m_ops.push_back({ds->dir / name, dp});
+        m_need_disabled_dir.insert(ds);
+    }
+    const FileState new_state = enable ? FileState::Enabled : FileState::Disabled;
+    m_pending.push_back({responses->size() - 1, ds, name, new_state});
+    // Later requests of the same batch see the state after this move.
+    it->second.state = new_state;
+}
+
+void Daemon::queue_profile(const fs::path& dir, const std::string& name, std::vector<Response>* responses) {
+    responses->emplace_back();
+    Response& r = responses->back();
+
+    DirState* ds = dir_state(dir);
+    if (!ds || name.empty() || name.find('/') != std::string::npos) {
+        r.status = "ERR invalid profile: " + dir.string() + " " + name;
+        return;
+    }
+    std::ifstream in(ds->dir / m_cfg.disabled_dir / "profile" / name);
+    if (!in.is_open()) {
+        r.status = "ERR profile not found: " + name;
+        return;
+    }
+    std::set<std::string, std::less<>> target;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty()) {
+            target.insert(line);
+        }
+    }
+
+    // One pending move per file; all of them answer this request.
+    const size_t response = responses->size() - 1;
+    for (auto& [fname, row] : ds->rows) {
+        if (row.is_dir) {
+            continue;
+        }
+        const bool should_disable = target.count(fname) > 0;
+        const fs::path dp = ds->dir / m_cfg.disabled_dir / decorate_disabled_name(fname, m_cfg);
+        if (!should_disable && row.state == FileState::Disabled) {
+            m_ops.push_back({dp, ds->dir / fname});
+            m_pending.push_back({response, ds, fname, FileState::Enabled});
+            row.state = FileState::Enabled;
+        } else if (should_disable && row.state == FileState::Enabled) {
+            m_ops.push_back({ds->dir / fname, dp});
+            m_pending.push_back({response, ds, fname, FileState::Disabled});
+            m_need_disabled_dir.insert(ds);
+            row.state = FileState::Disabled;
+        }
+    }
+}
+
+void Daemon::flush_moves(std::vector<Response>* responses) {
+    if (m_ops.empty()) {
+        return;
+    }
+    for (DirState* ds : m_need_disabled_dir) {
+        ensure_disabled_dir_exists(ds->dir, m_cfg, m_cfg.dry_run);
+    }
+
+    std::vector<std::string> errs;
+    std::vector<size_t> failed;
+    move_batch(m_ops, m_cfg, &errs, &failed);
+
+    for (size_t k = 0; k < failed.size(); k++) {
+        const PendingMove& pm = m_pending[failed[k]];
+        Response& r = (*responses)[pm.response];
+        if (r.status == "OK") {
+            r.status = "ERR " + errs[k];
+        }
+        // Undo the optimistic update; inotify will correct anything else.
+        refresh_name(*pm.ds, pm.name);
+    }
+
+    m_ops.clear();
+    m_pending.clear();
+    m_need_disabled_dir.clear();
+}
+
+void Daemon::handle_client_input(Client& c) {
+    std::vector<Response> responses;
+    size_t start = 0;
+    for (;;) {
+        const size_t nl = c.in.find('\n', start);
+        if (nl == std::string::npos) {
+            break;
+        }
+        const std::string_view line = std::string_view(c.in).substr(start, nl - start);
+        start = nl + 1;
+        if (line.empty()) {
+            continue;
+        }
+        handle_request(split_fields(line), &responses);
+    }
+    c.in.erase(0, start);
+    flush_moves(&responses);
+
+    for (const auto& r : responses) {
+        for (const auto& d : r.data) {
+            c.out += "= ";
+            c.out += d;
+            c.out += '\n';
+        }
+        c.out += r.status;
+        c.out += '\n';
+    }
+}
+
+int Daemon::run(const fs::path& socket_path) {
+    struct sockaddr_un addr;
+    if (!make_sockaddr(socket_path, &addr)) {
+        std::cerr << "socket path too long: " << socket_path.string() << "\n";
+        return 2;
+    }
+
+    // Refuse to steal the socket of a live daemon; remove a stale one.
+    int probe = connect_socket(socket_path);
+    if (probe >= 0) {
+        ::close(probe);
+        std::cerr << "daemon already running on " << socket_path.string() << "\n";
+        return 2;
+    }
+    ::unlink(socket_path.c_str());
+
+    int lfd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (lfd < 0 || ::bind(lfd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(lfd, 64) != 0) {
+        std::cerr << "cannot listen on " << socket_path.string() << ": " << std::strerror(errno) << "\n";
+        if (lfd >= 0) {
+            ::close(lfd);
+        }
+        return 2;
+    }
+    // Only this user may connect; peer_is_us() below checks again.
+    ::chmod(socket_path.c_str(), 0600);
+    set_nonblocking(lfd);
+
+    m_inotify = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotify < 0) {
+        std::cerr << "inotify_init1: " << std::strerror(errno) << "\n";
+        ::close(lfd);
+        return 2;
+    }
+
+    struct sigaction sa;
+    std::memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_stop_signal;
+    ::sigaction(SIGINT, &sa, nullptr);
+    ::sigaction(SIGTERM, &sa, nullptr);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    std::vector<Client> clients;
+    while (!g_stop) {
+        std::vector<struct pollfd> pfds;
+        pfds.push_back({lfd, POLLIN, 0});
+        pfds.push_back({m_inotify, POLLIN, 0});
+        for (const auto& c : clients) {
+            pfds.push_back({c.fd, static_cast<short>(POLLIN | (c.out.empty() ? 0 : POLLOUT)), 0});
+        }
+
+        if (::poll(pfds.data(), pfds.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        // inotify first, so queries answered below see the latest state.
+        if (pfds[1].revents & POLLIN) {
+            handle_inotify();
+        }
+
+        for (size_t i = 0; i < clients.size(); i++) {
+            Client& c = clients[i];
+            const short rev = pfds[i + 2].revents;
+            bool closed = (rev & (POLLERR | POLLNVAL)) != 0;
+
+            if (!closed && (rev & (POLLIN | POLLHUP))) {
+                char buf[64 * 1024];
+                const ssize_t n = ::read(c.fd, buf, sizeof(buf));
+                if (n > 0) {
+                    c.in.append(buf, static_cast<size_t>(n));
+                    handle_client_input(c);
+                } else if (n == 0 || (errno != EAGAIN && errno != EINTR)) {
+                    closed = true;
+                }
+            }
+            if (!closed && !c.out.empty()) {
+                const ssize_t n = ::write(c.fd, c.out.data(), c.out.size());
+                if (n > 0) {
+                    c.out.erase(0, static_cast<size_t>(n));
+                } else if (n < 0 && errno != EAGAIN && errno != EINTR) {
+                    closed = true;
+                }
+            }
+            if (closed) {
+                ::close(c.fd);
+                c.fd = -1;
+            }
+        }
+        std::erase_if(clients, [](const Client& c) { return c.fd < 0; });
+
+        if (pfds[0].revents & POLLIN) {
+            for (;;) {
+                int fd = ::accept4(lfd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (fd < 0) {
+                    break;
+                }
+                if (!peer_is_us(fd)) {
+                    ::close(fd);
+                    continue;
+                }
+                clients.push_back(Client{fd, {}, {}});
+            }
+        }
+    }
+
+    for (const auto& c : clients) {
+        ::close(c.fd);
+    }
+    ::close(m_inotify);
+    ::close(lfd);
+    ::unlink(socket_path.c_str());
+    return 0;
+}
+
+}
+
+fs::path default_daemon_socket() {
+    if (const char* s = std::getenv("FILETOGGLER_SOCKET"); s && *s) {
+        return s;
+    }
+    if (const char* rt = std::getenv("XDG_RUNTIME_DIR"); rt && *rt) {
+        return fs::path(rt) / "filetoggler.sock";
+    }
+    return fs::path("/tmp") / ("filetoggler-" + std::to_string(::getuid()) + ".sock");
+}
+
+int run_daemon(const fs::path& socket_path, const Config& cfg) {
+    Daemon d(cfg);
+    return d.run(socket_path);
+}
+
+std::unique_ptr<DaemonClient> DaemonClient::connect(const fs::path& socket_path, const Config& cfg) {
+    if (!socket_is_ours(socket_path)) {
+        return nullptr;
+    }
+    int fd = connect_socket(socket_path);
+    if (fd < 0) {
+        return nullptr;
+    }
+    std::unique_ptr<DaemonClient> c(new DaemonClient(fd));
+    if (!peer_is_us(fd)) {
+        return nullptr;
+    }
+    struct timeval tv;
+    tv.tv_sec = kClientTimeoutMs / 1000;
+    tv.tv_usec = (kClientTimeoutMs % 1000) * 1000;
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    c->send(hello_fields(cfg));
+    std::string err;
+    if (!c->receive(nullptr, &err)) {
+        return nullptr;
+    }
+    return c;
+}
+
+DaemonClient::~DaemonClient() {
+    if (m_fd >= 0) {
+        ::close(m_fd);
+    }
+}
+
+void DaemonClient::send(const std::vector<std::string>& fields) {
+    m_out += join_fields(fields);
+    m_out += '\n';
+}
+
+bool DaemonClient::flush() {
+    while (!m_out.empty()) {
+        const ssize_t n = ::send(m_fd, m_out.data(), m_out.size(), MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        m_out.erase(0, static_cast<size_t>(n));
+    }
+    return true;
+}
+
+bool DaemonClient::read_line(std::string* line) {
+    for (;;) {
+        const size_t nl = m_in.find('\n');
+        if (nl != std::string::npos) {
+            line->assign(m_in, 0, nl);
+            m_in.erase(0, nl + 1);
+            return true;
+        }
+        char buf[64 * 1024];
+        const ssize_t n = ::read(m_fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        m_in.append(buf, static_cast<size_t>(n));
+    }
+}
+
+bool DaemonClient::receive(std::vector<std::vector<std::string>>* data, std::string* err) {
+    auto lost = [&] {
+        // A late answer would be taken for the next request's; drop the
+        // connection instead.
+        const bool timed_out = (errno == EAGAIN || errno == EWOULDBLOCK);
+        if (!m_lost) {
+            ::shutdown(m_fd, SHUT_RDWR);
+            m_lost = true;
+        }
+        if (err) {
+            *err = timed_out ? "daemon did not answer" : "daemon connection lost";
+        }
+        return false;
+    };
+    if (m_lost || !flush()) {
+        return lost();
+    }
+    std::string line;
+    while (read_line(&line)) {
+        if (line.starts_with("= ")) {
+            if (data) {
+                data->push_back(split_fields(std::string_view(line).substr(2)));
+            }
+            continue;
+        }
+        if (line == "OK") {
+            return true;
+        }
+        if (err) {
+            *err = line.starts_with("ERR ") ? line.substr(4) : line;
+        }
+        return false;
+    }
+    return lost();
+}
+
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "core.hpp"
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ft {
+
+// Protocol spoken over the daemon's UNIX socket.
+//
+// Requests are single lines of TAB-separated fields; TAB, newline and
+// backslash inside a field are escaped as \t, \n and \\.  Requests may be
+// pipelined; responses come back in request order.  Each response is zero
+// or more data lines starting with "= " followed by a final "OK" or
+// "ERR <message>" line.
+//
+//   HELLO <disabled-dir> <prefix> <suffix> <manifest|-> <metadata>
+//         <probe-timeout-ms> <io-depth> <follow|nofollow>
+//                                            fails unless the Config matches
+//   WATCH <dir>                              load and watch dir
+//   LIST <dir>                               = state type size mtime name
+//   STATE <path>                             = enabled|disabled|missing
+//   ENABLE|DISABLE|TOGGLE <path>
+//   PROFILE <dir> <name>                     apply .disable.d/profile/<name>
+//
+// LIST sends "-" for the size and mtime of an entry whose stat the scan
+// stopped waiting for.  Paths must be absolute.  Consecutive
+// ENABLE/DISABLE/TOGGLE/PROFILE requests are collected and performed as
+// one move_batch().
+
+// $FILETOGGLER_SOCKET, else $XDG_RUNTIME_DIR/filetoggler.sock, else
+// /tmp/filetoggler-<uid>.sock.
+std::filesystem::path default_daemon_socket();
+
+// Serve until SIGINT/SIGTERM.  Returns the process exit status.  The
+// socket is made mode 0600 and connections from other users are closed.
+int run_daemon(const std::filesystem::path& socket_path, const Config& cfg);
+
+class DaemonClient {
+ public:
+    // Connects to a running daemon that uses the same Config; nullptr if
+    // there is none, or if the socket or the daemon behind it belongs to
+    // another user.
+    static std::unique_ptr<DaemonClient> connect(const std::filesystem::path& socket_path, const Config& cfg);
+
+    ~DaemonClient();
+    DaemonClient(const DaemonClient&) = delete;
+    DaemonClient& operator=(const DaemonClient&) = delete;
+
+    // Queue one request; it is written on the next receive().
+    void send(const std::vector<std::string>& fields);
+
+    // Read the response to the oldest unanswered request.  Data lines are
+    // appended to data, if given.  Returns false for "ERR" (message in err)
+    // or a broken connection.  A daemon silent for 5 seconds counts as
+    // broken.
+    bool receive(std::vector<std::vector<std::string>>* data, std::string* err);
+
+    // The connection broke or timed out; every later receive() fails, and
+    // whether the daemon performed the unanswered requests is unknown.
+    bool lost() const { return m_lost; }
+
+ private:
+    explicit DaemonClient(int fd) : m_fd(fd) {}
+
+    bool flush();
+    bool read_line(std::string* line);
+
+    int m_fd{-1};
+    bool m_lost{false};
+    std::string m_out;
+    std::string m_in;
+};
+
+}
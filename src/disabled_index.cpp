@@ -0,0 +1,146 @@
+#include "disabled_index.hpp"
+
+#include "manifest.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+namespace fs = std::filesystem;
+
+namespace ft {
+
+namespace {
+
+size_t count_in(const fs::path& dir, const Config& cfg, const struct timespec& mtime) {
+    DisabledManifest manifest;
+    if (cfg.manifest && manifest.open(dir, cfg, mtime)) {
+        return manifest.size();
+    }
+
+    DIR* d = ::opendir((dir / cfg.disabled_dir).c_str());
+    if (!d) {
+        return 0;
+    }
+    const size_t n = DisabledNameMatcher(cfg).dispatch([d](const auto& undecorate) {
+        size_t count = 0;
+        while (struct dirent* de = ::readdir(d)) {
+            const std::string_view name = de->d_name;
+            if (name == "." || name == ".." || is_manifest_name(name)) {
+                continue;
+            }
+            if (undecorate(name)) {
+                count++;
+            }
+        }
+        return count;
+    });
+    ::closedir(d);
+    return n;
+}
+
+}
+
+size_t count_disabled_entries(const fs::path& dir, const Config& cfg) {
+    struct stat st;
+    if (::stat((dir / cfg.disabled_dir).c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+        return 0;
+    }
+    return count_in(dir, cfg, st.st_mtim);
+}
+
+struct DisabledCountIndex::State {
+    struct Cached {
+        struct timespec mtime;
+        size_t count;
+    };
+
+    Config cfg;
+
+    std::mutex cache_mu;
+    std::unordered_map<std::string, Cached> cache;
+
+    std::mutex mu;
+    std::condition_variable cv;
+    std::deque<fs::path> queue;
+    std::shared_ptr<const Result> result;
+    bool stop{false};
+    std::thread worker;
+
+    size_t count(const fs::path& dir) {
+        struct stat st;
+        if (::stat((dir / cfg.disabled_dir).c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+            std::lock_guard<std::mutex> lk(cache_mu);
+            cache.erase(dir.native());
+            return 0;
+        }
+        {
+            std::lock_guard<std::mutex> lk(cache_mu);
+            auto it = cache.find(dir.native());
+            if (it != cache.end() && it->second.mtime.tv_sec == st.st_mtim.tv_sec
+                    && it->second.mtime.tv_nsec == st.st_mtim.tv_nsec) {
+                return it->second.count;
+            }
+        }
+        const size_t n = count_in(dir, cfg, st.st_mtim);
+        std::lock_guard<std::mutex> lk(cache_mu);
+        cache.insert_or_assign(dir.native(), Cached{st.st_mtim, n});
+        return n;
+    }
+
+    void run() {
+        for (;;) {
+            fs::path dir;
+            std::shared_ptr<const Result> res;
+            {
+                std::unique_lock<std::mutex> lk(mu);
+                cv.wait(lk, [this] { return stop || !queue.empty(); });
+                if (stop) {
+                    return;
+                }
+                dir = std::move(queue.front());
+                queue.pop_front();
+                res = result;
+            }
+            const size_t n = count(dir);
+            (*res)(dir, n);
+        }
+    }
+};
+
+DisabledCountIndex::DisabledCountIndex(Config cfg) : m_state(std::make_unique<State>()) {
+    m_state->cfg = std::move(cfg);
+    m_state->worker = std::thread([st = m_state.get()] { st->run(); });
+}
+
+DisabledCountIndex::~DisabledCountIndex() {
+    {
+        std::lock_guard<std::mutex> lk(m_state->mu);
+        m_state->stop = true;
+        m_state->queue.clear();
+    }
+    m_state->cv.notify_all();
+    m_state->worker.join();
+}
+
+void DisabledCountIndex::request(std::vector<fs::path> dirs, Result result) {
+    {
+        std::lock_guard<std::mutex> lk(m_state->mu);
+        m_state->queue.assign(std::make_move_iterator(dirs.begin()), std::make_move_iterator(dirs.end()));
+        m_state->result = std::make_shared<const Result>(std::move(result));
+    }
+    m_state->cv.notify_all();
+}
+
+size_t DisabledCountIndex::count(const fs::path& dir) {
+    return m_state->count(dir);
+}
+
+}
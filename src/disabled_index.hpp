@@ -0,0 +1,44 @@
+#pragma once
+
+#include "core.hpp"
+
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace ft {
+
+// Number of disabled entries of dir: the decorated names in its disabled
+// dir, from one readdir (or the manifest, when cfg.manifest is set and it
+// is current).  0 if there is no disabled dir.
+size_t count_disabled_entries(const std::filesystem::path& dir, const Config& cfg);
+
+// Disabled-entry counts of many directories, kept up to date on a
+// background thread.  Counts are cached with the mtime of each disabled
+// dir, so checking an unchanged directory costs one stat.
+class DisabledCountIndex {
+ public:
+    // Called on the index thread for each requested directory.
+    using Result = std::function<void(const std::filesystem::path& dir, size_t count)>;
+
+    explicit DisabledCountIndex(Config cfg);
+    // Drops pending work and joins the thread.
+    ~DisabledCountIndex();
+    DisabledCountIndex(const DisabledCountIndex&) = delete;
+    DisabledCountIndex& operator=(const DisabledCountIndex&) = delete;
+
+    // Count every dir, in order, replacing whatever is still pending from
+    // the previous request.
+    void request(std::vector<std::filesystem::path> dirs, Result result);
+
+    // Same on the calling thread, for a single directory.
+    size_t count(const std::filesystem::path& dir);
+
+ private:
+    struct State;
+    std::unique_ptr<State> m_state;
+};
+
+}
@@ -0,0 +1,288 @@
+#include "du.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+namespace fs = std::filesystem;
+
+namespace ft {
+
+namespace {
+
+struct InodeKey {
+    dev_t dev;
+    ino_t ino;
+
+    bool operator==(const InodeKey&) const = default;
+};
+
+struct InodeKeyHash {
+    size_t operator()(const InodeKey& k) const {
+        return std::hash<uint64_t>()(static_cast<uint64_t>(k.ino) * 0x9e3779b97f4a7c15ull ^ static_cast<uint64_t>(k.dev));
+    }
+};
+
+InodeKey key_of(const struct stat& st) {
+    return InodeKey{st.st_dev, st.st_ino};
+}
+
+struct LinkedFile {
+    InodeKey key;
+    std::uintmax_t size;
+};
+
+// One directory's own entries.  Files with more than one link are kept
+// apart so that a walk counts each of them once.
+struct DirRecord {
+    struct timespec mtime;
+    std::uintmax_t bytes{0};
+    std::uint64_t files{0};
+    std::vector<std::string> subdirs;
+    std::vector<LinkedFile> linked;
+};
+
+bool same_mtime(const struct timespec& a, const struct timespec& b) {
+    return a.tv_sec == b.tv_sec && a.tv_nsec == b.tv_nsec;
+}
+
+}
+
+struct DuCache::State {
+    mutable std::mutex mu;
+    std::unordered_map<InodeKey, std::shared_ptr<const DirRecord>, InodeKeyHash> dirs;
+};
+
+DuCache::DuCache() : m_state(std::make_unique<State>()) {}
+
+DuCache::~DuCache() = default;
+
+size_t DuCache::size() const {
+    std::lock_guard<std::mutex> lk(m_state->mu);
+    return m_state->dirs.size();
+}
+
+void DuCache::clear() {
+    std::lock_guard<std::mutex> lk(m_state->mu);
+    m_state->dirs.clear();
+}
+
+struct DuWalk {
+    struct Dir {
+        std::string path;
+        struct stat st;
+    };
+
+    static std::shared_ptr<const DirRecord> lookup(DuCache& cache, const struct stat& st) {
+        std::lock_guard<std::mutex> lk(cache.m_state->mu);
+        auto it = cache.m_state->dirs.find(key_of(st));
+        if (it == cache.m_state->dirs.end() || !same_mtime(it->second->mtime, st.st_mtim)) {
+            return nullptr;
+        }
+        return it->second;
+    }
+
+    static void store(DuCache& cache, const struct stat& st, std::shared_ptr<const DirRecord> rec) {
+        std::lock_guard<std::mutex> lk(cache.m_state->mu);
+        cache.m_state->dirs.insert_or_assign(key_of(st), std::move(rec));
+    }
+
+    // Read dir's entries into a record; its subdirectories on the same
+    // device are also queued on todo, already stat'ed.
+    static std::shared_ptr<const DirRecord> read(const Dir& dir, std::vector<Dir>* todo) {
+        auto rec = std::make_shared<DirRecord>();
+        rec->mtime = dir.st.st_mtim;
+
+        DIR* d = ::opendir(dir.path.c_str());
+        if (!d) {
+            return rec;
+        }
+        const int fd = ::dirfd(d);
+        while (struct dirent* de = ::readdir(d)) {
+            const std::string_view name = de->d_name;
+            if (name == "." || name == "..") {
+                continue;
+            }
+            struct stat st;
+            if (::fstatat(fd, de->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+                continue;
+            }
+            if (S_ISDIR(st.st_mode)) {
+                rec->subdirs.emplace_back(name);
+                if (st.st_dev == dir.st.st_dev) {
+                    todo->push_back(Dir{dir.path + "/" + rec->subdirs.back(), st});
+                }
+            } else if (S_ISREG(st.st_mode)) {
+                const auto size = static_cast<std::uintmax_t>(st.st_size);
+                if (st.st_nlink > 1) {
+                    rec->linked.push_back(LinkedFile{key_of(st), size});
+                } else {
+                    rec->bytes += size;
+                    rec->files++;
+                }
+            }
+        }
+        ::closedir(d);
+        return rec;
+    }
+
+    static TreeSize run(const fs::path& root, DuCache& cache, const std::atomic<bool>& cancel,
+                        const TreeSizeProgress& progress, std::chrono::milliseconds interval) {
+        TreeSize total;
+        std::vector<Dir> todo(1);
+        todo[0].path = root.native();
+        if (::lstat(root.c_str(), &todo[0].st) != 0 || !S_ISDIR(todo[0].st.st_mode)) {
+            total.complete = !cancel.load(std::memory_order_relaxed);
+            return total;
+        }
+
+        std::unordered_set<InodeKey, InodeKeyHash> seen;
+        auto next_report = std::chrono::steady_clock::now() + interval;
+        while (!todo.empty()) {
+            if (cancel.load(std::memory_order_relaxed)) {
+                return total;
+            }
+            Dir dir = std::move(todo.back());
+            todo.pop_back();
+            total.dirs++;
+
+            std::shared_ptr<const DirRecord> rec = lookup(cache, dir.st);
+            if (rec) {
+                // Unchanged: only the subdirectories need a stat, for their
+                // own mtimes.
+                for (const std::string& sub : rec->subdirs) {
+                    Dir child{dir.path + "/" + sub, {}};
+                    if (::lstat(child.path.c_str(), &child.st) == 0 && S_ISDIR(child.st.st_mode)
+                            && child.st.st_dev == dir.st.st_dev) {
+                        todo.push_back(std::move(child));
+                    }
+                }
+            } else {
+                rec = read(dir, &todo);
+                store(cache, dir.st, rec);
+            }
+
+            total.bytes += rec->bytes;
+            total.files += rec->files;
+            for (const LinkedFile& f : rec->linked) {
+                if (seen.insert(f.key).second) {
+                    total.bytes += f.size;
+                    total.files++;
+                }
+            }
+
+            if (progress && std::chrono::steady_clock::now() >= next_report) {
+                progress(total);
+                next_report = std::chrono::steady_clock::now() + interval;
+            }
+        }
+        total.complete = true;
+        return total;
+    }
+};
+
+TreeSize measure_tree(const fs::path& root, DuCache& cache, const std::atomic<bool>& cancel,
+                      const TreeSizeProgress& progress, std::chrono::milliseconds progress_interval) {
+    return DuWalk::run(root, cache, cancel, progress, progress_interval);
+}
+
+struct DuEngine::State {
+    struct Job {
+        fs::path root;
+        size_t index;
+        std::shared_ptr<std::atomic<bool>> cancel;
+        std::shared_ptr<const Progress> progress;
+    };
+
+    std::mutex mu;
+    std::condition_variable cv;
+    std::deque<Job> queue;
+    std::shared_ptr<std::atomic<bool>> cancel;
+    bool stop{false};
+    std::vector<std::thread> workers;
+};
+
+DuEngine::DuEngine(unsigned threads) : m_state(std::make_unique<State>()) {
+    if (threads == 0) {
+        threads = std::clamp(std::thread::hardware_concurrency(), 2u, 8u);
+    }
+    for (unsigned i = 0; i < threads; i++) {
+        m_state->workers.emplace_back([st = m_state.get(), cache = &m_cache] {
+            for (;;) {
+                State::Job job;
+                {
+                    std::unique_lock<std::mutex> lk(st->mu);
+                    st->cv.wait(lk, [st] { return st->stop || !st->queue.empty(); });
+                    if (st->stop) {
+                        return;
+                    }
+                    job = std::move(st->queue.front());
+                    st->queue.pop_front();
+                }
+                const std::atomic<bool>& cancel = *job.cancel;
+                if (cancel.load(std::memory_order_relaxed)) {
+                    continue;
+                }
+                const Progress& progress = *job.progress;
+                TreeSize total = measure_tree(job.root, *cache, cancel, [&](const TreeSize& partial) {
+                    progress(job.index, partial);
+                });
+                if (!cancel.load(std::memory_order_relaxed)) {
+                    progress(job.index, total);
+                }
+            }
+        });
+    }
+}
+
+DuEngine::~DuEngine() {
+    {
+        std::lock_guard<std::mutex> lk(m_state->mu);
+        m_state->stop = true;
+        if (m_state->cancel) {
+            m_state->cancel->store(true);
+        }
+        m_state->queue.clear();
+    }
+    m_state->cv.notify_all();
+    for (std::thread& t : m_state->workers) {
+        t.join();
+    }
+}
+
+void DuEngine::start(std::vector<fs::path> roots, Progress progress) {
+    auto cancel = std::make_shared<std::atomic<bool>>(false);
+    auto shared = std::make_shared<const Progress>(std::move(progress));
+    {
+        std::lock_guard<std::mutex> lk(m_state->mu);
+        if (m_state->cancel) {
+            m_state->cancel->store(true);
+        }
+        m_state->cancel = cancel;
+        m_state->queue.clear();
+        for (size_t i = 0; i < roots.size(); i++) {
+            m_state->queue.push_back(State::Job{std::move(roots[i]), i, cancel, shared});
+        }
+    }
+    m_state->cv.notify_all();
+}
+
+void DuEngine::cancel() {
+    std::lock_guard<std::mutex> lk(m_state->mu);
+    if (m_state->cancel) {
+        m_state->cancel->store(true);
+    }
+    m_state->queue.clear();
+}
+
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace ft {
+
+// Recursive size of a directory tree: the apparent size of its regular
+// files, each hard-linked file counted once.  Symlinks and mount points
+// below the root are not followed.
+struct TreeSize {
+    std::uintmax_t bytes{0};
+    std::uint64_t files{0};
+    std::uint64_t dirs{0};
+    // False for a running total reported while the walk is in progress,
+    // or when it was cancelled.
+    bool complete{false};
+};
+
+// What one directory contributes to the trees it is part of, as of its
+// mtime.  Creating, removing or renaming an entry changes the mtime of the
+// directory; growing a file in place does not, so cached totals can lag
+// until the directory itself changes.
+class DuCache {
+ public:
+    DuCache();
+    ~DuCache();
+    DuCache(const DuCache&) = delete;
+    DuCache& operator=(const DuCache&) = delete;
+
+    size_t size() const;
+    void clear();
+
+ private:
+    friend struct DuWalk;
+    struct State;
+    std::unique_ptr<State> m_state;
+};
+
+using TreeSizeProgress = std::function<void(const TreeSize&)>;
+
+// Walk root and return its size.  progress, if set, receives running
+// totals about every progress_interval and is not called for the final
+// result.  Stops early, returning an incomplete total, once cancel is set.
+TreeSize measure_tree(const std::filesystem::path& root, DuCache& cache, const std::atomic<bool>& cancel,
+                      const TreeSizeProgress& progress = {},
+                      std::chrono::milliseconds progress_interval = std::chrono::milliseconds(100));
+
+// Measures trees on a few background threads, sharing one cache.
+class DuEngine {
+ public:
+    // Called on a worker thread with the index of the root in start(),
+    // for running totals and once more with the complete one.
+    using Progress = std::function<void(size_t root, const TreeSize& size)>;
+
+    explicit DuEngine(unsigned threads = 0);
+    // Cancels outstanding work and joins the workers.
+    ~DuEngine();
+    DuEngine(const DuEngine&) = delete;
+    DuEngine& operator=(const DuEngine&) = delete;
+
+    // Measure every root, cancelling whatever the previous call started.
+    void start(std::vector<std::filesystem::path> roots, Progress progress);
+    void cancel();
+
+    DuCache& cache() { return m_cache; }
+
+ private:
+    struct State;
+
+    DuCache m_cache;
+    std::unique_ptr<State> m_state;
+};
+
+}
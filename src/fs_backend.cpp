@@ -0,0 +1,555 @@
+#include "fs_backend.hpp"
+
+#include "core.hpp"
+
+#include <cerrno>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+namespace fs = std::filesystem;
+
+namespace ft {
+
+namespace {
+
+std::error_code errno_code(int e) {
+    return std::error_code(e, std::generic_category());
+}
+
+fs::file_time_type to_file_time(const struct timespec& ts) {
+    const auto sys = std::chrono::sys_time<std::chrono::nanoseconds>(std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec));
+    return std::chrono::time_point_cast<fs::file_time_type::duration>(std::chrono::file_clock::from_sys(sys));
+}
+
+FsType type_of(mode_t mode) {
+    if (S_ISREG(mode)) return FsType::File;
+    if (S_ISDIR(mode)) return FsType::Dir;
+    if (S_ISLNK(mode)) return FsType::Symlink;
+    return FsType::Other;
+}
+
+FsType type_of_dirent(unsigned char d_type) {
+    switch (d_type) {
+        case DT_REG: return FsType::File;
+        case DT_DIR: return FsType::Dir;
+        case DT_LNK: return FsType::Symlink;
+        case DT_UNKNOWN: return FsType::Unknown;
+        default: return FsType::Other;
+    }
+}
+
+class PosixBackend : public FsBackend {
+ public:
+    bool real_paths() const override { return true; }
+
+    std::error_code stat(const fs::path& p, bool follow, FsStat* out) override {
+        struct stat st;
+        if ((follow ? ::stat(p.c_str(), &st) : ::lstat(p.c_str(), &st)) != 0) {
+            return errno_code(errno);
+        }
+        out->type = type_of(st.st_mode);
+        out->size = S_ISREG(st.st_mode) ? static_cast<std::uintmax_t>(st.st_size) : 0;
+        out->mtime = to_file_time(st.st_mtim);
+        return {};
+    }
+
+    std::error_code read_dir(const fs::path& dir, const DirVisitor& visit) override {
+        DIR* d = ::opendir(dir.c_str());
+        if (!d) {
+            return errno_code(errno);
+        }
+        while (struct dirent* de = ::readdir(d)) {
+            const std::string_view name = de->d_name;
+            if (name == "." || name == "..") {
+                continue;
+            }
+            if (!visit(name, type_of_dirent(de->d_type))) {
+                break;
+            }
+        }
+        ::closedir(d);
+        return {};
+    }
+
+    std::error_code rename(const fs::path& from, const fs::path& to) override {
+        std::error_code ec;
+        fs::rename(from, to, ec);
+        return ec;
+    }
+
+    std::error_code copy_file(const fs::path& from, const fs::path& to) override {
+        std::error_code ec;
+        fs::copy_file(from, to, fs::copy_options::overwrite_existing, ec);
+        return ec;
+    }
+
+    std::error_code copy_tree(const fs::path& from, const fs::path& to) override {
+        std::error_code ec;
+        if (fs::is_directory(from, ec)) {
+            fs::copy(from, to, fs::copy_options::recursive, ec);
+        } else {
+            fs::copy_file(from, to, fs::copy_options::overwrite_existing, ec);
+        }
+        return ec;
+    }
+
+    std::error_code remove(const fs::path& p) override {
+        std::error_code ec;
+        fs::remove(p, ec);
+        return ec;
+    }
+
+    std::error_code remove_all(const fs::path& p) override {
+        std::error_code ec;
+        fs::remove_all(p, ec);
+        return ec;
+    }
+
+    std::error_code create_directories(const fs::path& p) override {
+        std::error_code ec;
+        fs::create_directories(p, ec);
+        return ec;
+    }
+};
+
+// "/a/b/" -> "/a/b"; the root stays "/".
+std::string normalize(const fs::path& p) {
+    std::string s = p.native();
+    while (s.size() > 1 && s.back() == '/') {
+        s.pop_back();
+    }
+    return s;
+}
+
+std::string parent_of(const std::string& p) {
+    const size_t slash = p.rfind('/');
+    return slash == 0 || slash == std::string::npos ? std::string("/") : p.substr(0, slash);
+}
+
+std::string name_of(const std::string& p) {
+    const size_t slash = p.rfind('/');
+    return slash == std::string::npos ? p : p.substr(slash + 1);
+}
+
+std::string child_of(const std::string& dir, std::string_view name) {
+    std::string out = dir;
+    if (out != "/") {
+        out += '/';
+    }
+    out.append(name);
+    return out;
+}
+
+bool is_below(const std::string& p, const std::string& dir) {
+    return p.size() > dir.size() && p.compare(0, dir.size(), dir) == 0 && (dir == "/" || p[dir.size()] == '/');
+}
+
+}
+
+FsBackend& posix_backend() {
+    static PosixBackend backend;
+    return backend;
+}
+
+FsBackend& backend_of(const Config& cfg) {
+    return cfg.backend ? *cfg.backend : posix_backend();
+}
+
+bool uses_posix_backend(const Config& cfg) {
+    return backend_of(cfg).real_paths();
+}
+
+CountingBackend::Counts CountingBackend::counts() const {
+    Counts c;
+    c.stat = m_stat.load();
+    c.lstat = m_lstat.load();
+    c.read_dir = m_read_dir.load();
+    c.rename = m_rename.load();
+    c.copy = m_copy.load();
+    c.remove = m_remove.load();
+    c.mkdir = m_mkdir.load();
+    return c;
+}
+
+void CountingBackend::reset() {
+    for (auto* c : {&m_stat, &m_lstat, &m_read_dir, &m_rename, &m_copy, &m_remove, &m_mkdir}) {
+        c->store(0);
+    }
+}
+
+std::error_code CountingBackend::stat(const fs::path& p, bool follow, FsStat* out) {
+    (follow ? m_stat : m_lstat)++;
+    return m_inner.stat(p, follow, out);
+}
+
+std::error_code CountingBackend::read_dir(const fs::path& dir, const DirVisitor& visit) {
+    m_read_dir++;
+    return m_inner.read_dir(dir, visit);
+}
+
+std::error_code CountingBackend::rename(const fs::path& from, const fs::path& to) {
+    m_rename++;
+    return m_inner.rename(from, to);
+}
+
+std::error_code CountingBackend::copy_file(const fs::path& from, const fs::path& to) {
+    m_copy++;
+    return m_inner.copy_file(from, to);
+}
+
+std::error_code CountingBackend::copy_tree(const fs::path& from, const fs::path& to) {
+    m_copy++;
+    return m_inner.copy_tree(from, to);
+}
+
+std::error_code CountingBackend::remove(const fs::path& p) {
+    m_remove++;
+    return m_inner.remove(p);
+}
+
+std::error_code CountingBackend::remove_all(const fs::path& p) {
+    m_remove++;
+    return m_inner.remove_all(p);
+}
+
+std::error_code CountingBackend::create_directories(const fs::path& p) {
+    m_mkdir++;
+    return m_inner.create_directories(p);
+}
+
+MemoryBackend::MemoryBackend() {
+    m_root.type = FsType::Dir;
+    m_root.mtime = fs::file_time_type::clock::now();
+    m_dirs["/"];
+}
+
+void MemoryBackend::set_latency(const Latency& latency) {
+    std::lock_guard<std::mutex> lk(m_mu);
+    m_latency = latency;
+}
+
+void MemoryBackend::pay(std::chrono::microseconds MemoryBackend::Latency::*which) const {
+    std::chrono::microseconds d;
+    {
+        std::lock_guard<std::mutex> lk(m_mu);
+        d = m_latency.*which;
+    }
+    if (d.count() > 0) {
+        std::this_thread::sleep_for(d);
+    }
+}
+
+void MemoryBackend::add_file(const fs::path& p, std::uintmax_t size, fs::file_time_type mtime) {
+    const std::string path = normalize(p);
+    std::lock_guard<std::mutex> lk(m_mu);
+    mkdirs(parent_of(path));
+    Node n;
+    n.type = FsType::File;
+    n.size = size;
+    n.mtime = mtime;
+    m_dirs[parent_of(path)][name_of(path)] = std::move(n);
+}
+
+void MemoryBackend::add_dir(const fs::path& p) {
+    std::lock_guard<std::mutex> lk(m_mu);
+    mkdirs(normalize(p));
+}
+
+void MemoryBackend::add_symlink(const fs::path& p, const fs::path& target) {
+    const std::string path = normalize(p);
+    std::lock_guard<std::mutex> lk(m_mu);
+    mkdirs(parent_of(path));
+    Node n;
+    n.type = FsType::Symlink;
+    n.mtime = fs::file_time_type::clock::now();
+    n.target = target.native();
+    m_dirs[parent_of(path)][name_of(path)] = std::move(n);
+}
+
+bool MemoryBackend::exists(const fs::path& p) {
+    std::lock_guard<std::mutex> lk(m_mu);
+    return find(normalize(p), false) != nullptr;
+}
+
+MemoryBackend::Node* MemoryBackend::find(const std::string& p, bool follow, std::string* resolved) {
+    std::string path = p;
+    for (int hops = 0; hops < 40; hops++) {
+        if (path == "/") {
+            if (resolved) {
+                *resolved = path;
+            }
+            return &m_root;
+        }
+        auto dir = m_dirs.find(parent_of(path));
+        if (dir == m_dirs.end()) {
+            return nullptr;
+        }
+        auto it = dir->second.find(name_of(path));
+        if (it == dir->second.end()) {
+            return nullptr;
+        }
+        if (!follow || it->second.type != FsType::Symlink) {
+            if (resolved) {
+                *resolved = path;
+            }
+            return &it->second;
+        }
+        const fs::path target(it->second.target);
+        path = normalize((target.is_absolute() ? target : fs::path(parent_of(path)) / target).lexically_normal());
+    }
+    return nullptr;
+}
+
+std::error_code MemoryBackend::mkdirs(const std::string& p) {
+    if (const Node* n = find(p, true); n && n->type == FsType::Dir) {
+        return {};
+    }
+    if (find(p, false)) {
+        return errno_code(EEXIST);
+    }
+    if (std::error_code ec = mkdirs(parent_of(p))) {
+        return ec;
+    }
+    Node n;
+    n.type = FsType::Dir;
+    return link(p, std::move(n));
+}
+
+// Enter node under p, whose parent must be a directory.
+std::error_code MemoryBackend::link(const std::string& p, Node node) {
+    const std::string parent = parent_of(p);
+    auto dir = m_dirs.find(parent);
+    if (dir == m_dirs.end()) {
+        return errno_code(find(parent, false) ? ENOTDIR : ENOENT);
+    }
+    const auto now = fs::file_time_type::clock::now();
+    if (node.type == FsType::Dir) {
+        m_dirs[p];
+        if (node.mtime == fs::file_time_type{}) {
+            node.mtime = now;
+        }
+    }
+    dir->second.insert_or_assign(name_of(p), std::move(node));
+    if (Node* pn = find(parent, false)) {
+        pn->mtime = now;
+    }
+    return {};
+}
+
+void MemoryBackend::copy_below(const std::string& from, const std::string& to) {
+    auto dir = m_dirs.find(from);
+    if (dir == m_dirs.end()) {
+        return;
+    }
+    const Dir entries = dir->second;
+    m_dirs[to] = entries;
+    for (const auto& [name, node] : entries) {
+        if (node.type == FsType::Dir) {
+            copy_below(child_of(from, name), child_of(to, name));
+        }
+    }
+}
+
+void MemoryBackend::drop_below(const std::string& p) {
+    auto dir = m_dirs.find(p);
+    if (dir == m_dirs.end()) {
+        return;
+    }
+    const Dir entries = std::move(dir->second);
+    m_dirs.erase(dir);
+    for (const auto& [name, node] : entries) {
+        if (node.type == FsType::Dir) {
+            drop_below(child_of(p, name));
+        }
+    }
+}
+
+std::error_code MemoryBackend::stat(const fs::path& p, bool follow, FsStat* out) {
+    pay(&Latency::stat);
+    std::lock_guard<std::mutex> lk(m_mu);
+    const Node* n = find(normalize(p), follow);
+    if (!n) {
+        return errno_code(ENOENT);
+    }
+    out->type = n->type;
+    out->size = n->type == FsType::File ? n->size : 0;
+    out->mtime = n->mtime;
+    return {};
+}
+
+std::error_code MemoryBackend::read_dir(const fs::path& dir, const DirVisitor& visit) {
+    pay(&Latency::read_dir);
+    std::vector<std::pair<std::string, FsType>> entries;
+    {
+        std::lock_guard<std::mutex> lk(m_mu);
+        std::string real;
+        const Node* n = find(normalize(dir), true, &real);
+        if (!n) {
+            return errno_code(ENOENT);
+        }
+        if (n->type != FsType::Dir) {
+            return errno_code(ENOTDIR);
+        }
+        auto it = m_dirs.find(real);
+        entries.reserve(it->second.size());
+        for (const auto& [name, node] : it->second) {
+            entries.emplace_back(name, node.type);
+        }
+    }
+    // Visited without the lock: visitors stat as they go.
+    for (const auto& [name, type] : entries) {
+        if (!visit(name, type)) {
+            break;
+        }
+    }
+    return {};
+}
+
+std::error_code MemoryBackend::rename(const fs::path& from, const fs::path& to) {
+    pay(&Latency::rename);
+    const std::string src = normalize(from);
+    const std::string dst = normalize(to);
+    std::lock_guard<std::mutex> lk(m_mu);
+    Node* n = find(src, false);
+    if (!n || src == "/") {
+        return errno_code(ENOENT);
+    }
+    if (src == dst) {
+        return {};
+    }
+    if (is_below(dst, src)) {
+        return errno_code(EINVAL);
+    }
+    if (m_dirs.count(parent_of(dst)) == 0) {
+        return errno_code(ENOENT);
+    }
+    if (const Node* existing = find(dst, false)) {
+        if (existing->type == FsType::Dir && n->type != FsType::Dir) {
+            return errno_code(EISDIR);
+        }
+        if (existing->type != FsType::Dir && n->type == FsType::Dir) {
+            return errno_code(ENOTDIR);
+        }
+        if (existing->type == FsType::Dir && !m_dirs[dst].empty()) {
+            return errno_code(ENOTEMPTY);
+        }
+        drop_below(dst);
+    }
+
+    Node moved = std::move(*n);
+    m_dirs[parent_of(src)].erase(name_of(src));
+    if (Node* pn = find(parent_of(src), false)) {
+        pn->mtime = fs::file_time_type::clock::now();
+    }
+    if (moved.type == FsType::Dir) {
+        // Re-key the directory and everything below it.
+        std::vector<std::string> keys;
+        for (const auto& entry : m_dirs) {
+            if (entry.first == src || is_below(entry.first, src)) {
+                keys.push_back(entry.first);
+            }
+        }
+        for (const std::string& key : keys) {
+            auto node = m_dirs.extract(key);
+            node.key() = dst + key.substr(src.size());
+            m_dirs.insert(std::move(node));
+        }
+    }
+    return link(dst, std::move(moved));
+}
+
+std::error_code MemoryBackend::copy_file_locked(const std::string& from, const std::string& to) {
+    const Node* n = find(from, true);
+    if (!n) {
+        return errno_code(ENOENT);
+    }
+    if (n->type != FsType::File) {
+        return errno_code(n->type == FsType::Dir ? EISDIR : EINVAL);
+    }
+    if (const Node* existing = find(to, true); existing && existing->type == FsType::Dir) {
+        return errno_code(EISDIR);
+    }
+    Node copy;
+    copy.type = FsType::File;
+    copy.size = n->size;
+    copy.mtime = fs::file_time_type::clock::now();
+    return link(to, std::move(copy));
+}
+
+std::error_code MemoryBackend::copy_file(const fs::path& from, const fs::path& to) {
+    pay(&Latency::copy);
+    std::lock_guard<std::mutex> lk(m_mu);
+    return copy_file_locked(normalize(from), normalize(to));
+}
+
+std::error_code MemoryBackend::copy_tree(const fs::path& from, const fs::path& to) {
+    pay(&Latency::copy);
+    const std::string dst = normalize(to);
+    std::lock_guard<std::mutex> lk(m_mu);
+    std::string src;
+    const Node* n = find(normalize(from), true, &src);
+    if (!n) {
+        return errno_code(ENOENT);
+    }
+    if (n->type != FsType::Dir) {
+        return copy_file_locked(src, dst);
+    }
+    if (dst == src || is_below(dst, src)) {
+        return errno_code(EINVAL);
+    }
+    if (std::error_code ec = mkdirs(dst)) {
+        return ec;
+    }
+    copy_below(src, dst);
+    return {};
+}
+
+std::error_code MemoryBackend::remove(const fs::path& p) {
+    pay(&Latency::remove);
+    const std::string path = normalize(p);
+    std::lock_guard<std::mutex> lk(m_mu);
+    const Node* n = find(path, false);
+    if (!n || path == "/") {
+        return errno_code(ENOENT);
+    }
+    if (n->type == FsType::Dir) {
+        if (!m_dirs[path].empty()) {
+            return errno_code(ENOTEMPTY);
+        }
+        m_dirs.erase(path);
+    }
+    m_dirs[parent_of(path)].erase(name_of(path));
+    if (Node* pn = find(parent_of(path), false)) {
+        pn->mtime = fs::file_time_type::clock::now();
+    }
+    return {};
+}
+
+std::error_code MemoryBackend::remove_all(const fs::path& p) {
+    pay(&Latency::remove);
+    const std::string path = normalize(p);
+    std::lock_guard<std::mutex> lk(m_mu);
+    const Node* n = find(path, false);
+    if (!n || path == "/") {
+        return {};
+    }
+    if (n->type == FsType::Dir) {
+        drop_below(path);
+    }
+    m_dirs[parent_of(path)].erase(name_of(path));
+    if (Node* pn = find(parent_of(path), false)) {
+        pn->mtime = fs::file_time_type::clock::now();
+    }
+    return {};
+}
+
+std::error_code MemoryBackend::create_directories(const fs::path& p) {
+    pay(&Latency::mkdir);
+    std::lock_guard<std::mutex> lk(m_mu);
+    return mkdirs(normalize(p));
+}
+
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+
+namespace ft {
+
+struct Config;
+
+enum class FsType {
+    // read_dir() only: the filesystem did not say (DT_UNKNOWN).
+    Unknown,
+    File,
+    Dir,
+    Symlink,
+    Other,
+};
+
+struct FsStat {
+    FsType type{FsType::Other};
+    // Regular files only; 0 otherwise.
+    std::uintmax_t size{0};
+    std::filesystem::file_time_type mtime{};
+};
+
+// The filesystem calls the core makes for scanning and toggling.  Errors
+// are returned as std::error_code, empty on success, with the errno values
+// a POSIX filesystem would report (ENOENT, EEXIST, EXDEV, ...).
+//
+// Implementations are called from several threads at once (the probe pool
+// stats concurrently with the scanning thread).
+class FsBackend {
+ public:
+    using DirVisitor = std::function<bool(std::string_view name, FsType type)>;
+
+    virtual ~FsBackend() = default;
+
+    // The paths name files of the real filesystem.
+    virtual bool real_paths() const { return false; }
+
+    // One stat(2), or lstat(2) without follow.
+    virtual std::error_code stat(const std::filesystem::path& p, bool follow, FsStat* out) = 0;
+    // Entries of dir other than . and .., in no particular order, until
+    // visit returns false.
+    virtual std::error_code read_dir(const std::filesystem::path& dir, const DirVisitor& visit) = 0;
+    virtual std::error_code rename(const std::filesystem::path& from, const std::filesystem::path& to) = 0;
+    // Regular files only; an existing target is overwritten.
+    virtual std::error_code copy_file(const std::filesystem::path& from, const std::filesystem::path& to) = 0;
+    // A file, or a directory with everything below it.
+    virtual std::error_code copy_tree(const std::filesystem::path& from, const std::filesystem::path& to) = 0;
+    virtual std::error_code remove(const std::filesystem::path& p) = 0;
+    virtual std::error_code remove_all(const std::filesystem::path& p) = 0;
+    // Missing parents are created too; an existing directory is not an error.
+    virtual std::error_code create_directories(const std::filesystem::path& p) = 0;
+};
+
+// The real filesystem.
+FsBackend& posix_backend();
+
+// cfg.backend, or the real filesystem.
+FsBackend& backend_of(const Config& cfg);
+
+// True when cfg works on the real filesystem.  The io_uring batches, the
+// manifest and slow-mount detection bypass the backend and are only used
+// then (and are not seen by a CountingBackend).
+bool uses_posix_backend(const Config& cfg);
+
+// Counts the calls made to another backend, for syscall budgets in tests
+// and for --stats.
+class CountingBackend : public FsBackend {
+ public:
+    struct Counts {
+        uint64_t stat{0};
+        uint64_t lstat{0};
+        uint64_t read_dir{0};
+        uint64_t rename{0};
+        uint64_t copy{0};
+        uint64_t remove{0};
+        uint64_t mkdir{0};
+    };
+
+    explicit CountingBackend(FsBackend& inner) : m_inner(inner) {}
+
+    Counts counts() const;
+    void reset();
+
+    bool real_paths() const override { return m_inner.real_paths(); }
+    std::error_code stat(const std::filesystem::path& p, bool follow, FsStat* out) override;
+    std::error_code read_dir(const std::filesystem::path& dir, const DirVisitor& visit) override;
+    std::error_code rename(const std::filesystem::path& from, const std::filesystem::path& to) override;
+    std::error_code copy_file(const std::filesystem::path& from, const std::filesystem::path& to) override;
+    std::error_code copy_tree(const std::filesystem::path& from, const std::filesystem::path& to) override;
+    std::error_code remove(const std::filesystem::path& p) override;
+    std::error_code remove_all(const std::filesystem::path& p) override;
+    std::error_code create_directories(const std::filesystem::path& p) override;
+
+ private:
+    FsBackend& m_inner;
+    std::atomic<uint64_t> m_stat{0};
+    std::atomic<uint64_t> m_lstat{0};
+    std::atomic<uint64_t> m_read_dir{0};
+    std::atomic<uint64_t> m_rename{0};
+    std::atomic<uint64_t> m_copy{0};
+    std::atomic<uint64_t> m_remove{0};
+    std::atomic<uint64_t> m_mkdir{0};
+};
+
+// A filesystem held in memory, for tests and for benchmarks at sizes or
+// latencies the local disk cannot give.  Paths are absolute and taken
+// literally ("." and ".." are not resolved); "/" always exists.  Every call
+// can be made to take a fixed time, paid outside the internal lock so that
+// concurrent callers overlap as they would on a network filesystem.
+class MemoryBackend : public FsBackend {
+ public:
+    struct Latency {
+        std::chrono::microseconds stat{0};
+        std::chrono::microseconds read_dir{0};
+        std::chrono::microseconds rename{0};
+        std::chrono::microseconds copy{0};
+        std::chrono::microseconds remove{0};
+        std::chrono::microseconds mkdir{0};
+    };
+
+    MemoryBackend();
+
+    void set_latency(const Latency& latency);
+
+    // Test setup, without latency.  Missing parents are created.
+    void add_file(const std::filesystem::path& p, std::uintmax_t size = 0,
+                  std::filesystem::file_time_type mtime = std::filesystem::file_time_type::clock::now());
+    void add_dir(const std::filesystem::path& p);
+    void add_symlink(const std::filesystem::path& p, const std::filesystem::path& target);
+    bool exists(const std::filesystem::path& p);
+
+    std::error_code stat(const std::filesystem::path& p, bool follow, FsStat* out) override;
+    std::error_code read_dir(const std::filesystem::path& dir, const DirVisitor& visit) override;
+    std::error_code rename(const std::filesystem::path& from, const std::filesystem::path& to) override;
+    std::error_code copy_file(const std::filesystem::path& from, const std::filesystem::path& to) override;
+    std::error_code copy_tree(const std::filesystem::path& from, const std::filesystem::path& to) override;
+    std::error_code remove(const std::filesystem::path& p) override;
+    std::error_code remove_all(const std::filesystem::path& p) override;
+    std::error_code create_directories(const std::filesystem::path& p) override;
+
+ private:
+    struct Node {
+        FsType type{FsType::File};
+        std::uintmax_t size{0};
+        std::filesystem::file_time_type mtime{};
+        std::string target;
+    };
+    // Children of one directory by name.
+    using Dir = std::map<std::string, Node, std::less<>>;
+
+    // Sleep for the configured latency of one kind of call.
+    void pay(std::chrono::microseconds Latency::*which) const;
+
+    // The caller holds m_mu.  find() sets resolved to the path of the node
+    // found, after following symlinks.
+    Node* find(const std::string& p, bool follow, std::string* resolved = nullptr);
+    std::error_code mkdirs(const std::string& p);
+    std::error_code link(const std::string& p, Node node);
+    std::error_code copy_file_locked(const std::string& from, const std::string& to);
+    void copy_below(const std::string& from, const std::string& to);
+    void drop_below(const std::string& p);
+
+    mutable std::mutex m_mu;
+    Latency m_latency;
+    Node m_root;
+    // Every directory, including "/", by path.
+    std::unordered_map<std::string, Dir> m_dirs;
+};
+
+}
@@ -2,6 +2,12 @@
 
 #include "cli.hpp"
 #include "core.hpp"
+#include "disabled_index.hpp"
+#include "du.hpp"
+#include "name_search.hpp"
+#include "row_format.hpp"
+#include "trace.hpp"
+#include "watchdog.hpp"
 #include "config.h"
 
 #include <wx/artprov.h>
@@ -12,6 +18,7 @@
 #include <wx/msgdlg.h>
 #include <wx/sizer.h>
 #include <wx/splitter.h>
+#include <wx/textctrl.h>
 #include <wx/tglbtn.h>
 
 #include <algorithm>
@@ -19,6 +26,8 @@
 #include <filesystem>
 #include <fstream>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <set>
 #include <string>
@@ -27,11 +36,13 @@
 namespace fs = std::filesystem;
 
 enum {
-    ID_ViewStop = wxID_HIGHEST + 1,
+    ID_EditFilter = wxID_HIGHEST + 1,
+    ID_ViewStop,
     ID_ViewReload,
     ID_ViewReset,
     ID_ViewShowHidden,
     ID_ViewShowBackup,
+    ID_ViewDirSizes,
     ID_ArrangeManually,
     ID_ArrangeName,
     ID_ArrangeSize,
@@ -42,6 +53,7 @@ enum {
     ID_ArrangeExtension,
     ID_ArrangeCompactLayout,
     ID_ArrangeReversedOrder,
+    ID_ArrangeNaturalOrder,
     ID_ViewIcons,
     ID_ViewList,
     ID_ViewCompact,
@@ -54,25 +66,6 @@ namespace ft {
 
 class MainFrame;
 
-static std::string format_size(std::uintmax_t bytes) {
-    const char* units[] = {"B", "KB", "MB", "GB", "TB"};
-    int unit_idx = 0;
-    double size = static_cast<double>(bytes);
-    
-    while (size >= 1024.0 && unit_idx < 4) {
-        size /= 1024.0;
-        unit_idx++;
-    }
-    
-    char buf[64];
-    if (unit_idx == 0) {
-        snprintf(buf, sizeof(buf), "%'.0f %s", size, units[unit_idx]);
-    } else {
-        snprintf(buf, sizeof(buf), "%'.2f %s", size, units[unit_idx]);
-    }
-    return std::string(buf);
-}
-
 static bool relaunch_elevated(const Config&) {
     std::string exe = "filetoggler";
     std::string args = "--chdir \\\"" + fs::current_path().string() + "\\\"";
@@ -109,16 +102,8 @@ static bool relaunch_elevated(const Config&) {
 
 static std::vector<std::string> findInvalidFilesForGui(const std::vector<std::string>& files, const Config& cfg) {
         std::vector<std::string> invalid;
-        std::error_code ec;
         for (const auto& f : files) {
-                fs::path p = f;
-
-                if (fs::exists(p, ec)) {
-                        continue;
-                }
-
-                fs::path dp = disabled_path_for(p, cfg);
-                if (fs::exists(dp, ec)) {
+                if (get_state(fs::path(f), cfg) != FileState::Missing) {
                         continue;
                 }
 
@@ -129,18 +114,42 @@ static std::vector<std::string> findInvalidFilesForGui(const std::vector<std::st
 
 enum class ViewMode { Icons, List, Compact };
 
+class FileListCtrl;
+
+// Lets probe and du threads post late metadata to a list control that may
+// have been destroyed in the meantime.
+struct LateMetaSink {
+    std::mutex mu;
+    FileListCtrl* owner{nullptr};
+};
+
+// Same for disabled counts posted to the main frame by the badge index.
+struct BadgeSink {
+    std::mutex mu;
+    MainFrame* owner{nullptr};
+};
+
+// Deadline for each entry's stat while filling the list, unless one was
+// given on the command line.
+static constexpr unsigned kGuiProbeTimeoutMs = 250;
+
 class FileListCtrl : public wxListCtrl {
  public:
+    // The List view.  Its rows are virtual: the control asks for the text
+    // of the rows it paints, so filling it costs nothing per entry.
+    static constexpr long kReportStyle = wxLC_REPORT | wxLC_VIRTUAL | wxLC_HRULES | wxLC_VRULES;
+
     explicit FileListCtrl(wxWindow* parent, const Config& cfg, MainFrame* frame)
-        : wxListCtrl(parent, wxID_ANY, wxDefaultPosition, wxDefaultSize, wxLC_REPORT | wxLC_HRULES | wxLC_VRULES),
+        : wxListCtrl(parent, wxID_ANY, wxDefaultPosition, wxDefaultSize, kReportStyle),
             m_cfg(cfg), m_frame(frame) {
         m_baseFont = GetFont();
+        m_disabledAttr.SetTextColour(wxColour(160, 160, 160));
         setupImageList();
         setupColumns();
 
         Bind(wxEVT_LIST_ITEM_ACTIVATED, &FileListCtrl::OnActivate, this);
-        Bind(wxEVT_LIST_ITEM_SELECTED, &FileListCtrl::OnSelectionChanged, this);
-        Bind(wxEVT_LIST_ITEM_DESELECTED, &FileListCtrl::OnSelectionChanged, this);
+        Bind(wxEVT_LIST_ITEM_SELECTED, &FileListCtrl::OnItemSelected, this);
+        Bind(wxEVT_LIST_ITEM_DESELECTED, &FileListCtrl::OnItemDeselected, this);
         // Use wxEVT_CHAR so menu accelerators (F5, Ctrl+H/K, etc.) still work.
         Bind(wxEVT_CHAR, &FileListCtrl::OnCharHook, this);
         Bind(wxEVT_LIST_COL_CLICK, &FileListCtrl::OnColumnClick, this);
@@ -150,16 +159,22 @@ class FileListCtrl : public wxListCtrl {
 
         m_typeTimer.Bind(wxEVT_TIMER, &FileListCtrl::OnTypeTimer, this);
         m_renameTimer.Bind(wxEVT_TIMER, &FileListCtrl::OnRenameTimer, this);
+        m_statusTimer.Bind(wxEVT_TIMER, &FileListCtrl::OnStatusTimer, this);
+
+        m_lateSink->owner = this;
     }
 
     ~FileListCtrl() override {
         // Stop timers to avoid callbacks after destruction.
         StopTimers();
+        std::lock_guard<std::mutex> lk(m_lateSink->mu);
+        m_lateSink->owner = nullptr;
     }
     
     void StopTimers() {
         m_typeTimer.Stop();
         m_renameTimer.Stop();
+        m_statusTimer.Stop();
     }
 
     void setupImageList() {
@@ -194,6 +209,8 @@ class FileListCtrl : public wxListCtrl {
     void setArrangeBy(int col) { m_sortColumn = col; refreshEntries(); }
     void setReversedOrderAndRefresh(bool v) { m_reversedOrder = v; refreshEntries(); }
     void setCompactLayoutAndRefresh(bool v) { m_compactLayout = v; refreshEntries(); }
+    NameOrder getNameOrder() const { return m_cfg.name_order; }
+    void setNameOrderAndRefresh(NameOrder order) { m_cfg.name_order = order; refreshEntries(); }
     void zoomIn() { if (m_iconZoom < 8) { m_iconZoom++; applyIconSize(); } }
     void zoomOut() { if (m_iconZoom > -2) { m_iconZoom--; applyIconSize(); } }
     void zoomReset() { m_iconZoom = 0; applyIconSize(); }
@@ -219,12 +236,12 @@ class FileListCtrl : public wxListCtrl {
         }
         refreshEntries();
     }
-    static bool isBackupName(const std::string& name) {
+    static bool isBackupName(std::string_view name) {
         if (name.empty()) return false;
         if (name.back() == '~') return true;
         size_t dot = name.rfind('.');
-        if (dot != std::string::npos) {
-            std::string ext = name.substr(dot + 1);
+        if (dot != std::string_view::npos) {
+            std::string_view ext = name.substr(dot + 1);
             if (ext == "bak" || ext == "swp" || ext == "orig" || ext == "backup") return true;
         }
         return false;
@@ -262,14 +279,28 @@ class FileListCtrl : public wxListCtrl {
 
     void setDir(const fs::path& dir) {
         // logdebug_fmt("setDir: %s <- %s", m_dir.string().c_str(), dir.string().c_str());
+        if (dir != m_dir && filtering()) {
+            // A filter applies to the directory it was typed in.
+            dropFilter();
+            filterDropped();
+        }
         m_dir = dir;
+        if (m_watchdog) {
+            m_watchdog->set_context(dir.string());
+        }
         refreshEntries();
         updateStatusBar();
     }
 
     fs::path getDir() const { return m_dir; }
 
+    // Stall reports name the directory last set.
+    void setWatchdog(StallWatchdog* watchdog) { m_watchdog = watchdog; }
+
     void refreshEntries() {
+        TraceSpan trace("refreshEntries", "gui");
+        TraceSpan phase("refresh.save_view", "gui");
+
         // 1. Save scroll position and focus
         int topItem = GetTopItem();
         int rowHeight = 0;
@@ -286,75 +317,44 @@ class FileListCtrl : public wxListCtrl {
         // Save selected items
         auto selectedNames = getSelectedNames();
         
-        m_entries = list_dir_entries_with_disabled(m_dir, m_cfg);
-        if (!m_showHidden) {
-            m_entries.erase(std::remove_if(m_entries.begin(), m_entries.end(),
-                [](const FileEntry& e) { return !e.display_name.empty() && e.display_name[0] == '.'; }), m_entries.end());
-        }
-        if (!m_showBackup) {
-            m_entries.erase(std::remove_if(m_entries.begin(), m_entries.end(),
-                [this](const FileEntry& e) { return isBackupName(e.display_name); }), m_entries.end());
-        }
+        // Entries whose stat misses its deadline (a hung network mount)
+        // show placeholders and are filled in by applyLateMeta().
+        Config scanCfg = m_cfg;
+        if (scanCfg.probe_timeout_ms == 0) {
+            scanCfg.probe_timeout_ms = kGuiProbeTimeoutMs;
+        }
+        // Hidden and backup files are dropped by name before they are
+        // stat'ed.
+        if (!m_showHidden || !m_showBackup) {
+            scanCfg.name_filter = [showHidden = m_showHidden, showBackup = m_showBackup](std::string_view name) {
+                return (showHidden || !name.starts_with('.')) && (showBackup || !isBackupName(name));
+            };
+        }
+        phase.next("refresh.scan");
+        m_entries = scan_dir_table(m_dir, scanCfg, lateMetaVisitor(++m_scanGeneration));
+        trace.set_count(m_entries.size());
+        phase.next("refresh.sort");
         sortEntries();
         if (m_reversedOrder) {
-            std::reverse(m_entries.begin(), m_entries.end());
+            m_entries.reverse();
         }
-
-        DeleteAllItems();
-        
-        long style = GetWindowStyleFlag();
-        bool isReportMode = (style & wxLC_REPORT) != 0;
-        bool isIconMode = (style & wxLC_ICON) != 0;
-        bool isListMode = (style & wxLC_LIST) != 0;
-        
-        if (isReportMode) {
-            updateColumnHeaders();
+        if (filtering()) {
+            phase.next("refresh.filter");
+            m_scanned = std::move(m_entries);
+            m_scannedIndex.rebuild(m_scanned);
+            m_search.rebuild(m_scanned);
+            m_entries = filteredEntries();
         }
+        phase.next("refresh.index");
+        m_nameIndex.rebuild(m_entries);
+        m_cells.reset(m_entries.size());
 
-        for (size_t i = 0; i < m_entries.size(); i++) {
-            const auto& e = m_entries[i];
-            
-            wxString label;
-            int imageIdx = e.is_dir ? 0 : 1;
-            if (isIconMode || isListMode) {
-                label = wxString::FromUTF8(e.display_name.c_str());
-                long idx = InsertItem(static_cast<long>(i), label, imageIdx);
-                (void)idx;
-            } else {
-                const char* stateIcon = (e.state == FileState::Disabled) ? "\xe2\x9c\x97 " : "\xe2\x9c\x93 ";
-                const char* typeIcon = e.is_dir ? "\xf0\x9f\x93\x81 " : "\xf0\x9f\x93\x84 ";
-                label = wxString::FromUTF8(stateIcon) + wxString::FromUTF8(typeIcon) + wxString::FromUTF8(e.display_name.c_str());
-                long idx = InsertItem(static_cast<long>(i), label);
-
-                // Column 1: Size
-                if (e.is_dir) {
-                    SetItem(idx, 1, "");
-                } else {
-                    SetItem(idx, 1, format_size(e.size));
-                }
-                SetItem(idx, 2, e.is_dir ? "Directory" : "File");
-                wxString mtime_str;
-                {
-                    auto sctp = std::chrono::time_point_cast<std::chrono::system_clock::duration>(
-                        e.mtime - fs::file_time_type::clock::now() + std::chrono::system_clock::now());
-                    std::time_t tt = std::chrono::system_clock::to_time_t(sctp);
-                    mtime_str = wxString::FromUTF8(std::string(std::ctime(&tt)).c_str());
-                    mtime_str.Trim(true);
-                    mtime_str.Trim(false);
-                }
-                SetItem(idx, 3, mtime_str);
-            }
-
-            long idx = static_cast<long>(i);
-            if (e.state == FileState::Disabled) {
-                SetItemTextColour(idx, wxColour(160, 160, 160));
-            }
-        }
+        phase.next("refresh.insert_rows");
+        fillItems();
         
         // 2. Restore selection
-        for (const auto& name : selectedNames) {
-            selectByName(name, false);
-        }
+        phase.next("refresh.restore_selection");
+        reselectNames(selectedNames);
         
         // 3. Restore focus
         if (focusedItem >= 0 && focusedItem < GetItemCount()) {
@@ -362,6 +362,7 @@ class FileListCtrl : public wxListCtrl {
         }
         
         // 4. Restore scroll position
+        phase.next("refresh.restore_scroll");
         // ScrollList is relative, so ensure we are at the top first
         if (GetItemCount() > 0) {
             EnsureVisible(0);
@@ -371,6 +372,64 @@ class FileListCtrl : public wxListCtrl {
         }
         
         updateStatusBar();
+        disabledEntriesChanged();
+
+        if (m_dirSizes) {
+            startDirSizes();
+        }
+    }
+
+    // Show only the entries whose name contains text, ignoring ASCII case;
+    // empty text shows them all.  The directory is not scanned again.
+    void setFilter(const std::string& text) {
+        if (text == m_filter) {
+            return;
+        }
+        TraceSpan trace("setFilter", "gui");
+        const auto selectedNames = getSelectedNames();
+        if (text.empty()) {
+            dropFilter();
+        } else {
+            if (!filtering()) {
+                m_scanned = std::move(m_entries);
+                m_scannedIndex.rebuild(m_scanned);
+                m_search.rebuild(m_scanned);
+            }
+            m_filter = text;
+            m_entries = filteredEntries();
+        }
+        trace.set_count(m_entries.size());
+        m_nameIndex.rebuild(m_entries);
+        m_cells.reset(m_entries.size());
+        fillItems();
+        reselectNames(selectedNames);
+        updateStatusBar();
+    }
+
+    bool filtering() const { return !m_filter.empty(); }
+
+    // Move the focus from the filter box to the rows, onto the first one
+    // if none is selected.
+    void focusRows() {
+        if (selection().empty() && GetItemCount() > 0) {
+            selectSingle(0, true);
+        } else {
+            SetFocus();
+        }
+    }
+
+    bool getDirSizes() const { return m_dirSizes; }
+    void setDirSizes(bool v) {
+        m_dirSizes = v;
+        if (!v) {
+            stopDirSizes();
+        }
+    }
+
+    void stopDirSizes() {
+        if (m_du) {
+            m_du->cancel();
+        }
     }
 
     void EnableSelected(bool backward) {
@@ -385,14 +444,21 @@ class FileListCtrl : public wxListCtrl {
         DoActionOnSelected(Action::Toggle, backward);
     }
     
-    void updateStatusBar();
+    // Repaints the status bar on the next frame; calls in between are
+    // coalesced.
+    void updateStatusBar() {
+        if (!m_statusTimer.IsRunning()) {
+            m_statusTimer.StartOnce(kStatusDelayMs);
+        }
+    }
+    // Lets the frame refresh the tree's disabled-count badges.
+    void disabledEntriesChanged();
     
-    std::vector<FileEntry> getSelectedEntries() {
-        std::vector<FileEntry> result;
-        auto indices = GetSelectedIndices();
-        for (long idx : indices) {
+    std::vector<long> getSelectedRows() {
+        std::vector<long> result;
+        for (long idx : selection()) {
             if (idx >= 0 && static_cast<size_t>(idx) < m_entries.size()) {
-                result.push_back(m_entries[idx]);
+                result.push_back(idx);
             }
         }
         return result;
@@ -400,24 +466,18 @@ class FileListCtrl : public wxListCtrl {
     
     std::vector<std::string> getSelectedNames() {
         std::vector<std::string> result;
-        auto indices = GetSelectedIndices();
-        for (long idx : indices) {
+        for (long idx : selection()) {
             if (idx >= 0 && static_cast<size_t>(idx) < m_entries.size()) {
-                result.push_back(m_entries[idx].display_name);
+                result.emplace_back(m_entries.name(idx));
             }
         }
         return result;
     }
     
     void selectByName(const std::string& name, bool ensureVisible = true) {
-        for (long i = 0; i < GetItemCount(); i++) {
-            if (i >= 0 && static_cast<size_t>(i) < m_entries.size()) {
-                const auto& e = m_entries[i];
-                if (e.display_name == name) {
-                    selectSingle(i, ensureVisible);
-                    break;
-                }
-            }
+        const size_t row = m_nameIndex.find(name);
+        if (row != EntryNameIndex::npos) {
+            selectSingle(static_cast<long>(row), ensureVisible);
         }
     }
 
@@ -426,15 +486,21 @@ class FileListCtrl : public wxListCtrl {
         m_renameTimer.Stop();
         long idx = evt.GetIndex();
         if (idx >= 0 && static_cast<size_t>(idx) < m_entries.size()) {
-            const auto& e = m_entries[idx];
-            if (e.is_dir) {
+            bool isDir = m_entries.is_dir(idx);
+            if (!isDir && m_entries.is_symlink(idx) && m_entries.state(idx) == FileState::Enabled) {
+                // Links are only resolved when opened.
+                auto link = resolve_link(m_entries.enabled_path(idx));
+                isDir = link && link->is_dir;
+            }
+            if (isDir) {
+                const std::string name(m_entries.name(idx));
                 printf("on activate: enabled_path: %s, m_dir: %s, display_name: %s\n", 
-                    e.enabled_path.string().c_str(), m_dir.string().c_str(), e.display_name.c_str());
+                    m_entries.enabled_path(idx).string().c_str(), m_dir.string().c_str(), name.c_str());
 
                 // handleDirActivation(e.enabled_path);
                 // Derive subdirectory from current directory and entry name to
                 // avoid relying on potentially corrupted stored paths.
-                fs::path subdir = m_dir / e.display_name;
+                fs::path subdir = m_dir / name;
                 handleDirActivation(subdir);
                 return;
             }
@@ -488,10 +554,192 @@ class FileListCtrl : public wxListCtrl {
         evt.Skip();
     }
     
-    void OnSelectionChanged(wxListEvent&) {
+    void OnItemSelected(wxListEvent& evt) {
+        trackSelected(evt.GetIndex());
+        updateStatusBar();
+    }
+
+    void OnItemDeselected(wxListEvent& evt) {
+        trackDeselected(evt.GetIndex());
         updateStatusBar();
     }
 
+    void OnStatusTimer(wxTimerEvent&) {
+        if (!IsBeingDeleted()) {
+            paintStatusBar();
+        }
+    }
+
+    void paintStatusBar();
+
+    // Running totals over the selected rows, so that the status bar does
+    // not have to walk the selection on every change.
+    struct SelectionStats {
+        long files{0};
+        long dirs{0};
+        // Dirs with a recursive size, and how many of those are partial.
+        long sizedDirs{0};
+        long partialDirs{0};
+        std::uintmax_t fileBytes{0};
+        std::uintmax_t dirBytes{0};
+    };
+
+    // Add (sign 1) or remove (sign -1) row from m_selStats.
+    void countSelected(long row, int sign) {
+        if (row < 0 || static_cast<size_t>(row) >= m_entries.size()) {
+            return;
+        }
+        const std::uintmax_t size = m_entries.file_size(row);
+        if (m_entries.is_dir(row)) {
+            m_selStats.dirs += sign;
+            if (m_entries.has_tree_size(row)) {
+                m_selStats.sizedDirs += sign;
+                m_selStats.partialDirs += m_entries.tree_size_partial(row) ? sign : 0;
+                m_selStats.dirBytes = sign > 0 ? m_selStats.dirBytes + size : m_selStats.dirBytes - size;
+            }
+        } else {
+            m_selStats.files += sign;
+            m_selStats.fileBytes = sign > 0 ? m_selStats.fileBytes + size : m_selStats.fileBytes - size;
+        }
+    }
+
+    void trackSelected(long row) {
+        if (m_selection.insert(row).second) {
+            countSelected(row, 1);
+        }
+    }
+
+    void trackDeselected(long row) {
+        if (m_selection.erase(row) != 0) {
+            countSelected(row, -1);
+        }
+    }
+
+    void clearTrackedSelection() {
+        m_selection.clear();
+        m_selStats = SelectionStats();
+    }
+
+    // Selected rows, tracked from the selection events.  Some ports do not
+    // send one event per row for range changes; if the count disagrees
+    // with the control's, the set is read back from the control.
+    const std::set<long>& selection() {
+        if (m_selection.size() != static_cast<size_t>(GetSelectedItemCount())) {
+            clearTrackedSelection();
+            for (long idx : GetSelectedIndices()) {
+                trackSelected(idx);
+            }
+        }
+        return m_selection;
+    }
+
+    // Change the metadata of row, keeping the selection totals in step.
+    template <typename Update>
+    void updateRowMeta(size_t row, Update update) {
+        const bool selected = m_selection.count(static_cast<long>(row)) != 0;
+        if (selected) {
+            countSelected(static_cast<long>(row), -1);
+        }
+        update();
+        m_cells.invalidate(row);
+        if (selected) {
+            countSelected(static_cast<long>(row), 1);
+            updateStatusBar();
+        }
+        updateSingleItem(static_cast<long>(row));
+    }
+
+    // Apply update(table, row) to the entry called name, in the view and,
+    // while filtering, in the scan behind it, so that the entry is current
+    // when the filter changes.
+    template <typename Update>
+    void updateNamedRow(std::string_view name, Update update) {
+        if (filtering()) {
+            const size_t row = m_scannedIndex.find(name);
+            if (row != EntryNameIndex::npos) {
+                update(m_scanned, row);
+            }
+        }
+        const size_t row = m_nameIndex.find(name);
+        if (row != EntryNameIndex::npos) {
+            updateRowMeta(row, [&] { update(m_entries, row); });
+        }
+    }
+
+    // The scan rows whose name contains m_filter, in scan order.
+    EntryTable filteredEntries() {
+        EntryTable view = m_scanned;
+        view.permute(m_search.filter(m_filter));
+        return view;
+    }
+
+    // Back to the whole scan.  Leaves the rows for the caller to refill.
+    void dropFilter() {
+        m_filter.clear();
+        m_entries = std::move(m_scanned);
+        m_scanned.clear();
+        m_scannedIndex.clear();
+        m_search.clear();
+    }
+
+    // Lets the frame hide its filter box after dropFilter().
+    void filterDropped();
+
+    // Replace the rows of the control with m_entries.
+    void fillItems() {
+        DeleteAllItems();
+        clearTrackedSelection();
+        if (IsVirtual()) {
+            updateColumnHeaders();
+            SetItemCount(static_cast<long>(m_entries.size()));
+            Refresh();
+            return;
+        }
+        for (size_t i = 0; i < m_entries.size(); i++) {
+            const std::string_view name = m_entries.name(i);
+            const long idx = InsertItem(static_cast<long>(i), wxString::FromUTF8(name.data(), name.size()),
+                                        m_entries.is_dir(i) ? 0 : 1);
+            if (m_entries.state(i) == FileState::Disabled) {
+                SetItemTextColour(idx, wxColour(160, 160, 160));
+            }
+        }
+    }
+
+    void reselectNames(const std::vector<std::string>& names) {
+        for (const auto& name : names) {
+            const size_t row = m_nameIndex.find(name);
+            if (row != EntryNameIndex::npos) {
+                SetItemState(static_cast<long>(row), wxLIST_STATE_SELECTED, wxLIST_STATE_SELECTED);
+                trackSelected(static_cast<long>(row));
+            }
+        }
+    }
+
+    // Rows of the virtual List view.
+    wxString OnGetItemText(long item, long column) const override {
+        if (item < 0 || static_cast<size_t>(item) >= m_entries.size()) {
+            return wxString();
+        }
+        switch (column) {
+            case 0: return reportLabel(item);
+            case 1: return sizeLabel(item);
+            case 2: return typeLabel(m_entries, item);
+            case 3: return mtimeLabel(item);
+            default: return wxString();
+        }
+    }
+
+    int OnGetItemImage(long) const override {
+        return -1;
+    }
+
+    wxItemAttr* OnGetItemAttr(long item) const override {
+        if (item >= 0 && static_cast<size_t>(item) < m_entries.size() && m_entries.state(item) == FileState::Disabled) {
+            return &m_disabledAttr;
+        }
+        return nullptr;
+    }
+
     void OnTypeTimer(wxTimerEvent&) {
         if (!IsBeingDeleted()) {
             m_typeBuffer.clear();
@@ -531,7 +779,8 @@ class FileListCtrl : public wxListCtrl {
         if (idx >= 0 && static_cast<size_t>(idx) < m_entries.size()) {
             wxTextCtrl* edit = GetEditControl();
             if (edit) {
-                edit->SetValue(wxString::FromUTF8(m_entries[idx].display_name.c_str()));
+                const std::string_view name = m_entries.name(idx);
+                edit->SetValue(wxString::FromUTF8(name.data(), name.size()));
             }
         }
     }
@@ -541,9 +790,9 @@ class FileListCtrl : public wxListCtrl {
         long idx = evt.GetIndex();
         if (idx < 0 || static_cast<size_t>(idx) >= m_entries.size()) return;
         std::string newName = evt.GetLabel().ToUTF8().data();
-        if (newName.empty() || newName == m_entries[idx].display_name) return;
+        if (newName.empty() || newName == m_entries.name(idx)) return;
         std::string err;
-        if (!rename_one(m_entries[idx].enabled_path, newName, m_cfg, &err)) {
+        if (!rename_one(m_entries.enabled_path(idx), newName, m_cfg, &err)) {
             wxMessageBox(wxString::FromUTF8(err.c_str()), "Rename failed", wxOK | wxICON_WARNING, this);
             return;
         }
@@ -551,14 +800,37 @@ class FileListCtrl : public wxListCtrl {
         selectByName(newName);
     }
 
-    static std::string getExtension(const std::string& name) {
+    // Directories show their recursive size once the du engine has one,
+    // with an ellipsis while it is still counting.
+    wxString sizeLabel(size_t i) const {
+        return wxString::FromUTF8(m_cells.size(m_entries, i).c_str());
+    }
+
+    wxString mtimeLabel(size_t i) const {
+        return wxString::FromUTF8(m_cells.mtime(m_entries, i).c_str());
+    }
+
+    // The Name column: state and type marks, then the name.
+    wxString reportLabel(size_t i) const {
+        const char* stateIcon = (m_entries.state(i) == FileState::Disabled) ? "\xe2\x9c\x97 " : "\xe2\x9c\x93 ";
+        const char* typeIcon = m_entries.is_symlink(i) ? "\xf0\x9f\x94\x97 " : m_entries.is_dir(i) ? "\xf0\x9f\x93\x81 " : "\xf0\x9f\x93\x84 ";
+        const std::string_view name = m_entries.name(i);
+        return wxString::FromUTF8(stateIcon) + wxString::FromUTF8(typeIcon) + wxString::FromUTF8(name.data(), name.size());
+    }
+
+    static const char* typeLabel(const EntryTable& t, size_t i) {
+        if (t.is_symlink(i)) return "Link";
+        return t.is_dir(i) ? "Directory" : "File";
+    }
+
+    static std::string_view getExtension(std::string_view name) {
         size_t dot = name.rfind('.');
-        if (dot == std::string::npos) return "";
+        if (dot == std::string_view::npos) return "";
         return name.substr(dot + 1);
     }
 
     void sortEntries() {
-        auto cmpStr = [this](const std::string& a, const std::string& b) {
+        auto cmpStr = [this](std::string_view a, std::string_view b) {
             if (m_sortAscending) return a < b;
             return a > b;
         };
@@ -571,35 +843,48 @@ class FileListCtrl : public wxListCtrl {
             return a > b;
         };
 
+        // Collation keys were made by the scan; see EntryTable::sort_key().
+        auto cmpName = [this](const EntryTable& t, uint32_t a, uint32_t b) {
+            int c = t.sort_key(a).compare(t.sort_key(b));
+            if (c == 0) {
+                c = t.name(a).compare(t.name(b));
+            }
+            return m_sortAscending ? c < 0 : c > 0;
+        };
+
+        if (m_sortColumn == 0) {
+            // scan_dir_table() sorted the rows by name already.
+            if (!m_sortAscending) {
+                m_entries.reverse();
+            }
+            return;
+        }
+
         if (m_sortColumn >= 0) {
-            std::sort(m_entries.begin(), m_entries.end(), [&](const FileEntry& a, const FileEntry& b) {
+            const EntryTable& t = m_entries;
+            std::vector<uint32_t> order(t.size());
+            for (size_t i = 0; i < order.size(); i++) {
+                order[i] = static_cast<uint32_t>(i);
+            }
+            std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
                 switch (m_sortColumn) {
-                    case 0: return cmpStr(a.display_name, b.display_name);
-                    case 1: return cmpU64(a.size, b.size);
-                    case 2: return cmpStr(a.is_dir ? "dir" : "file", b.is_dir ? "dir" : "file");
-                    case 3: return cmpTime(a.mtime, b.mtime);
-                    case 4: return cmpU64(a.size, b.size);  // Size on disk (use size)
-                    case 5: return cmpStr(getExtension(a.display_name), getExtension(b.display_name));
-                    case 6: return cmpStr(a.is_dir ? "dir" : "file", b.is_dir ? "dir" : "file");  // Emblems
-                    default: return cmpStr(a.display_name, b.display_name);
+                    case 1: return cmpU64(t.file_size(a), t.file_size(b));
+                    case 2: return cmpStr(typeLabel(t, a), typeLabel(t, b));
+                    case 3: return cmpTime(t.mtime(a), t.mtime(b));
+                    case 4: return cmpU64(t.file_size(a), t.file_size(b));  // Size on disk (use size)
+                    case 5: return cmpStr(getExtension(t.name(a)), getExtension(t.name(b)));
+                    case 6: return cmpStr(typeLabel(t, a), typeLabel(t, b));  // Emblems
+                    default: return cmpName(t, a, b);
                 }
             });
+            m_entries.permute(order);
         }
     }
 
     void JumpToPrefix(const std::string& prefix) {
-        if (m_entries.empty()) {
-            return;
-        }
-
-        for (long i = 0; i < GetItemCount(); i++) {
-            if (i >= 0 && static_cast<size_t>(i) < m_entries.size()) {
-                const auto& e = m_entries[i];
-                if (e.display_name.rfind(prefix, 0) == 0) {
-                    selectSingle(i, true);
-                    break;
-                }
-            }
+        const size_t row = m_nameIndex.first_with_prefix(prefix);
+        if (row != EntryNameIndex::npos) {
+            selectSingle(static_cast<long>(row), true);
         }
     }
 
@@ -616,65 +901,104 @@ class FileListCtrl : public wxListCtrl {
         return sel;
     }
 
-    void updateSingleItem(long idx, const FileEntry& e) {
-        if (idx < 0 || idx >= GetItemCount()) {
+    void updateSingleItem(long idx) {
+        if (idx < 0 || idx >= GetItemCount() || static_cast<size_t>(idx) >= m_entries.size()) {
             return;
         }
-        
-        long style = GetWindowStyleFlag();
-        bool isIconMode = (style & wxLC_ICON) != 0;
-        bool isListMode = (style & wxLC_LIST) != 0;
-        
-        if (isIconMode || isListMode) {
-            // Just update the text
-            wxString label = wxString::FromUTF8(e.display_name.c_str());
-            SetItemText(idx, label);
-            SetItemImage(idx, e.is_dir ? 0 : 1);
-        } else {
-            // Report mode: update all columns
-            const char* stateIcon = (e.state == FileState::Disabled) ? "\xe2\x9c\x97 " : "\xe2\x9c\x93 ";
-            const char* typeIcon = e.is_dir ? "\xf0\x9f\x93\x81 " : "\xf0\x9f\x93\x84 ";
-            wxString label = wxString::FromUTF8(stateIcon) + wxString::FromUTF8(typeIcon) + wxString::FromUTF8(e.display_name.c_str());
-            SetItemText(idx, label);
-            
-            // Column 1: Size
-            if (e.is_dir) {
-                SetItem(idx, 1, "");
-            } else {
-                SetItem(idx, 1, format_size(e.size));
+
+        if (IsVirtual()) {
+            // Repainting asks for the row's text again.
+            RefreshItem(idx);
+            return;
+        }
+
+        // Icons and Compact views show the name only.
+        const std::string_view name = m_entries.name(idx);
+        SetItemText(idx, wxString::FromUTF8(name.data(), name.size()));
+        SetItemImage(idx, m_entries.is_dir(idx) ? 0 : 1);
+        SetItemTextColour(idx, m_entries.state(idx) == FileState::Disabled ? wxColour(160, 160, 160) : wxColour(0, 0, 0));
+    }
+
+    LateMetaVisitor lateMetaVisitor(uint64_t generation) {
+        return [sink = m_lateSink, generation](const ScanEntry& e) {
+            std::lock_guard<std::mutex> lk(sink->mu);
+            if (!sink->owner) {
+                return;
             }
-            SetItem(idx, 2, e.is_dir ? "Directory" : "File");
-            wxString mtime_str;
-            {
-                auto sctp = std::chrono::time_point_cast<std::chrono::system_clock::duration>(
-                    e.mtime - fs::file_time_type::clock::now() + std::chrono::system_clock::now());
-                std::time_t tt = std::chrono::system_clock::to_time_t(sctp);
-                mtime_str = wxString::FromUTF8(std::string(std::ctime(&tt)).c_str());
-                mtime_str.Trim(true);
-                mtime_str.Trim(false);
+            FileListCtrl* owner = sink->owner;
+            owner->CallAfter([owner, generation, name = std::string(e.name), found = e.state != FileState::Missing,
+                              isDir = e.is_dir, isLink = e.is_symlink, size = e.size, mtime = e.mtime] {
+                owner->applyLateMeta(generation, name, found, isDir, isLink, size, mtime);
+            });
+        };
+    }
+
+    // Metadata of a placeholder row arrived from a probe thread.
+    void applyLateMeta(uint64_t generation, const std::string& name, bool found, bool isDir, bool isLink,
+                       std::uintmax_t size, fs::file_time_type mtime) {
+        if (generation != m_scanGeneration || !found) {
+            return;
+        }
+        updateNamedRow(name, [&](EntryTable& t, size_t row) { t.set_meta(row, isDir, size, mtime, isLink); });
+    }
+
+    // Size the directory rows of the current scan in the background, those
+    // hidden by the filter included; the totals arrive through
+    // applyTreeSize().
+    void startDirSizes() {
+        const EntryTable& t = filtering() ? m_scanned : m_entries;
+        std::vector<fs::path> roots;
+        std::vector<std::string> names;
+        for (size_t i = 0; i < t.size(); i++) {
+            if (t.is_dir(i) && !t.is_symlink(i)) {
+                roots.push_back(t.state(i) == FileState::Disabled ? t.disabled_path(i) : t.enabled_path(i));
+                names.emplace_back(t.name(i));
             }
-            SetItem(idx, 3, mtime_str);
         }
-        
-        // Update text color based on state
-        SetItemTextColour(idx, e.state == FileState::Disabled ? wxColour(160, 160, 160) : wxColour(0, 0, 0));
+        if (!m_du) {
+            m_du = std::make_unique<DuEngine>();
+        }
+        m_du->start(std::move(roots), [sink = m_lateSink, generation = m_scanGeneration,
+                                        names = std::move(names)](size_t root, const TreeSize& size) {
+            std::lock_guard<std::mutex> lk(sink->mu);
+            if (!sink->owner) {
+                return;
+            }
+            FileListCtrl* owner = sink->owner;
+            owner->CallAfter([owner, generation, name = names[root], size] {
+                owner->applyTreeSize(generation, name, size);
+            });
+        });
+    }
+
+    void applyTreeSize(uint64_t generation, const std::string& name, const TreeSize& size) {
+        if (generation != m_scanGeneration) {
+            return;
+        }
+        updateNamedRow(name, [&](EntryTable& t, size_t row) { t.set_tree_size(row, size.bytes, size.complete); });
     }
 
     void selectSingle(long idx, bool ensureVisible = true) {
-        // First, clear selection from all items
-        for (long i = 0; i < GetItemCount(); i++) {
-            SetItemState(i, 0, wxLIST_STATE_SELECTED);
+        // First, clear selection from the selected items
+        const std::set<long> previous = selection();
+        for (long i : previous) {
+            if (i != idx) {
+                SetItemState(i, 0, wxLIST_STATE_SELECTED);
+            }
         }
+        clearTrackedSelection();
         
         if (idx >= 0 && idx < GetItemCount()) {
             // Set selection
             SetItemState(idx, wxLIST_STATE_SELECTED, wxLIST_STATE_SELECTED);
+            trackSelected(idx);
             
             // Set focus and scroll when needed
             if (ensureVisible) {
-                // Clear focus from all items first
-                for (long i = 0; i < GetItemCount(); i++) {
-                    SetItemState(i, 0, wxLIST_STATE_FOCUSED);
+                // Only one item has the focus
+                const long focused = GetFocusedItem();
+                if (focused >= 0 && focused != idx) {
+                    SetItemState(focused, 0, wxLIST_STATE_FOCUSED);
                 }
                 SetItemState(idx, wxLIST_STATE_FOCUSED, wxLIST_STATE_FOCUSED);
                 SetFocus();
@@ -694,10 +1018,13 @@ class FileListCtrl : public wxListCtrl {
     }
 
     void DoActionOnSelected(Action act, bool backward) {
-        auto sel = GetSelectedIndices();
+        TraceSpan trace("DoActionOnSelected", "gui");
+        auto sel = getSelectedRows();
         if (sel.empty()) {
             return;
         }
+        trace.set_count(sel.size());
+        TraceSpan phase("action.moves", "gui");
 
         long first = sel.front();
         long last = sel.back();
@@ -712,19 +1039,19 @@ class FileListCtrl : public wxListCtrl {
             if (idx < 0 || static_cast<size_t>(idx) >= m_entries.size()) {
                 continue;
             }
-            const auto& e = m_entries[idx];
+            const fs::path enabledPath = m_entries.enabled_path(idx);
             bool ok = false;
 
             try {
                 switch (act) {
                     case Action::Enable:
-                        ok = enable_one(e.enabled_path, m_cfg, &err);
+                        ok = enable_one(enabledPath, m_cfg, &err);
                         break;
                     case Action::Disable:
-                        ok = disable_one(e.enabled_path, m_cfg, &err);
+                        ok = disable_one(enabledPath, m_cfg, &err);
                         break;
                     case Action::Toggle:
-                        ok = toggle_one(e.enabled_path, m_cfg, &err);
+                        ok = toggle_one(enabledPath, m_cfg, &err);
                         break;
                     case Action::None:
                         ok = true;
@@ -741,15 +1068,21 @@ class FileListCtrl : public wxListCtrl {
             if (ok) {
                 // Update the entry state in our local data
                 if (static_cast<size_t>(idx) < m_entries.size()) {
-                    FileEntry& entry = m_entries[idx];
-                    
                     // Re-check the file state after the operation
                     std::error_code ec;
-                    bool exists = fs::exists(entry.enabled_path, ec);
-                    entry.state = exists ? FileState::Enabled : FileState::Disabled;
+                    // symlink_status: a dangling link is still enabled.
+                    bool exists = fs::exists(fs::symlink_status(enabledPath, ec));
+                    const FileState state = exists ? FileState::Enabled : FileState::Disabled;
+                    m_entries.set_state(idx, state);
+                    if (filtering()) {
+                        const size_t row = m_scannedIndex.find(m_entries.name(idx));
+                        if (row != EntryNameIndex::npos) {
+                            m_scanned.set_state(row, state);
+                        }
+                    }
                     
                     // Update the view for this item only
-                    updateSingleItem(idx, entry);
+                    updateSingleItem(idx);
                     updatedIndices.push_back(idx);
                 }
             }
@@ -759,7 +1092,9 @@ class FileListCtrl : public wxListCtrl {
             }
         }
 
+        phase.next("action.thaw");
         Thaw();
+        phase.next("action.select_next");
 
         if (perm_error) {
             if (relaunch_elevated(m_cfg)) {
@@ -788,12 +1123,31 @@ class FileListCtrl : public wxListCtrl {
         
         // Update status bar
         updateStatusBar();
+        disabledEntriesChanged();
     }
 
     Config m_cfg;
     MainFrame* m_frame;
+    StallWatchdog* m_watchdog{nullptr};
     fs::path m_dir;
-    std::vector<FileEntry> m_entries;
+    EntryTable m_entries;
+    // Bumped by every refresh; late metadata of older scans is dropped.
+    uint64_t m_scanGeneration{0};
+    EntryNameIndex m_nameIndex;
+    // Filled lazily, also from the const virtual row callbacks.
+    mutable EntryCells m_cells;
+    mutable wxListItemAttr m_disabledAttr;
+    // While the filter box holds text, m_entries holds the rows of the
+    // scan that match it and m_scanned the whole scan.
+    std::string m_filter;
+    EntryTable m_scanned;
+    EntryNameIndex m_scannedIndex;
+    NameSearch m_search;
+    std::set<long> m_selection;
+    SelectionStats m_selStats;
+    std::shared_ptr<LateMetaSink> m_lateSink{std::make_shared<LateMetaSink>()};
+    bool m_dirSizes{false};
+    std::unique_ptr<DuEngine> m_du;
 
     int m_sortColumn{0};
     bool m_sortAscending{true};
@@ -809,13 +1163,18 @@ class FileListCtrl : public wxListCtrl {
     std::string m_typeBuffer;
     wxTimer m_renameTimer{this};
     int m_renameItemIndex{-1};
+
+    // About one frame at 60 Hz.
+    static constexpr int kStatusDelayMs = 16;
+    wxTimer m_statusTimer{this};
 };
 
 class MainFrame : public wxFrame {
  public:
-    explicit MainFrame(const Config& cfg, const std::optional<fs::path>& open_dir = std::nullopt)
+    explicit MainFrame(const Config& cfg, const std::optional<fs::path>& open_dir = std::nullopt,
+                       StallWatchdog* watchdog = nullptr)
         : wxFrame(nullptr, wxID_ANY, "filetoggler", wxDefaultPosition, wxSize(1000, 700)),
-            m_cfg(cfg) {
+            m_cfg(cfg), m_watchdog(watchdog) {
         m_splitter = new wxSplitterWindow(this, wxID_ANY);
 
         fs::path start_dir = open_dir.value_or(fs::current_path());
@@ -827,6 +1186,11 @@ class MainFrame : public wxFrame {
         auto* vbox = new wxBoxSizer(wxVERTICAL);
 
         auto* top = new wxBoxSizer(wxHORIZONTAL);
+        // Hidden until Ctrl+F.
+        m_filterBox = new wxTextCtrl(m_rightPanel, wxID_ANY, "", wxDefaultPosition, wxDefaultSize, wxTE_PROCESS_ENTER);
+        m_filterBox->SetHint("Filter by name");
+        m_filterBox->Hide();
+        top->Add(m_filterBox, 1, wxALL | wxALIGN_CENTER_VERTICAL, 4);
         top->AddStretchSpacer(1);
 
         m_btnIcon = new wxToggleButton(m_rightPanel, wxID_ANY, "Icon");
@@ -840,6 +1204,7 @@ class MainFrame : public wxFrame {
         top->Add(m_btnCompact, 0, wxALL, 4);
 
         m_list = new FileListCtrl(m_rightPanel, m_cfg, this);
+        m_list->setWatchdog(m_watchdog);
         m_list->setDir(start_dir);
         
         m_dirHistory.push_back(start_dir);
@@ -860,20 +1225,55 @@ class MainFrame : public wxFrame {
         refreshProfilesForCurrentDir();
 
         Bind(wxEVT_DIRCTRL_SELECTIONCHANGED, &MainFrame::OnDirChanged, this);
+        m_dirCtrl->GetTreeCtrl()->Bind(wxEVT_TREE_ITEM_EXPANDED, &MainFrame::OnTreeExpandedOrCollapsed, this);
+        m_dirCtrl->GetTreeCtrl()->Bind(wxEVT_TREE_ITEM_COLLAPSED, &MainFrame::OnTreeExpandedOrCollapsed, this);
+        m_badgeSink->owner = this;
+        m_badgeTimer.Bind(wxEVT_TIMER, &MainFrame::OnBadgeTimer, this);
+        scheduleBadges();
+        if (m_watchdog) {
+            // Fires only while the event loop runs: a UI thread stuck in a
+            // handler misses its heartbeats.
+            m_heartbeatTimer.Bind(wxEVT_TIMER, &MainFrame::OnHeartbeatTimer, this);
+            m_heartbeatTimer.Start(std::max(10, static_cast<int>(m_watchdog->threshold().count() / 4)));
+        }
         Bind(wxEVT_CHAR_HOOK, &MainFrame::OnCharHook, this);
         Bind(wxEVT_CLOSE_WINDOW, &MainFrame::OnClose, this);
 
         m_btnIcon->Bind(wxEVT_TOGGLEBUTTON, &MainFrame::OnViewModeToggle, this);
         m_btnList->Bind(wxEVT_TOGGLEBUTTON, &MainFrame::OnViewModeToggle, this);
         m_btnCompact->Bind(wxEVT_TOGGLEBUTTON, &MainFrame::OnViewModeToggle, this);
+        m_filterBox->Bind(wxEVT_TEXT, &MainFrame::OnFilterText, this);
+        m_filterBox->Bind(wxEVT_TEXT_ENTER, &MainFrame::OnFilterEnter, this);
     }
     
+    ~MainFrame() override {
+        m_heartbeatTimer.Stop();
+        m_badgeTimer.Stop();
+        std::lock_guard<std::mutex> lk(m_badgeSink->mu);
+        m_badgeSink->owner = nullptr;
+    }
+
     void updateStatusBar(const wxString& text) {
         if (GetStatusBar()) {
             SetStatusText(text);
         }
     }
 
+    // Empty the filter box and hide it, without filtering again.
+    void hideFilterBox() {
+        m_filterBox->ChangeValue("");
+        if (m_filterBox->IsShown()) {
+            m_filterBox->Hide();
+            m_rightPanel->Layout();
+        }
+    }
+
+    // Recount the disabled entries of the expanded tree shortly; repeated
+    // calls in quick succession cause one pass.
+    void scheduleBadges() {
+        m_badgeTimer.StartOnce(kBadgeDelayMs);
+    }
+
  private:
     void createMenuBar() {
         wxMenuBar* menuBar = new wxMenuBar();
@@ -887,6 +1287,8 @@ class MainFrame : public wxFrame {
         editMenu->Append(wxID_ANY, "&Enable\tEnter");
         editMenu->Append(wxID_ANY, "&Disable\tDelete");
         editMenu->Append(wxID_ANY, "&Toggle\tSpace");
+        editMenu->AppendSeparator();
+        editMenu->Append(ID_EditFilter, "&Filter...\tCtrl+F");
         
         wxMenu* viewMenu = new wxMenu();
         viewMenu->Append(ID_ViewStop, "&Stop");
@@ -895,6 +1297,7 @@ class MainFrame : public wxFrame {
         viewMenu->Append(ID_ViewReset, "&Reset view to defaults");
         viewMenu->Append(ID_ViewShowHidden, "Show &hidden files\tCtrl+H", "", wxITEM_CHECK);
         viewMenu->Append(ID_ViewShowBackup, "Show &backup files\tCtrl+K", "", wxITEM_CHECK);
+        viewMenu->Append(ID_ViewDirSizes, "Compute &folder sizes", "", wxITEM_CHECK);
         viewMenu->AppendSeparator();
         wxMenu* arrangeMenu = new wxMenu();
         arrangeMenu->AppendRadioItem(ID_ArrangeManually, "&Manually");
@@ -908,6 +1311,7 @@ class MainFrame : public wxFrame {
         arrangeMenu->AppendSeparator();
         arrangeMenu->AppendCheckItem(ID_ArrangeCompactLayout, "&Compact Layout");
         arrangeMenu->AppendCheckItem(ID_ArrangeReversedOrder, "&Reversed Order");
+        arrangeMenu->AppendCheckItem(ID_ArrangeNaturalOrder, "N&atural Name Order");
         viewMenu->AppendSubMenu(arrangeMenu, "&Arrange Items");
         viewMenu->AppendSeparator();
         viewMenu->Append(wxID_ZOOM_IN, "Zoom &In\tCtrl++");
@@ -936,8 +1340,10 @@ class MainFrame : public wxFrame {
         
         viewMenu->Check(ID_ViewShowHidden, m_list->getShowHidden());
         viewMenu->Check(ID_ViewShowBackup, m_list->getShowBackup());
+        viewMenu->Check(ID_ViewDirSizes, m_list->getDirSizes());
         viewMenu->Check(ID_ArrangeCompactLayout, m_list->getCompactLayout());
         viewMenu->Check(ID_ArrangeReversedOrder, m_list->getReversedOrder());
+        viewMenu->Check(ID_ArrangeNaturalOrder, m_list->getNameOrder() != NameOrder::Bytes);
         arrangeMenu->Check(getArrangeIdForSortColumn(m_list->getSortColumn()), true);
         viewMenu->Check(ID_ViewList, true);
         
@@ -946,12 +1352,14 @@ class MainFrame : public wxFrame {
         Bind(wxEVT_MENU, &MainFrame::OnEnable, this, editMenu->FindItemByPosition(0)->GetId());
         Bind(wxEVT_MENU, &MainFrame::OnDisable, this, editMenu->FindItemByPosition(1)->GetId());
         Bind(wxEVT_MENU, &MainFrame::OnToggle, this, editMenu->FindItemByPosition(2)->GetId());
+        Bind(wxEVT_MENU, &MainFrame::OnFilter, this, ID_EditFilter);
         Bind(wxEVT_MENU, &MainFrame::OnViewStop, this, ID_ViewStop);
         Bind(wxEVT_MENU, &MainFrame::OnViewReload, this, wxID_REFRESH);
         Bind(wxEVT_MENU, &MainFrame::OnViewReset, this, ID_ViewReset);
         Bind(wxEVT_MENU, &MainFrame::OnViewShowHidden, this, ID_ViewShowHidden);
         Bind(wxEVT_MENU, &MainFrame::OnViewShowBackup, this, ID_ViewShowBackup);
-        Bind(wxEVT_MENU, &MainFrame::OnArrange, this, ID_ArrangeManually, ID_ArrangeReversedOrder);
+        Bind(wxEVT_MENU, &MainFrame::OnViewDirSizes, this, ID_ViewDirSizes);
+        Bind(wxEVT_MENU, &MainFrame::OnArrange, this, ID_ArrangeManually, ID_ArrangeNaturalOrder);
         Bind(wxEVT_MENU, &MainFrame::OnZoomIn, this, wxID_ZOOM_IN);
         Bind(wxEVT_MENU, &MainFrame::OnZoomOut, this, wxID_ZOOM_OUT);
         Bind(wxEVT_MENU, &MainFrame::OnZoomNormal, this, wxID_ZOOM_100);
@@ -1000,6 +1408,7 @@ class MainFrame : public wxFrame {
         if (m_list) {
             m_list->StopTimers();
         }
+        m_badgeTimer.Stop();
         
         // Let the default handler destroy the window
         evt.Skip();
@@ -1018,7 +1427,8 @@ class MainFrame : public wxFrame {
     }
 
     void OnViewStop(wxCommandEvent&) {
-        // Stop could cancel an in-progress refresh; no async refresh yet
+        // Scans are synchronous; what runs in the background is sizing.
+        m_list->stopDirSizes();
     }
     void OnViewReload(wxCommandEvent&) {
         m_list->refreshEntries();
@@ -1027,17 +1437,21 @@ class MainFrame : public wxFrame {
     void OnViewReset(wxCommandEvent&) {
         m_list->setShowHidden(false);
         m_list->setShowBackup(false);
+        m_list->setDirSizes(false);
         m_list->setSortColumn(0);
         m_list->setSortAscending(true);
         m_list->setCompactLayoutAndRefresh(false);
         m_list->setReversedOrderAndRefresh(false);
+        m_list->setNameOrderAndRefresh(NameOrder::Bytes);
         m_list->zoomReset();
         setViewMode(ViewMode::List);
         m_list->refreshEntries();
         GetMenuBar()->Check(ID_ViewShowHidden, false);
         GetMenuBar()->Check(ID_ViewShowBackup, false);
+        GetMenuBar()->Check(ID_ViewDirSizes, false);
         GetMenuBar()->Check(ID_ArrangeCompactLayout, false);
         GetMenuBar()->Check(ID_ArrangeReversedOrder, false);
+        GetMenuBar()->Check(ID_ArrangeNaturalOrder, false);
         GetMenuBar()->Check(getArrangeIdForSortColumn(0), true);
         GetMenuBar()->Check(ID_ViewList, true);
         updateCurrentProfileFromDisabled();
@@ -1054,6 +1468,11 @@ class MainFrame : public wxFrame {
         m_list->refreshEntries();
         updateCurrentProfileFromDisabled();
     }
+    void OnViewDirSizes(wxCommandEvent&) {
+        m_list->setDirSizes(!m_list->getDirSizes());
+        GetMenuBar()->Check(ID_ViewDirSizes, m_list->getDirSizes());
+        m_list->refreshEntries();
+    }
     void OnArrange(wxCommandEvent& evt) {
         int id = evt.GetId();
         if (id == ID_ArrangeCompactLayout) {
@@ -1066,6 +1485,14 @@ class MainFrame : public wxFrame {
             GetMenuBar()->Check(ID_ArrangeReversedOrder, m_list->getReversedOrder());
             return;
         }
+        if (id == ID_ArrangeNaturalOrder) {
+            // As file managers do: numbers by value, letters regardless of
+            // case.
+            const bool natural = m_list->getNameOrder() == NameOrder::Bytes;
+            m_list->setNameOrderAndRefresh(natural ? NameOrder::NaturalIgnoreCase : NameOrder::Bytes);
+            GetMenuBar()->Check(ID_ArrangeNaturalOrder, natural);
+            return;
+        }
         int col = getSortColumnForArrangeId(id);
         m_list->setSortColumn(col);
         m_list->setSortAscending(true);
@@ -1112,7 +1539,7 @@ class MainFrame : public wxFrame {
         m_btnIcon->SetValue(mode == ViewMode::Icons);
         m_btnCompact->SetValue(mode == ViewMode::Compact);
         if (mode == ViewMode::List) {
-            m_list->SetWindowStyleFlag(wxLC_REPORT | wxLC_HRULES | wxLC_VRULES);
+            m_list->SetWindowStyleFlag(FileListCtrl::kReportStyle);
             m_list->setupColumns();
         } else if (mode == ViewMode::Icons) {
             m_list->SetWindowStyleFlag(wxLC_ICON);
@@ -1152,12 +1579,12 @@ class MainFrame : public wxFrame {
 
     std::vector<std::string> currentDisabledFilesSorted() const {
         std::vector<std::string> out;
-        auto entries = list_dir_entries_with_disabled(m_list->getDir(), m_cfg);
-        for (const auto& e : entries) {
+        scan_dir(m_list->getDir(), m_cfg, [&out](const ScanEntry& e) {
             if (!e.is_dir && e.state == FileState::Disabled) {
-                out.push_back(e.display_name);
+                out.emplace_back(e.name);
             }
-        }
+            return true;
+        });
         std::sort(out.begin(), out.end());
         return out;
     }
@@ -1269,28 +1696,35 @@ class MainFrame : public wxFrame {
         const auto& prof = m_profiles[index];
         std::set<std::string> target(prof.files.begin(), prof.files.end());
 
-        auto entries = list_dir_entries_with_disabled(m_list->getDir(), m_cfg);
+        TraceSpan trace("switchToProfile", "gui");
+        TraceSpan phase("profile.scan", "gui");
+        EntryTable entries = scan_dir_table(m_list->getDir(), m_cfg);
         std::string err;
 
+        phase.next("profile.enable");
+
         // Enable files not in target
-        for (const auto& e : entries) {
-            if (e.is_dir) continue;
-            bool shouldBeDisabled = target.count(e.display_name) > 0;
-            if (!shouldBeDisabled && e.state == FileState::Disabled) {
-                enable_one(e.enabled_path, m_cfg, &err);
+        for (size_t i = 0; i < entries.size(); i++) {
+            if (entries.is_dir(i)) continue;
+            bool shouldBeDisabled = target.count(std::string(entries.name(i))) > 0;
+            if (!shouldBeDisabled && entries.state(i) == FileState::Disabled) {
+                enable_one(entries.enabled_path(i), m_cfg, &err);
             }
         }
 
         // Disable files that should be disabled
-        for (const auto& e : entries) {
-            if (e.is_dir) continue;
-            bool shouldBeDisabled = target.count(e.display_name) > 0;
-            if (shouldBeDisabled && e.state == FileState::Enabled) {
-                disable_one(e.enabled_path, m_cfg, &err);
+        phase.next("profile.disable");
+        for (size_t i = 0; i < entries.size(); i++) {
+            if (entries.is_dir(i)) continue;
+            bool shouldBeDisabled = target.count(std::string(entries.name(i))) > 0;
+            if (shouldBeDisabled && entries.state(i) == FileState::Enabled) {
+                disable_one(entries.enabled_path(i), m_cfg, &err);
             }
         }
 
+        phase.next("profile.refresh");
         m_list->refreshEntries();
+        phase.next("profile.update");
         updateCurrentProfileFromDisabled();
     }
     
@@ -1306,7 +1740,9 @@ class MainFrame : public wxFrame {
             "  Alt+Right - Go forward\n"
             "  Alt+Up/Down - Switch profile\n\n"
             "Search:\n"
-            "  Type alphanumeric - Find by prefix\n\n"
+            "  Type alphanumeric - Find by prefix\n"
+            "  Ctrl+F - Filter by name as you type\n"
+            "  Escape - Close the filter\n\n"
             "Selection:\n"
             "  Ctrl+Click - Multi-select\n"
             "  Shift+Click - Range select";
@@ -1338,6 +1774,17 @@ class MainFrame : public wxFrame {
         const int code = evt.GetKeyCode();
         const bool alt = evt.AltDown();
         
+        if (m_filterBox->HasFocus()) {
+            if (code == WXK_ESCAPE) {
+                closeFilter();
+                return;
+            }
+            if (code == WXK_DOWN) {
+                m_list->focusRows();
+                return;
+            }
+        }
+
         if (alt && (code == WXK_UP || code == WXK_DOWN)) {
             if (!m_profiles.empty()) {
                 int count = static_cast<int>(m_profiles.size());
@@ -1371,6 +1818,110 @@ class MainFrame : public wxFrame {
         evt.Skip();
     }
     
+    void OnFilter(wxCommandEvent&) {
+        if (!m_filterBox->IsShown()) {
+            m_filterBox->Show();
+            m_rightPanel->Layout();
+        }
+        m_filterBox->SetFocus();
+        m_filterBox->SelectAll();
+    }
+
+    // Every keystroke filters again; see FileListCtrl::setFilter().
+    void OnFilterText(wxCommandEvent&) {
+        m_list->setFilter(std::string(m_filterBox->GetValue().ToUTF8().data()));
+    }
+
+    void OnFilterEnter(wxCommandEvent&) {
+        m_list->focusRows();
+    }
+
+    void closeFilter() {
+        hideFilterBox();
+        m_list->setFilter("");
+        m_list->SetFocus();
+    }
+
+    void OnTreeExpandedOrCollapsed(wxTreeEvent& evt) {
+        // Collapsing deletes the children, so item ids from an earlier
+        // pass may be gone.
+        m_badgeItems.clear();
+        m_badgeGeneration++;
+        scheduleBadges();
+        evt.Skip();
+    }
+
+    void OnHeartbeatTimer(wxTimerEvent&) {
+        m_watchdog->heartbeat();
+    }
+
+    // Ask the index for the disabled counts of every directory shown in
+    // the tree (children of expanded nodes); the results are applied by
+    // applyBadge() as they come in.
+    void OnBadgeTimer(wxTimerEvent&) {
+        wxTreeCtrl* tree = m_dirCtrl->GetTreeCtrl();
+        m_badgeItems.clear();
+        std::vector<fs::path> dirs;
+        // The root item is hidden; every child of it or of an expanded
+        // item is shown.
+        std::vector<wxTreeItemId> expanded{tree->GetRootItem()};
+        while (!expanded.empty()) {
+            const wxTreeItemId parent = expanded.back();
+            expanded.pop_back();
+            void* cookie = nullptr;
+            for (wxTreeItemId c = tree->GetFirstChild(parent, cookie); c.IsOk(); c = tree->GetNextChild(parent, cookie)) {
+                if (auto* data = static_cast<wxDirItemData*>(tree->GetItemData(c))) {
+                    std::string path = data->m_path.ToStdString();
+                    m_badgeItems.emplace(path, c);
+                    dirs.emplace_back(std::move(path));
+                }
+                if (tree->IsExpanded(c)) {
+                    expanded.push_back(c);
+                }
+            }
+        }
+
+        if (!m_badgeIndex) {
+            m_badgeIndex = std::make_unique<DisabledCountIndex>(m_cfg);
+        }
+        m_badgeIndex->request(std::move(dirs), [sink = m_badgeSink, generation = ++m_badgeGeneration](
+                                                   const fs::path& dir, size_t count) {
+            std::lock_guard<std::mutex> lk(sink->mu);
+            if (!sink->owner) {
+                return;
+            }
+            MainFrame* owner = sink->owner;
+            owner->CallAfter([owner, generation, path = dir.string(), count] {
+                owner->applyBadge(generation, path, count);
+            });
+        });
+    }
+
+    // Bold with the count appended for directories holding disabled
+    // entries, the plain name otherwise.
+    void applyBadge(uint64_t generation, const std::string& path, size_t count) {
+        if (generation != m_badgeGeneration) {
+            return;
+        }
+        auto it = m_badgeItems.find(path);
+        if (it == m_badgeItems.end()) {
+            return;
+        }
+        wxTreeCtrl* tree = m_dirCtrl->GetTreeCtrl();
+        auto* data = static_cast<wxDirItemData*>(tree->GetItemData(it->second));
+        if (!data) {
+            return;
+        }
+        wxString label = data->m_name;
+        if (count > 0) {
+            label += wxString::Format(" (%zu)", count);
+        }
+        if (tree->GetItemText(it->second) != label) {
+            tree->SetItemText(it->second, label);
+            tree->SetItemBold(it->second, count > 0);
+        }
+    }
+
     void OnDirChanged(wxTreeEvent&) {
         wxString path = m_dirCtrl->GetPath();
         fs::path newDir = fs::path(path.ToStdString());
@@ -1413,6 +1964,7 @@ class MainFrame : public wxFrame {
     wxToggleButton* m_btnIcon{nullptr};
     wxToggleButton* m_btnList{nullptr};
     wxToggleButton* m_btnCompact{nullptr};
+    wxTextCtrl* m_filterBox{nullptr};
     FileListCtrl* m_list{nullptr};
     ViewMode m_viewMode{ViewMode::List};
     bool m_viewModeUpdating{false};
@@ -1428,6 +1980,16 @@ class MainFrame : public wxFrame {
     std::vector<fs::path> m_dirHistory;
     int m_dirHistoryIndex{0};
     std::map<fs::path, fs::path> m_lastDirInParent;
+
+    static constexpr int kBadgeDelayMs = 200;
+    std::unique_ptr<DisabledCountIndex> m_badgeIndex;
+    std::shared_ptr<BadgeSink> m_badgeSink{std::make_shared<BadgeSink>()};
+    wxTimer m_badgeTimer{this};
+    std::map<std::string, wxTreeItemId> m_badgeItems;
+    uint64_t m_badgeGeneration{0};
+
+    StallWatchdog* m_watchdog;
+    wxTimer m_heartbeatTimer{this};
 };
 
 void FileListCtrl::handleDirActivation(const fs::path& dir) {
@@ -1438,39 +2000,68 @@ void FileListCtrl::handleDirActivation(const fs::path& dir) {
     m_frame->navigateToDir(dir, true);
 }
 
-void FileListCtrl::updateStatusBar() {
+void FileListCtrl::disabledEntriesChanged() {
+    if (m_frame) {
+        m_frame->scheduleBadges();
+    }
+}
+
+void FileListCtrl::filterDropped() {
+    if (m_frame) {
+        m_frame->hideFilterBox();
+    }
+}
+
+void FileListCtrl::paintStatusBar() {
     if (!m_frame) return;
+    TraceSpan trace("paintStatusBar", "gui");
     
-    auto selected = getSelectedEntries();
+    const std::set<long>& selected = selection();
     if (selected.empty()) {
-        m_frame->updateStatusBar(wxString::Format("%zu items", m_entries.size()));
+        if (filtering()) {
+            m_frame->updateStatusBar(wxString::Format("%zu of %zu items match", m_entries.size(), m_scanned.size()));
+        } else {
+            m_frame->updateStatusBar(wxString::Format("%zu items", m_entries.size()));
+        }
     } else if (selected.size() == 1) {
-        const auto& e = selected[0];
-        wxString state = (e.state == FileState::Disabled) ? " (disabled)" : "";
-        if (e.is_dir) {
-            m_frame->updateStatusBar(e.display_name + state + " - Directory");
+        const long row = *selected.begin();
+        const std::string name(m_entries.name(row));
+        wxString state = (m_entries.state(row) == FileState::Disabled) ? " (disabled)" : "";
+        if (m_entries.is_symlink(row)) {
+            const bool disabled = m_entries.state(row) == FileState::Disabled;
+            auto link = resolve_link(disabled ? m_entries.disabled_path(row) : m_entries.enabled_path(row));
+            wxString target = link ? wxString::FromUTF8(link->target.c_str()) : wxString("?");
+            if (link && link->dangling) {
+                target += " (dangling)";
+            }
+            m_frame->updateStatusBar(name + state + wxString::FromUTF8(" \xe2\x86\x92 ") + target);
+        } else if (m_entries.is_dir(row) && m_entries.has_tree_size(row)) {
+            m_frame->updateStatusBar(name + state + " - Directory, " + sizeLabel(row));
+        } else if (m_entries.is_dir(row)) {
+            m_frame->updateStatusBar(name + state + " - Directory");
         } else {
             m_frame->updateStatusBar(wxString::Format("%s%s - %s", 
-                e.display_name, state, format_size(e.size)));
+                name, state, format_size(m_entries.file_size(row))));
         }
     } else {
-        std::uintmax_t totalSize = 0;
-        int fileCount = 0;
-        int dirCount = 0;
-        for (const auto& e : selected) {
-            if (e.is_dir) {
-                dirCount++;
-            } else {
-                fileCount++;
-                totalSize += e.size;
-            }
-        }
+        const long fileCount = m_selStats.files;
+        const long dirCount = m_selStats.dirs;
+        const long sizedDirs = m_selStats.sizedDirs;
+        const bool partial = m_selStats.partialDirs > 0;
+        const std::uintmax_t totalSize = m_selStats.fileBytes;
+        const std::uintmax_t dirSize = m_selStats.dirBytes;
         wxString msg = wxString::Format("%d items selected", static_cast<int>(selected.size()));
         if (fileCount > 0) {
-            msg += wxString::Format(" (%d files, %s)", fileCount, format_size(totalSize));
+            msg += wxString::Format(" (%ld files, %s)", fileCount, format_size(totalSize));
         }
-        if (dirCount > 0) {
-            msg += wxString::Format(" (%d dirs)", dirCount);
+        if (dirCount > 0 && sizedDirs > 0) {
+            // Totals still being counted, or not counted for every dir,
+            // are lower bounds.
+            const bool atLeast = partial || sizedDirs < dirCount;
+            const wxString bound = atLeast ? wxString::FromUTF8("\xe2\x89\xa5 ") : wxString();
+            msg += wxString::Format(" (%ld dirs, ", dirCount) + bound + wxString(format_size(dirSize)) + ")";
+        } else if (dirCount > 0) {
+            msg += wxString::Format(" (%ld dirs)", dirCount);
         }
         m_frame->updateStatusBar(msg);
     }
@@ -1478,14 +2069,15 @@ void FileListCtrl::updateStatusBar() {
 
 class App : public wxApp {
  public:
-    explicit App(const Config& cfg, const std::vector<std::string>& files, const std::optional<fs::path>& open_dir = std::nullopt)
-        : m_cfg(cfg), m_files(files), m_open_dir(open_dir) {}
+    explicit App(const Config& cfg, const std::vector<std::string>& files, const std::optional<fs::path>& open_dir = std::nullopt,
+                 StallWatchdog* watchdog = nullptr)
+        : m_cfg(cfg), m_files(files), m_open_dir(open_dir), m_watchdog(watchdog) {}
 
     bool OnInit() override {
         // Exit when main frame is closed
         SetExitOnFrameDelete(true);
         
-        auto* f = new MainFrame(m_cfg, m_open_dir);
+        auto* f = new MainFrame(m_cfg, m_open_dir, m_watchdog);
         f->Show(true);
 
         const auto invalid = findInvalidFilesForGui(m_files, m_cfg);
@@ -1508,10 +2100,12 @@ class App : public wxApp {
     Config m_cfg;
     std::vector<std::string> m_files;
     std::optional<fs::path> m_open_dir;
+    StallWatchdog* m_watchdog;
 };
 
-int run_gui(const Config& cfg, const std::vector<std::string>& files, const std::optional<fs::path>& open_dir) {
-    wxApp::SetInstance(new App(cfg, files, open_dir));
+int run_gui(const Config& cfg, const std::vector<std::string>& files, const std::optional<fs::path>& open_dir,
+            StallWatchdog* watchdog) {
+    wxApp::SetInstance(new App(cfg, files, open_dir, watchdog));
     int argc = 0;
     char** argv = nullptr;
     wxEntryStart(argc, argv);
@@ -13,6 +13,11 @@ namespace fs = std::filesystem;
 
 namespace ft {
 
-int run_gui(const Config& cfg, const std::vector<std::string>& files, const std::optional<fs::path>& open_dir = std::nullopt);
+class StallWatchdog;
+
+// watchdog, if any, gets heartbeats from the event loop and the directory
+// being shown.
+int run_gui(const Config& cfg, const std::vector<std::string>& files, const std::optional<fs::path>& open_dir = std::nullopt,
+            StallWatchdog* watchdog = nullptr);
 
 }
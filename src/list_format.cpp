@@ -0,0 +1,140 @@
+#include "list_format.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+namespace fs = std::filesystem;
+
+namespace ft {
+
+static long long to_unix_seconds(fs::file_time_type t) {
+    const auto sys = std::chrono::file_clock::to_sys(t);
+    return std::chrono::duration_cast<std::chrono::seconds>(sys.time_since_epoch()).count();
+}
+
+// Length of the well-formed UTF-8 sequence at the start of s (RFC 3629),
+// or 0 if there is none.
+static size_t utf8_sequence_length(std::string_view s) {
+    const auto byte = [&](size_t i) { return static_cast<unsigned char>(s[i]); };
+    const unsigned char b = byte(0);
+    size_t len = 0;
+    unsigned char lo = 0x80;
+    unsigned char hi = 0xbf;
+    if (b < 0x80) {
+        return 1;
+    } else if (b >= 0xc2 && b <= 0xdf) {
+        len = 2;
+    } else if (b >= 0xe0 && b <= 0xef) {
+        len = 3;
+        lo = (b == 0xe0) ? 0xa0 : 0x80;  // no overlong forms
+        hi = (b == 0xed) ? 0x9f : 0xbf;  // no surrogates
+    } else if (b >= 0xf0 && b <= 0xf4) {
+        len = 4;
+        lo = (b == 0xf0) ? 0x90 : 0x80;  // no overlong forms
+        hi = (b == 0xf4) ? 0x8f : 0xbf;  // nothing past U+10FFFF
+    } else {
+        return 0;
+    }
+    if (s.size() < len || byte(1) < lo || byte(1) > hi) {
+        return 0;
+    }
+    for (size_t i = 2; i < len; i++) {
+        if (byte(i) < 0x80 || byte(i) > 0xbf) {
+            return 0;
+        }
+    }
+    return len;
+}
+
+EntryType entry_type(const ScanEntry& e) {
+    if (e.is_symlink) {
+        return EntryType::Link;
+    }
+    return e.is_dir ? EntryType::Dir : EntryType::File;
+}
+
+const char* entry_type_name(EntryType t) {
+    switch (t) {
+        case EntryType::Dir: return "dir";
+        case EntryType::Link: return "link";
+        case EntryType::File: break;
+    }
+    return "file";
+}
+
+void write_tsv_field(std::ostream& out, std::string_view s) {
+    for (char c : s) {
+        switch (c) {
+            case '\t': out << "\\t"; break;
+            case '\n': out << "\\n"; break;
+            case '\r': out << "\\r"; break;
+            case '\\': out << "\\\\"; break;
+            default: out << c; break;
+        }
+    }
+}
+
+void write_json_string(std::ostream& out, std::string_view s) {
+    out << '"';
+    for (size_t i = 0; i < s.size();) {
+        const char c = s[i];
+        switch (c) {
+            case '"': out << "\\\""; i++; continue;
+            case '\\': out << "\\\\"; i++; continue;
+            case '\n': out << "\\n"; i++; continue;
+            case '\r': out << "\\r"; i++; continue;
+            case '\t': out << "\\t"; i++; continue;
+            default: break;
+        }
+        if (static_cast<unsigned char>(c) < 0x20) {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", static_cast<unsigned>(c));
+            out << buf;
+            i++;
+            continue;
+        }
+        const size_t len = utf8_sequence_length(s.substr(i));
+        if (len == 0) {
+            out << "\\ufffd";
+            i++;
+            continue;
+        }
+        out << s.substr(i, len);
+        i += len;
+    }
+    out << '"';
+}
+
+void write_list_entry(std::ostream& out, std::string_view prefix, const ScanEntry& e, ListFormat format) {
+    const char* state = (e.state == FileState::Disabled) ? "disabled" : "enabled";
+    const char* type = entry_type_name(entry_type(e));
+    switch (format) {
+        case ListFormat::Nul:
+            out << prefix << e.name << '\0';
+            break;
+        case ListFormat::Tsv:
+            out << state << '\t' << type << '\t';
+            if (e.meta_pending) {
+                out << "-\t-\t";
+            } else {
+                out << e.size << '\t' << to_unix_seconds(e.mtime) << '\t';
+            }
+            write_tsv_field(out, prefix);
+            write_tsv_field(out, e.name);
+            out << '\n';
+            break;
+        case ListFormat::Json:
+            out << "{\"name\":";
+            write_json_string(out, std::string(prefix) + std::string(e.name));
+            out << ",\"state\":\"" << state << "\",\"type\":\"" << type << "\"";
+            if (e.meta_pending) {
+                out << ",\"size\":null,\"mtime\":null}\n";
+            } else {
+                out << ",\"size\":" << e.size << ",\"mtime\":" << to_unix_seconds(e.mtime) << "}\n";
+            }
+            break;
+    }
+}
+
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "core.hpp"
+
+#include <ostream>
+#include <string_view>
+
+namespace ft {
+
+enum class ListFormat {
+    Tsv,
+    Nul,
+    Json,
+};
+
+enum class EntryType {
+    File,
+    Dir,
+    Link,
+};
+
+EntryType entry_type(const ScanEntry& e);
+// "file", "dir" or "link".
+const char* entry_type_name(EntryType t);
+
+// s with tab, newline, carriage return and backslash escaped as \t, \n,
+// \r and \\; other bytes are written as they are.
+void write_tsv_field(std::ostream& out, std::string_view s);
+
+// s as a quoted JSON string.  Names are bytes, not necessarily UTF-8: a
+// byte that does not start a valid UTF-8 sequence (stray continuation
+// bytes, overlong forms, surrogates, values past U+10FFFF, truncated
+// sequences) is replaced by U+FFFD, written as \ufffd, so the output is
+// always valid JSON.  Control characters are escaped.
+void write_json_string(std::ostream& out, std::string_view s);
+
+// One --list line for entry e of the directory printed as prefix.
+void write_list_entry(std::ostream& out, std::string_view prefix, const ScanEntry& e, ListFormat format);
+
+}
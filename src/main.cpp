@@ -1,10 +1,14 @@
 #include "cli.hpp"
 #include "gui.hpp"
+#include "trace.hpp"
+#include "watchdog.hpp"
 
 #include <bas/proc/dbgthread.h>
 #include <bas/proc/stackdump.h>
 
+#include <chrono>
 #include <iostream>
+#include <memory>
 #include <string>
 
 int main(int argc, char** argv) {
@@ -26,13 +30,26 @@ int main(int argc, char** argv) {
         return ft::run_completion(args);
     }
 
+    // Written by trace_stop() at exit.
+    if (args.trace_file && !ft::trace_start(*args.trace_file, &err)) {
+        std::cerr << err << "\n";
+        return 2;
+    }
+
     if (args.mode == ft::RunMode::Cli) {
         return ft::run_cli(args);
     }
 
     void* ctx = start_dbg_thread();
 
-    int status = ft::run_gui(args.cfg, args.files, args.open_dir);
+    // Watches this thread, which runs the wx event loop.
+    std::unique_ptr<ft::StallWatchdog> watchdog;
+    if (args.stall_timeout_ms > 0) {
+        watchdog = std::make_unique<ft::StallWatchdog>(std::chrono::milliseconds(args.stall_timeout_ms));
+    }
+
+    int status = ft::run_gui(args.cfg, args.files, args.open_dir, watchdog.get());
+    watchdog.reset();
 
     stop_dbg_thread(ctx);
     
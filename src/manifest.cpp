@@ -0,0 +1,488 @@
+#include "manifest.hpp"
+
+#include "fs_backend.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace ft {
+
+namespace {
+
+// On-disk layout, native byte order:
+//   Header, prefix bytes, suffix bytes, padding to a multiple of 4,
+//   uint32_t offsets[count + 1] (relative to the name blob),
+//   name blob,
+//   then one Record, removed name, added name and uint32_t total size of
+//   the three per move made since (the journal).  The trailing size lets
+//   a writer find the last record without reading the others.
+struct Header {
+    char magic[4];
+    uint32_t version;
+    // mtime of the disabled dir the names were read at, and the clock
+    // time of that read.
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    int64_t read_sec;
+    int64_t read_nsec;
+    uint32_t count;
+    uint32_t prefix_len;
+    uint32_t suffix_len;
+    uint32_t reserved;
+};
+
+struct Record {
+    // mtime of the disabled dir after the move, or zero on all but the
+    // last record of a batch.
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    uint32_t removed_len;
+    uint32_t added_len;
+};
+
+constexpr char kMagic[4] = {'F', 'T', 'M', 'F'};
+constexpr uint32_t kVersion = 2;
+
+// A journal longer than this, or than the names themselves, is folded
+// into a rebuilt manifest, so that n moves cost O(n) writes in total.
+constexpr size_t kMinJournalBytes = 4096;
+
+size_t offsets_start(const Header& h) {
+    const size_t end = sizeof(Header) + h.prefix_len + h.suffix_len;
+    return (end + alignof(uint32_t) - 1) & ~(alignof(uint32_t) - 1);
+}
+
+fs::path manifest_path(const fs::path& dir, const Config& cfg) {
+    return dir / cfg.disabled_dir / std::string(kManifestName);
+}
+
+int64_t to_ns(int64_t sec, int64_t nsec) {
+    return sec * 1000000000 + nsec;
+}
+
+bool same_time(const struct timespec& a, int64_t sec, int64_t nsec) {
+    return a.tv_sec == sec && a.tv_nsec == nsec;
+}
+
+// Window within which the kernel may give two changes of a directory the
+// same mtime: a tick of the coarse clock inode times come from, or a
+// whole second on filesystems that store no fractions.
+int64_t mtime_granularity_ns(int64_t mtime_nsec) {
+    struct timespec res;
+    if (mtime_nsec == 0) {
+        return 1000000000;
+    }
+    if (::clock_getres(CLOCK_REALTIME_COARSE, &res) != 0) {
+        return 10000000;
+    }
+    return to_ns(res.tv_sec, res.tv_nsec);
+}
+
+// The names were read so soon after the recorded mtime that a change
+// right after the read could have left the mtime as it was (git's "racy
+// clean" entries).  Such a manifest cannot be trusted.
+bool racy(const Header& h) {
+    return to_ns(h.read_sec, h.read_nsec) - to_ns(h.mtime_sec, h.mtime_nsec) < mtime_granularity_ns(h.mtime_nsec);
+}
+
+// Record in h the mtime of the disabled dir dd ahead of reading it.  If
+// that mtime is too recent for the read to be trusted, wait until the
+// clock has moved past it, so that any later change shows in the mtime.
+bool stamp_before_read(const fs::path& dd, Header* h) {
+    for (int attempt = 0;; attempt++) {
+        struct stat st;
+        struct timespec now;
+        if (::stat(dd.c_str(), &st) != 0 || ::clock_gettime(CLOCK_REALTIME, &now) != 0) {
+            return false;
+        }
+        h->mtime_sec = st.st_mtim.tv_sec;
+        h->mtime_nsec = st.st_mtim.tv_nsec;
+        h->read_sec = now.tv_sec;
+        h->read_nsec = now.tv_nsec;
+        // Still racy after a few tries: the directory is busy.  The
+        // manifest is written anyway and ignored until the next rebuild.
+        if (!racy(*h) || attempt == 2) {
+            return true;
+        }
+        const int64_t wait = mtime_granularity_ns(h->mtime_nsec) - (to_ns(h->read_sec, h->read_nsec) - to_ns(h->mtime_sec, h->mtime_nsec));
+        std::this_thread::sleep_for(std::chrono::nanoseconds(wait));
+    }
+}
+
+size_t record_size(const Record& rec) {
+    return sizeof(Record) + rec.removed_len + rec.added_len + sizeof(uint32_t);
+}
+
+// Size of the record that starts the len bytes at p, stored into rec; 0
+// if they do not hold a whole record.
+size_t first_record(const char* p, size_t len, Record* rec) {
+    if (len < sizeof(Record) + sizeof(uint32_t)) {
+        return 0;
+    }
+    std::memcpy(rec, p, sizeof(*rec));
+    const size_t total = record_size(*rec);
+    uint32_t trailer = 0;
+    if (total > len) {
+        return 0;
+    }
+    std::memcpy(&trailer, p + total - sizeof(trailer), sizeof(trailer));
+    return trailer == total ? total : 0;
+}
+
+// The record that ends the len bytes of journal at p.
+bool last_record(const char* p, size_t len, Record* rec) {
+    uint32_t total = 0;
+    if (len < sizeof(total)) {
+        return false;
+    }
+    std::memcpy(&total, p + len - sizeof(total), sizeof(total));
+    return total <= len && first_record(p + len - total, total, rec) == total;
+}
+
+bool write_all(int fd, const char* p, size_t n, off_t at) {
+    while (n > 0) {
+        const ssize_t w = ::pwrite(fd, p, n, at);
+        if (w < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        p += w;
+        n -= static_cast<size_t>(w);
+        at += w;
+    }
+    return true;
+}
+
+}
+
+DisabledManifest::~DisabledManifest() {
+    close();
+}
+
+DisabledManifest::DisabledManifest(DisabledManifest&& other) noexcept {
+    *this = std::move(other);
+}
+
+DisabledManifest& DisabledManifest::operator=(DisabledManifest&& other) noexcept {
+    if (this != &other) {
+        close();
+        m_data = std::exchange(other.m_data, nullptr);
+        m_len = std::exchange(other.m_len, 0);
+        m_count = std::exchange(other.m_count, 0);
+        m_offsets = std::exchange(other.m_offsets, nullptr);
+        m_names = std::exchange(other.m_names, nullptr);
+        m_base_len = std::exchange(other.m_base_len, 0);
+        m_journal_len = std::exchange(other.m_journal_len, 0);
+        m_merged = std::move(other.m_merged);
+        m_journaled = std::exchange(other.m_journaled, false);
+        m_dev = std::exchange(other.m_dev, 0);
+        m_ino = std::exchange(other.m_ino, 0);
+    }
+    return *this;
+}
+
+void DisabledManifest::close() {
+    if (m_data) {
+        ::munmap(const_cast<char*>(m_data), m_len);
+    }
+    m_data = nullptr;
+    m_len = 0;
+    m_count = 0;
+    m_offsets = nullptr;
+    m_names = nullptr;
+    m_base_len = 0;
+    m_journal_len = 0;
+    m_merged.clear();
+    m_journaled = false;
+    m_dev = 0;
+    m_ino = 0;
+}
+
+bool DisabledManifest::open(const fs::path& dir, const Config& cfg) {
+    struct stat dst;
+    if (::stat((dir / cfg.disabled_dir).c_str(), &dst) != 0) {
+        close();
+        return false;
+    }
+    return open(dir, cfg, dst.st_mtim);
+}
+
+bool DisabledManifest::open(const fs::path& dir, const Config& cfg, const struct timespec& mtime) {
+    return open(dir, cfg, mtime, true);
+}
+
+bool DisabledManifest::open(const fs::path& dir, const Config& cfg, const struct timespec& mtime, bool merge) {
+    close();
+
+    int fd = ::open(manifest_path(dir, cfg).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header)) {
+        ::close(fd);
+        return false;
+    }
+    const size_t len = static_cast<size_t>(st.st_size);
+    void* p = ::mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        return false;
+    }
+    m_data = static_cast<const char*>(p);
+    m_len = len;
+    m_dev = st.st_dev;
+    m_ino = st.st_ino;
+
+    Header h;
+    std::memcpy(&h, m_data, sizeof(h));
+    const size_t table = offsets_start(h);
+    const size_t blob = table + (size_t{h.count} + 1) * sizeof(uint32_t);
+    const bool valid = std::memcmp(h.magic, kMagic, sizeof(kMagic)) == 0
+        && h.version == kVersion
+        && !racy(h)
+        && blob <= len
+        && std::string_view(m_data + sizeof(Header), h.prefix_len) == cfg.disabled_prefix
+        && std::string_view(m_data + sizeof(Header) + h.prefix_len, h.suffix_len) == cfg.disabled_suffix;
+    if (!valid) {
+        close();
+        return false;
+    }
+    m_offsets = reinterpret_cast<const uint32_t*>(m_data + table);
+    m_names = m_data + blob;
+    m_count = h.count;
+    if (m_offsets[m_count] > len - blob) {
+        close();
+        return false;
+    }
+    m_base_len = blob + m_offsets[m_count];
+    m_journal_len = len - m_base_len;
+
+    // The mtime the journal brings the names to is that of its last
+    // record.  A record cut short by a concurrent append fails the check
+    // of its trailing size; the manifest is then taken as stale.
+    int64_t sec = h.mtime_sec;
+    int64_t nsec = h.mtime_nsec;
+    if (m_journal_len != 0) {
+        Record last;
+        if (!last_record(m_data + m_base_len, m_journal_len, &last)) {
+            close();
+            return false;
+        }
+        sec = last.mtime_sec;
+        nsec = last.mtime_nsec;
+    }
+    if (!same_time(mtime, sec, nsec)) {
+        close();
+        return false;
+    }
+
+    if (merge && m_journal_len != 0) {
+        // Replay the journal: the last move of each name wins.
+        std::map<std::string_view, bool> moved;  // name -> disabled
+        for (size_t pos = m_base_len; pos != len;) {
+            Record rec;
+            const size_t total = first_record(m_data + pos, len - pos, &rec);
+            if (total == 0) {
+                close();
+                return false;
+            }
+            const char* names = m_data + pos + sizeof(Record);
+            pos += total;
+            if (rec.removed_len != 0) {
+                moved[std::string_view(names, rec.removed_len)] = false;
+            }
+            if (rec.added_len != 0) {
+                moved[std::string_view(names + rec.removed_len, rec.added_len)] = true;
+            }
+        }
+
+        // Merge the sorted names with the sorted moves.
+        m_merged.reserve(m_count + moved.size());
+        size_t i = 0;
+        auto it = moved.begin();
+        while (i < m_count || it != moved.end()) {
+            if (it == moved.end() || (i < m_count && name(i) < it->first)) {
+                m_merged.push_back(name(i++));
+                continue;
+            }
+            if (i < m_count && name(i) == it->first) {
+                i++;
+            }
+            if (it->second) {
+                m_merged.push_back(it->first);
+            }
+            ++it;
+        }
+        m_journaled = true;
+        m_count = m_merged.size();
+    }
+    return true;
+}
+
+std::string_view DisabledManifest::name(size_t i) const {
+    if (m_journaled) {
+        return m_merged[i];
+    }
+    return std::string_view(m_names + m_offsets[i], m_offsets[i + 1] - m_offsets[i]);
+}
+
+bool rebuild_manifest(const fs::path& dir, const Config& cfg) {
+    if (cfg.dry_run) {
+        return false;
+    }
+
+    // Put the new file in place first, empty and so not yet valid: its
+    // creation and rename change the disabled dir's mtime, which has to
+    // happen before the mtime the names are read at is taken.  The data
+    // is written into it afterwards, which leaves that mtime alone.
+    const fs::path dd = dir / cfg.disabled_dir;
+    const fs::path path = manifest_path(dir, cfg);
+    fs::path tmp = path;
+    tmp += ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    if (::rename(tmp.c_str(), path.c_str()) != 0) {
+        ::close(fd);
+        ::unlink(tmp.c_str());
+        return false;
+    }
+
+    Header h{};
+    std::memcpy(h.magic, kMagic, sizeof(kMagic));
+    h.version = kVersion;
+    h.prefix_len = static_cast<uint32_t>(cfg.disabled_prefix.size());
+    h.suffix_len = static_cast<uint32_t>(cfg.disabled_suffix.size());
+    DIR* d = stamp_before_read(dd, &h) ? ::opendir(dd.c_str()) : nullptr;
+    if (!d) {
+        ::close(fd);
+        return false;
+    }
+    std::vector<std::string> originals;
+    const DisabledNameMatcher undecorate(cfg);
+    while (struct dirent* de = ::readdir(d)) {
+        const std::string_view name = de->d_name;
+        if (name == "." || name == ".." || is_manifest_name(name)) {
+            continue;
+        }
+        if (const auto original = undecorate(name)) {
+            originals.emplace_back(*original);
+        }
+    }
+    ::closedir(d);
+    std::sort(originals.begin(), originals.end());
+    originals.erase(std::unique(originals.begin(), originals.end()), originals.end());
+    h.count = static_cast<uint32_t>(originals.size());
+
+    std::string buf;
+    buf += cfg.disabled_prefix;
+    buf += cfg.disabled_suffix;
+    buf.resize(offsets_start(h) - sizeof(Header), '\0');
+    uint32_t off = 0;
+    for (const std::string& n : originals) {
+        buf.append(reinterpret_cast<const char*>(&off), sizeof(off));
+        off += static_cast<uint32_t>(n.size());
+    }
+    buf.append(reinterpret_cast<const char*>(&off), sizeof(off));
+    for (const std::string& n : originals) {
+        buf += n;
+    }
+
+    // The header goes last, so a reader never sees it over missing data.
+    const bool ok = write_all(fd, buf.data(), buf.size(), sizeof(Header))
+        && write_all(fd, reinterpret_cast<const char*>(&h), sizeof(h), 0);
+    ::close(fd);
+    return ok;
+}
+
+bool load_manifest(const fs::path& dir, const Config& cfg, DisabledManifest* out) {
+    return cfg.manifest && uses_posix_backend(cfg) && out->open(dir, cfg);
+}
+
+struct timespec disabled_dir_mtime(const fs::path& dir, const Config& cfg) {
+    struct stat st;
+    if (!cfg.manifest || !uses_posix_backend(cfg) || ::stat((dir / cfg.disabled_dir).c_str(), &st) != 0) {
+        return {};
+    }
+    return st.st_mtim;
+}
+
+void update_manifest(const fs::path& dir, const Config& cfg, const struct timespec& before,
+                     std::string_view removed, std::string_view added) {
+    update_manifest(dir, cfg, before, std::vector<ManifestMove>{{removed, added}});
+}
+
+void update_manifest(const fs::path& dir, const Config& cfg, const struct timespec& before,
+                     const std::vector<ManifestMove>& moves) {
+    if (!cfg.manifest || cfg.dry_run || !uses_posix_backend(cfg) || moves.empty()) {
+        return;
+    }
+
+    DisabledManifest old;
+    struct stat st;
+    if (!old.open(dir, cfg, before, false) || ::stat((dir / cfg.disabled_dir).c_str(), &st) != 0) {
+        rebuild_manifest(dir, cfg);
+        return;
+    }
+
+    // One record per move.  Only the last carries the new mtime: the
+    // others carry none, so a reader that sees the append cut short at a
+    // record boundary takes the manifest as stale.
+    std::string buf;
+    for (size_t i = 0; i < moves.size(); i++) {
+        const ManifestMove& m = moves[i];
+        Record rec{};
+        if (i + 1 == moves.size()) {
+            rec.mtime_sec = st.st_mtim.tv_sec;
+            rec.mtime_nsec = st.st_mtim.tv_nsec;
+        }
+        rec.removed_len = static_cast<uint32_t>(m.removed.size());
+        rec.added_len = static_cast<uint32_t>(m.added.size());
+        const size_t at = buf.size();
+        buf.append(reinterpret_cast<const char*>(&rec), sizeof(rec));
+        buf += m.removed;
+        buf += m.added;
+        const uint32_t total = static_cast<uint32_t>(buf.size() - at + sizeof(total));
+        buf.append(reinterpret_cast<const char*>(&total), sizeof(total));
+    }
+    if (old.m_journal_len + buf.size() > std::max(kMinJournalBytes, old.m_base_len)) {
+        rebuild_manifest(dir, cfg);
+        return;
+    }
+
+    // Append to the file that was checked, in one write, so a reader sees
+    // the records whole or not at all.
+    const int fd = ::open(manifest_path(dir, cfg).c_str(), O_WRONLY | O_CLOEXEC);
+    struct stat fst;
+    bool ok = fd >= 0 && ::fstat(fd, &fst) == 0 && fst.st_dev == old.m_dev && fst.st_ino == old.m_ino
+        && static_cast<size_t>(fst.st_size) == old.m_len;
+    ok = ok && write_all(fd, buf.data(), buf.size(), static_cast<off_t>(old.m_len));
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    if (!ok) {
+        rebuild_manifest(dir, cfg);
+    }
+}
+
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "core.hpp"
+
+#include <cstddef>
+#include <ctime>
+#include <filesystem>
+#include <string_view>
+#include <vector>
+
+#include <sys/types.h>
+
+namespace ft {
+
+// Index of the disabled entries of one directory, kept in the disabled dir
+// so that "is X disabled?" and "list disabled" need one mmap instead of a
+// readdir and a stat per name.
+//
+// The file holds the original (undecorated) names, sorted, together with
+// the decoration they were indexed for and the mtime of the disabled dir
+// it describes.  Any rename in the disabled dir changes that mtime, so a
+// manifest whose recorded mtime differs is stale: readers ignore it and
+// the next move rebuilds it.  So is one whose names were read within the
+// mtime granularity of the recorded mtime, as a change just after the
+// read may not have moved the mtime.
+//
+// A move appends a record of the names it removed and added, with the new
+// mtime, to the end of the file; the file is only rewritten once these
+// records outgrow the sorted names.  Appending leaves the disabled dir's
+// mtime alone.
+//
+// There is no per-name lookup: asking whether one name is disabled costs
+// a single stat of its disabled path, less than opening the manifest.
+inline constexpr std::string_view kManifestName = ".filetoggler-manifest";
+
+// The manifest and its temporary file are not disabled entries.
+inline bool is_manifest_name(std::string_view name) {
+    return name.starts_with(kManifestName);
+}
+
+class DisabledManifest {
+ public:
+    DisabledManifest() = default;
+    ~DisabledManifest();
+    DisabledManifest(DisabledManifest&& other) noexcept;
+    DisabledManifest& operator=(DisabledManifest&& other) noexcept;
+    DisabledManifest(const DisabledManifest&) = delete;
+    DisabledManifest& operator=(const DisabledManifest&) = delete;
+
+    // Map the manifest of dir.  Fails if it is missing, malformed, made for
+    // another prefix/suffix or older than the disabled dir.
+    bool open(const std::filesystem::path& dir, const Config& cfg);
+    // Same, but the manifest must describe the disabled dir as it was when
+    // its mtime was the given one.
+    bool open(const std::filesystem::path& dir, const Config& cfg, const struct timespec& mtime);
+
+    bool is_open() const { return m_data != nullptr; }
+    size_t size() const { return m_count; }
+    // Original names in ascending byte order.
+    std::string_view name(size_t i) const;
+
+ private:
+    friend void update_manifest(const std::filesystem::path& dir, const Config& cfg, const struct timespec& before,
+                                const std::vector<struct ManifestMove>& moves);
+
+    // Without merge, only the checks are made: size() and name() see the
+    // names as of the last rebuild.  For appending to the journal.
+    bool open(const std::filesystem::path& dir, const Config& cfg, const struct timespec& mtime, bool merge);
+    void close();
+
+    const char* m_data{nullptr};
+    size_t m_len{0};
+    size_t m_count{0};
+    const uint32_t* m_offsets{nullptr};
+    const char* m_names{nullptr};
+    // Bytes of sorted names and of journal records.
+    size_t m_base_len{0};
+    size_t m_journal_len{0};
+    // The names with the journal applied, if it has records.
+    std::vector<std::string_view> m_merged;
+    bool m_journaled{false};
+    // The mapped file, to append to that same file.
+    dev_t m_dev{0};
+    ino_t m_ino{0};
+};
+
+// Open the manifest of dir if it is current.  Fails when cfg.manifest is
+// off, without a disabled dir, or if the manifest is missing or stale; the
+// caller then reads the disabled dir.  Never writes: only moves (through
+// update_manifest()) create or rebuild the manifest.
+bool load_manifest(const std::filesystem::path& dir, const Config& cfg, DisabledManifest* out);
+
+// Write a fresh manifest for dir from one readdir of its disabled dir.
+// Waits up to a tick of the mtime clock if the disabled dir changed just
+// before.
+bool rebuild_manifest(const std::filesystem::path& dir, const Config& cfg);
+
+// mtime of dir's disabled dir, to be passed to update_manifest() after a
+// move.  Zero if there is no disabled dir.
+struct timespec disabled_dir_mtime(const std::filesystem::path& dir, const Config& cfg);
+
+// One move into (added) or out of (removed) a disabled dir, by original
+// name.  Either may be empty.
+struct ManifestMove {
+    std::string_view removed;
+    std::string_view added;
+};
+
+// Record one move into or out of dir's disabled dir.  before is the mtime
+// of the disabled dir taken just before the move: if the manifest was
+// current then, the change is appended to it, otherwise it is rebuilt.
+// Either name may be empty.  Does nothing unless cfg.manifest is set.
+void update_manifest(const std::filesystem::path& dir, const Config& cfg, const struct timespec& before,
+                     std::string_view removed, std::string_view added);
+// Same for the moves of a batch, in the order they were made.  before is
+// taken ahead of the first of them.
+void update_manifest(const std::filesystem::path& dir, const Config& cfg, const struct timespec& before,
+                     const std::vector<ManifestMove>& moves);
+
+}
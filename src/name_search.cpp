@@ -0,0 +1,134 @@
+#include "name_search.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace ft {
+
+static char fold(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+size_t find_substring(std::string_view hay, std::string_view needle, size_t from) {
+    if (from > hay.size()) {
+        return std::string_view::npos;
+    }
+    if (needle.empty()) {
+        return from;
+    }
+    if (needle.size() > hay.size() - from) {
+        return std::string_view::npos;
+    }
+
+    if (needle.size() == 1) {
+        // memchr(3), which libc vectorises already.
+        return hay.find(needle.front(), from);
+    }
+
+    size_t i = from;
+#if defined(__SSE2__)
+    const char* const base = hay.data();
+    const size_t k = needle.size();
+    // Last position a match can start at.  A block tests starts i..i+15,
+    // reading hay[i, i+16) and hay[i+k-1, i+k+15), which stay in bounds
+    // while i + 15 <= last.
+    const size_t last = hay.size() - k;
+    const __m128i first_byte = _mm_set1_epi8(needle.front());
+    const __m128i last_byte = _mm_set1_epi8(needle.back());
+    for (; i + 15 <= last; i += 16) {
+        const __m128i head = _mm_loadu_si128(reinterpret_cast<const __m128i*>(base + i));
+        const __m128i tail = _mm_loadu_si128(reinterpret_cast<const __m128i*>(base + i + k - 1));
+        unsigned mask = static_cast<unsigned>(
+            _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(head, first_byte), _mm_cmpeq_epi8(tail, last_byte))));
+        while (mask != 0) {
+            const size_t at = i + static_cast<size_t>(__builtin_ctz(mask));
+            // The first and last bytes are equal already.  Names are short,
+            // so a byte loop beats a call to memcmp.
+            size_t j = 1;
+            while (j + 1 < k && base[at + j] == needle[j]) {
+                j++;
+            }
+            if (j + 1 >= k) {
+                return at;
+            }
+            mask &= mask - 1;
+        }
+    }
+#endif
+    return hay.find(needle, i);
+}
+
+void NameSearch::rebuild(const EntryTable& t) {
+    clear();
+    size_t bytes = 0;
+    for (size_t i = 0; i < t.size(); i++) {
+        bytes += t.name(i).size() + 1;
+    }
+    m_names.resize(bytes);
+    m_off.resize(t.size() + 1);
+    char* out = m_names.data();
+    for (size_t i = 0; i < t.size(); i++) {
+        m_off[i] = static_cast<uint32_t>(out - m_names.data());
+        for (char c : t.name(i)) {
+            *out++ = fold(c);
+        }
+        *out++ = '\0';
+    }
+    m_off[t.size()] = static_cast<uint32_t>(bytes);
+}
+
+void NameSearch::clear() {
+    m_names.clear();
+    m_off.clear();
+    m_query.clear();
+    m_rows.clear();
+    m_has_rows = false;
+}
+
+const std::vector<uint32_t>& NameSearch::filter(std::string_view query) {
+    std::string folded;
+    folded.reserve(query.size());
+    for (char c : query) {
+        folded.push_back(fold(c));
+    }
+
+    if (folded.find('\0') != std::string::npos) {
+        // Would match across rows; no name contains a NUL.
+        m_rows.clear();
+    } else if (m_has_rows && !m_query.empty() && folded.find(m_query) != std::string::npos) {
+        // Narrowing (or the same query): recheck the rows kept so far.
+        // After an empty query that is every row, for which one pass over
+        // the buffer is cheaper.
+        size_t kept = 0;
+        for (uint32_t row : m_rows) {
+            if (find_substring(row_name(row), folded) != std::string_view::npos) {
+                m_rows[kept++] = row;
+            }
+        }
+        m_rows.resize(kept);
+    } else if (folded.empty()) {
+        m_rows.resize(size());
+        for (size_t i = 0; i < m_rows.size(); i++) {
+            m_rows[i] = static_cast<uint32_t>(i);
+        }
+    } else {
+        m_rows.clear();
+        const std::string_view names(m_names);
+        uint32_t row = 0;
+        size_t pos = find_substring(names, folded);
+        while (pos != std::string_view::npos) {
+            // Hits come in buffer order, so the row only moves forward.
+            while (m_off[row + 1] <= pos) {
+                row++;
+            }
+            m_rows.push_back(row);
+            pos = find_substring(names, folded, m_off[row + 1]);
+        }
+    }
+    m_query = std::move(folded);
+    m_has_rows = true;
+    return m_rows;
+}
+
+}
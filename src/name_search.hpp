@@ -0,0 +1,53 @@
+#pragma once
+
+#include "core.hpp"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ft {
+
+// Position of the first occurrence of needle in hay at or after from, or
+// npos: the answer of hay.find(needle, from).  Where SSE2 is available,
+// 16 candidate positions are tested at once by comparing their first and
+// last bytes with the needle's; only candidates matching both are compared
+// in full.  A one-byte needle goes to memchr(3).
+size_t find_substring(std::string_view hay, std::string_view needle, size_t from = 0);
+
+// Case-insensitive substring filter over the names of an EntryTable, for
+// filtering a listing as the user types.
+//
+// The names are folded to ASCII lower case and packed into one buffer,
+// each followed by a NUL, so that a query is one find_substring() pass
+// over the buffer; a hit skips the rest of its row.  A query containing
+// the previous one can only keep rows the previous one kept, so only
+// those are searched again.
+class NameSearch {
+ public:
+    // Rows are the positions of t at this call.
+    void rebuild(const EntryTable& t);
+    void clear();
+    size_t size() const { return m_off.empty() ? 0 : m_off.size() - 1; }
+
+    // Rows whose name contains query, ascending.  An empty query keeps
+    // every row.  Valid until the next call.
+    const std::vector<uint32_t>& filter(std::string_view query);
+
+ private:
+    std::string_view row_name(uint32_t row) const {
+        return std::string_view(m_names).substr(m_off[row], m_off[row + 1] - m_off[row] - 1);
+    }
+
+    std::string m_names;
+    // Start of each row in m_names, and one past the last row.
+    std::vector<uint32_t> m_off;
+
+    // The last query, folded, and the rows it kept.
+    std::string m_query;
+    std::vector<uint32_t> m_rows;
+    bool m_has_rows{false};
+};
+
+}
@@ -0,0 +1,139 @@
+#include "probe.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <thread>
+
+#include <sys/vfs.h>
+
+namespace fs = std::filesystem;
+
+namespace ft {
+
+bool is_slow_mount(const fs::path& dir) {
+    struct statfs sfs;
+    if (::statfs(dir.c_str(), &sfs) != 0) {
+        return false;
+    }
+    switch (static_cast<unsigned long>(sfs.f_type)) {
+        case 0x6969:        // NFS
+        case 0x517b:        // SMB
+        case 0xff534d42:    // CIFS
+        case 0xfe534d42:    // SMB2
+        case 0x65735546:    // FUSE (sshfs, ...)
+        case 0x01021997:    // 9p
+        case 0x5346414f:    // AFS
+        case 0x00c36400:    // Ceph
+        case 0x73757245:    // Coda
+            return true;
+        default:
+            return false;
+    }
+}
+
+struct ProbePool::State {
+    struct Task {
+        std::function<void()> run;
+        std::chrono::milliseconds stuck_after;
+    };
+    // One per worker thread.
+    struct Worker {
+        bool busy{false};
+        bool stuck{false};
+        std::chrono::steady_clock::time_point stuck_at;
+    };
+
+    std::mutex mu;
+    std::condition_variable cv;
+    std::deque<Task> queue;
+    std::list<Worker> workers;
+    unsigned base{0};
+    unsigned busy{0};
+    unsigned stuck{0};
+};
+
+ProbePool& ProbePool::instance() {
+    // Leaked on purpose: detached workers may still use it at exit.
+    static ProbePool* pool = [] {
+        auto* p = new ProbePool();
+        p->start_workers();
+        return p;
+    }();
+    return *pool;
+}
+
+void ProbePool::start_workers() {
+    m_state = new State();
+    m_state->base = std::max(4u, std::min(16u, std::thread::hardware_concurrency() * 2));
+    std::lock_guard<std::mutex> lk(m_state->mu);
+    for (unsigned i = 0; i < m_state->base; i++) {
+        spawn();
+    }
+}
+
+// Called with m_state->mu held.
+void ProbePool::spawn() {
+    State* st = m_state;
+    auto self = st->workers.emplace(st->workers.end());
+    std::thread([st, self] {
+        std::unique_lock<std::mutex> lk(st->mu);
+        for (;;) {
+            st->cv.wait(lk, [st] { return !st->queue.empty(); });
+            State::Task task = std::move(st->queue.front());
+            st->queue.pop_front();
+            self->busy = true;
+            self->stuck_at = std::chrono::steady_clock::now() + task.stuck_after;
+            st->busy++;
+            lk.unlock();
+            task.run();
+            task.run = nullptr;
+            lk.lock();
+            self->busy = false;
+            st->busy--;
+            if (self->stuck) {
+                // Back from a stall that was replaced: retire if the pool
+                // has its full complement without this worker.
+                self->stuck = false;
+                st->stuck--;
+                if (st->workers.size() - st->stuck > st->base) {
+                    st->workers.erase(self);
+                    return;
+                }
+            }
+        }
+    }).detach();
+}
+
+void ProbePool::submit(std::function<void()> task, std::chrono::milliseconds stuck_after) {
+    bool all_busy;
+    {
+        std::lock_guard<std::mutex> lk(m_state->mu);
+        m_state->queue.push_back({std::move(task), stuck_after});
+        all_busy = m_state->busy == m_state->workers.size();
+    }
+    m_state->cv.notify_one();
+    if (all_busy) {
+        replace_stuck();
+    }
+}
+
+bool ProbePool::replace_stuck() {
+    std::lock_guard<std::mutex> lk(m_state->mu);
+    const auto now = std::chrono::steady_clock::now();
+    for (State::Worker& w : m_state->workers) {
+        if (w.busy && !w.stuck && now >= w.stuck_at) {
+            w.stuck = true;
+            m_state->stuck++;
+            if (m_state->workers.size() < kMaxWorkers) {
+                spawn();
+            }
+        }
+    }
+    return m_state->stuck < m_state->workers.size();
+}
+
+}
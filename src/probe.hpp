@@ -0,0 +1,44 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <functional>
+
+namespace ft {
+
+// True for directories on network and FUSE filesystems (NFS, SMB/CIFS,
+// sshfs and other FUSE mounts, 9p, AFS, Ceph, Coda), where a single stat
+// can take seconds or hang.  MetaScan::Auto scans those names-only.
+bool is_slow_mount(const std::filesystem::path& dir);
+
+// Runs metadata probes off the calling thread.  The workers are detached:
+// a probe stuck in the kernel ties up one worker for good but never blocks
+// the caller or process exit.  A worker whose probe overruns is replaced,
+// up to kMaxWorkers in all, so a hung mount does not starve the probes of
+// other directories.  Once the cap is reached and every worker is stuck,
+// new probes just queue up and their callers see them time out.
+class ProbePool {
+ public:
+    static constexpr unsigned kMaxWorkers = 64;
+
+    static ProbePool& instance();
+
+    // The worker running task counts as stuck once it has been at it for
+    // longer than stuck_after.
+    void submit(std::function<void()> task, std::chrono::milliseconds stuck_after);
+
+    // Starts a replacement for each worker newly found stuck, within the
+    // cap.  Returns false if every worker is stuck and none can be added,
+    // so queued probes will not start.
+    bool replace_stuck();
+
+ private:
+    ProbePool() = default;
+    void start_workers();
+    void spawn();
+
+    struct State;
+    State* m_state{nullptr};
+};
+
+}
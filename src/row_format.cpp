@@ -0,0 +1,166 @@
+#include "row_format.hpp"
+
+#include <charconv>
+#include <chrono>
+#include <string_view>
+
+namespace ft {
+
+namespace {
+
+constexpr const char* kEllipsis = "\xe2\x80\xa6";
+
+// Decimal digits, grouped by thousands.
+void append_grouped(std::string& out, std::string_view digits) {
+    const size_t n = digits.size();
+    for (size_t i = 0; i < n; i++) {
+        if (i > 0 && (n - i) % 3 == 0) {
+            out += ',';
+        }
+        out += digits[i];
+    }
+}
+
+void append_2d(std::string& out, int v) {
+    out += static_cast<char>('0' + v / 10);
+    out += static_cast<char>('0' + v % 10);
+}
+
+}
+
+std::string format_size(std::uintmax_t bytes) {
+    static const char* const units[] = {"B", "KB", "MB", "GB", "TB"};
+    std::string out;
+    if (bytes < 1024) {
+        char buf[8];
+        const auto res = std::to_chars(buf, buf + sizeof(buf), bytes);
+        out.append(buf, res.ptr);
+        out += " B";
+        return out;
+    }
+
+    int unit_idx = 0;
+    double size = static_cast<double>(bytes);
+    while (size >= 1024.0 && unit_idx < 4) {
+        size /= 1024.0;
+        unit_idx++;
+    }
+    // Same digits as printf's %.2f, without its locale lookups.
+    char buf[32];
+    const auto res = std::to_chars(buf, buf + sizeof(buf), size, std::chars_format::fixed, 2);
+    const std::string_view digits(buf, static_cast<size_t>(res.ptr - buf));
+    const size_t point = digits.find('.');
+    append_grouped(out, digits.substr(0, point));
+    out += digits.substr(point);
+    out += ' ';
+    out += units[unit_idx];
+    return out;
+}
+
+std::string TimeFormatter::format(std::filesystem::file_time_type t) const {
+    const auto sys = std::chrono::file_clock::to_sys(t);
+    return format(std::chrono::system_clock::to_time_t(
+        std::chrono::time_point_cast<std::chrono::system_clock::duration>(sys)));
+}
+
+std::string TimeFormatter::format(std::time_t t) const {
+    static const char* const days[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+    static const char* const months[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                         "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+    // Floor division, so times before the epoch land in the right minute.
+    const std::time_t key = t / 60 - (t % 60 < 0 ? 1 : 0);
+    const int offset = static_cast<int>(t - key * 60);
+    struct tm tm;
+    {
+        std::lock_guard<std::mutex> lk(m_mu);
+        Minute& slot = m_minutes[static_cast<size_t>(key) % kSlots];
+        if (slot.key != key) {
+            const std::time_t start = key * 60;
+            if (!::localtime_r(&start, &slot.tm)) {
+                return std::string();
+            }
+            slot.key = key;
+        }
+        tm = slot.tm;
+    }
+    if (tm.tm_sec + offset >= 60) {
+        // A zone offset that is not whole minutes moves the local minute
+        // boundary; leave those to the C library.
+        if (!::localtime_r(&t, &tm)) {
+            return std::string();
+        }
+    } else {
+        tm.tm_sec += offset;
+    }
+
+    std::string out;
+    out.reserve(24);
+    out += days[tm.tm_wday];
+    out += ' ';
+    out += months[tm.tm_mon];
+    out += ' ';
+    out += tm.tm_mday < 10 ? ' ' : static_cast<char>('0' + tm.tm_mday / 10);
+    out += static_cast<char>('0' + tm.tm_mday % 10);
+    out += ' ';
+    append_2d(out, tm.tm_hour);
+    out += ':';
+    append_2d(out, tm.tm_min);
+    out += ':';
+    append_2d(out, tm.tm_sec);
+    out += ' ';
+    char year[12];
+    const auto res = std::to_chars(year, year + sizeof(year), tm.tm_year + 1900);
+    out.append(year, res.ptr);
+    return out;
+}
+
+void EntryCells::reset(size_t rows) {
+    m_rows.clear();
+    m_rows.resize(rows);
+}
+
+void EntryCells::invalidate(size_t row) {
+    if (row < m_rows.size()) {
+        m_rows[row].has_size = false;
+        m_rows[row].has_mtime = false;
+    }
+}
+
+const std::string& EntryCells::size(const EntryTable& t, size_t row) {
+    if (row >= m_rows.size()) {
+        m_rows.resize(t.size());
+    }
+    Cells& c = m_rows[row];
+    if (!c.has_size) {
+        if (t.is_dir(row)) {
+            c.size.clear();
+            if (t.has_tree_size(row)) {
+                c.size = format_size(t.file_size(row));
+                if (t.tree_size_partial(row)) {
+                    c.size += kEllipsis;
+                }
+            }
+        } else if (t.meta_pending(row)) {
+            c.size = kEllipsis;
+        } else {
+            c.size = format_size(t.file_size(row));
+        }
+        c.has_size = true;
+    }
+    return c.size;
+}
+
+const std::string& EntryCells::mtime(const EntryTable& t, size_t row) {
+    if (row >= m_rows.size()) {
+        m_rows.resize(t.size());
+    }
+    Cells& c = m_rows[row];
+    if (!c.has_mtime) {
+        c.mtime = t.meta_pending(row) ? std::string(kEllipsis) : m_time.format(t.mtime(row));
+        c.has_mtime = true;
+    }
+    return c.mtime;
+}
+
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "core.hpp"
+
+#include <array>
+#include <cstdint>
+#include <ctime>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ft {
+
+// "1023 B", "1.50 KB", ... with two decimals above bytes.
+std::string format_size(std::uintmax_t bytes);
+
+// Local time in the layout of ctime(3), without its newline:
+// "Sun Oct 18 14:03:05 2026".  Safe to share between threads.
+//
+// File times are converted with the fixed offset between the file clock
+// and the system clock instead of sampling both clocks per call, and the
+// broken-down time of recently seen minutes is memoised, so formatting a
+// directory whose files were written in a few bursts costs one
+// localtime_r per minute.
+class TimeFormatter {
+ public:
+    std::string format(std::filesystem::file_time_type t) const;
+    std::string format(std::time_t t) const;
+
+ private:
+    struct Minute {
+        std::time_t key{-1};
+        struct tm tm{};
+    };
+    static constexpr size_t kSlots = 256;
+
+    mutable std::mutex m_mu;
+    mutable std::array<Minute, kSlots> m_minutes{};
+};
+
+// Size and mtime column text of the rows of an EntryTable, made on first
+// use and kept until the row's metadata changes.  Rows are positions:
+// reset() after the table is refilled or reordered.
+class EntryCells {
+ public:
+    void reset(size_t rows);
+    // The metadata of row changed.
+    void invalidate(size_t row);
+
+    // Empty for a directory without a recursive size; an ellipsis for
+    // placeholders and running totals.
+    const std::string& size(const EntryTable& t, size_t row);
+    const std::string& mtime(const EntryTable& t, size_t row);
+
+ private:
+    struct Cells {
+        bool has_size{false};
+        bool has_mtime{false};
+        std::string size;
+        std::string mtime;
+    };
+
+    TimeFormatter m_time;
+    std::vector<Cells> m_rows;
+};
+
+}
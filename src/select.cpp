@@ -0,0 +1,136 @@
+#include "select.hpp"
+
+#include <fnmatch.h>
+
+namespace ft {
+
+static bool is_glob_meta(char c) {
+    return c == '*' || c == '?' || c == '[' || c == ']' || c == '\\';
+}
+
+static bool is_regex_meta(char c) {
+    switch (c) {
+        case '.': case '[': case ']': case '(': case ')': case '{': case '}':
+        case '*': case '+': case '?': case '|': case '^': case '$': case '\\':
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool is_regex_quantifier(char c) {
+    return c == '*' || c == '+' || c == '?' || c == '{';
+}
+
+NameSelector::Pattern NameSelector::compile_glob(std::string_view glob) {
+    Pattern p;
+    p.text = std::string(glob);
+
+    const size_t first = glob.find_first_of("*?[]\\");
+    if (first == std::string_view::npos) {
+        p.kind = Kind::Literal;
+        return p;
+    }
+
+    p.kind = Kind::Glob;
+    // An escaped character would end up in the literal runs; not worth
+    // the bookkeeping, so such globs only get fnmatch().
+    if (glob.find('\\') != std::string_view::npos) {
+        return p;
+    }
+    p.prefix = std::string(glob.substr(0, first));
+    size_t last = glob.size();
+    while (last > 0 && !is_glob_meta(glob[last - 1])) {
+        last--;
+    }
+    p.suffix = std::string(glob.substr(last));
+    return p;
+}
+
+NameSelector::Pattern NameSelector::compile_regex(std::string_view re) {
+    Pattern p;
+    p.kind = Kind::Regex;
+    p.text = std::string(re);
+    p.re = std::regex(p.text, std::regex::ECMAScript | std::regex::optimize);
+
+    // With an alternation anywhere the anchored literals below are not
+    // necessarily required by every branch.
+    if (re.find('|') != std::string_view::npos) {
+        return p;
+    }
+
+    // ^literal: every match starts with the literal, minus a last
+    // character that is followed by a quantifier.
+    if (re.starts_with('^')) {
+        size_t i = 1;
+        while (i < re.size() && !is_regex_meta(re[i])) {
+            i++;
+        }
+        size_t len = i - 1;
+        if (len > 0 && i < re.size() && is_regex_quantifier(re[i])) {
+            len--;
+        }
+        p.prefix = std::string(re.substr(1, len));
+    }
+
+    // literal$: the literal run before an unescaped trailing '$'.
+    if (re.size() >= 2 && re.back() == '$' && re[re.size() - 2] != '\\') {
+        const size_t end = re.size() - 1;
+        size_t i = end;
+        while (i > 0 && !is_regex_meta(re[i - 1])) {
+            i--;
+        }
+        // The first character of the run belongs to an escape like \d.
+        if (i > 0 && re[i - 1] == '\\' && i < end) {
+            i++;
+        }
+        p.suffix = std::string(re.substr(i, end - i));
+    }
+    return p;
+}
+
+bool NameSelector::matches(const Pattern& p, std::string_view name) {
+    if (p.kind == Kind::Literal) {
+        return name == p.text;
+    }
+
+    if (name.size() < p.prefix.size() + p.suffix.size()) {
+        return false;
+    }
+    if (!name.starts_with(p.prefix) || !name.ends_with(p.suffix)) {
+        return false;
+    }
+
+    if (p.kind == Kind::Regex) {
+        return std::regex_search(name.begin(), name.end(), p.re);
+    }
+
+    // fnmatch() needs a terminated string; names come from an arena.
+    // FNM_PERIOD: as in the shell, a leading dot is matched only by a dot.
+    thread_local std::string buf;
+    buf.assign(name);
+    return ::fnmatch(p.text.c_str(), buf.c_str(), FNM_PERIOD) == 0;
+}
+
+bool NameSelector::selects(std::string_view name) const {
+    if (!m_match.empty()) {
+        bool any = false;
+        for (const auto& p : m_match) {
+            if (matches(p, name)) {
+                any = true;
+                break;
+            }
+        }
+        if (!any) {
+            return false;
+        }
+    }
+    for (const auto& p : m_exclude) {
+        if (matches(p, name)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
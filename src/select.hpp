@@ -0,0 +1,53 @@
+#pragma once
+
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ft {
+
+// A set of --match/--exclude patterns over display names, compiled once.
+//
+// Each pattern carries the literal prefix and suffix any matching name
+// must have; names failing that cheap check never reach fnmatch() or the
+// regex engine.  Globs without metacharacters are compared literally.
+class NameSelector {
+ public:
+    // These throw std::regex_error for an invalid regex.
+    void add_match_glob(std::string_view glob) { m_match.push_back(compile_glob(glob)); }
+    void add_exclude_glob(std::string_view glob) { m_exclude.push_back(compile_glob(glob)); }
+    void add_match_regex(std::string_view re) { m_match.push_back(compile_regex(re)); }
+    void add_exclude_regex(std::string_view re) { m_exclude.push_back(compile_regex(re)); }
+
+    bool empty() const { return m_match.empty() && m_exclude.empty(); }
+    bool has_match() const { return !m_match.empty(); }
+
+    // True if the name matches any match pattern (or there are none) and
+    // no exclude pattern.
+    bool selects(std::string_view name) const;
+
+ private:
+    enum class Kind {
+        Literal,
+        Glob,
+        Regex,
+    };
+
+    struct Pattern {
+        Kind kind{Kind::Literal};
+        std::string text;
+        std::string prefix;
+        std::string suffix;
+        std::regex re;
+    };
+
+    static Pattern compile_glob(std::string_view glob);
+    static Pattern compile_regex(std::string_view re);
+    static bool matches(const Pattern& p, std::string_view name);
+
+    std::vector<Pattern> m_match;
+    std::vector<Pattern> m_exclude;
+};
+
+}
@@ -0,0 +1,159 @@
+#include "stats.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <ostream>
+#include <string>
+
+namespace ft {
+
+namespace {
+
+// Milliseconds with three decimals.
+std::string ms(RunStats::Clock::duration d) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.3f", std::chrono::duration<double, std::milli>(d).count());
+    return buf;
+}
+
+// Nearest-rank percentile of sorted samples.
+RunStats::Clock::duration percentile(const std::vector<RunStats::Clock::duration>& sorted, unsigned pct) {
+    if (sorted.empty()) {
+        return {};
+    }
+    const size_t rank = (sorted.size() * pct + 99) / 100;
+    return sorted[std::max<size_t>(rank, 1) - 1];
+}
+
+}
+
+RunStats::RunStats() : m_start(Clock::now()) {}
+
+const char* RunStats::phase_name(Phase phase) {
+    switch (phase) {
+        case Scan: return "scan";
+        case Mkdir: return "mkdir";
+        case Rename: return "rename";
+        case RenameBatch: return "rename_batch";
+        case Copy: return "copy";
+        case kPhases: break;
+    }
+    return "?";
+}
+
+void RunStats::count_entry(FileState state) {
+    if (state == FileState::Disabled) {
+        m_disabled.fetch_add(1, std::memory_order_relaxed);
+    } else if (state == FileState::Enabled) {
+        m_enabled.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void RunStats::count_move(bool cross_device, std::uintmax_t bytes_copied) {
+    if (cross_device) {
+        m_moves_xdev.fetch_add(1, std::memory_order_relaxed);
+        m_bytes_copied.fetch_add(bytes_copied, std::memory_order_relaxed);
+    } else {
+        m_moves.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void RunStats::record(Phase phase, Clock::duration d) {
+    std::lock_guard<std::mutex> lk(m_mu);
+    m_samples[phase].push_back(d);
+}
+
+void RunStats::set_fs_calls(const CountingBackend::Counts& calls) {
+    m_fs_calls = calls;
+}
+
+uint64_t RunStats::entries(FileState state) const {
+    switch (state) {
+        case FileState::Enabled: return m_enabled.load(std::memory_order_relaxed);
+        case FileState::Disabled: return m_disabled.load(std::memory_order_relaxed);
+        case FileState::Missing: break;
+    }
+    return 0;
+}
+
+uint64_t RunStats::moves(bool cross_device) const {
+    return (cross_device ? m_moves_xdev : m_moves).load(std::memory_order_relaxed);
+}
+
+std::uintmax_t RunStats::bytes_copied() const {
+    return m_bytes_copied.load(std::memory_order_relaxed);
+}
+
+RunStats::PhaseSummary RunStats::phase(Phase phase) const {
+    std::vector<Clock::duration> sorted;
+    {
+        std::lock_guard<std::mutex> lk(m_mu);
+        sorted = m_samples[phase];
+    }
+    std::sort(sorted.begin(), sorted.end());
+
+    PhaseSummary s;
+    s.calls = sorted.size();
+    for (const auto d : sorted) {
+        s.total += d;
+    }
+    s.p50 = percentile(sorted, 50);
+    s.p99 = percentile(sorted, 99);
+    return s;
+}
+
+RunStats::Clock::duration RunStats::elapsed() const {
+    return Clock::now() - m_start;
+}
+
+void RunStats::write_text(std::ostream& out) const {
+    out << "entries: " << entries(FileState::Enabled) << " enabled, "
+        << entries(FileState::Disabled) << " disabled\n";
+    out << "moves: " << moves(false) << " same-device, " << moves(true) << " cross-device, "
+        << bytes_copied() << " bytes copied\n";
+    if (m_fs_calls) {
+        const CountingBackend::Counts& c = *m_fs_calls;
+        out << "fs calls: " << c.stat << " stat, " << c.lstat << " lstat, " << c.read_dir << " read_dir, "
+            << c.rename << " rename, " << c.copy << " copy, " << c.remove << " remove, "
+            << c.mkdir << " mkdir\n";
+    }
+
+    char line[128];
+    std::snprintf(line, sizeof(line), "%-14s %8s %12s %12s %12s\n", "phase", "calls", "total ms", "p50 ms", "p99 ms");
+    out << line;
+    for (int p = 0; p < kPhases; p++) {
+        const PhaseSummary s = phase(static_cast<Phase>(p));
+        if (s.calls == 0) {
+            continue;
+        }
+        std::snprintf(line, sizeof(line), "%-14s %8llu %12s %12s %12s\n", phase_name(static_cast<Phase>(p)),
+                      static_cast<unsigned long long>(s.calls), ms(s.total).c_str(), ms(s.p50).c_str(),
+                      ms(s.p99).c_str());
+        out << line;
+    }
+    out << "wall time: " << ms(elapsed()) << " ms\n";
+}
+
+void RunStats::write_json(std::ostream& out) const {
+    out << "{\"wall_ms\":" << ms(elapsed())
+        << ",\"entries\":{\"enabled\":" << entries(FileState::Enabled)
+        << ",\"disabled\":" << entries(FileState::Disabled) << "}"
+        << ",\"moves\":{\"same_device\":" << moves(false)
+        << ",\"cross_device\":" << moves(true)
+        << ",\"bytes_copied\":" << bytes_copied() << "}";
+    if (m_fs_calls) {
+        const CountingBackend::Counts& c = *m_fs_calls;
+        out << ",\"fs_calls\":{\"stat\":" << c.stat << ",\"lstat\":" << c.lstat
+            << ",\"read_dir\":" << c.read_dir << ",\"rename\":" << c.rename
+            << ",\"copy\":" << c.copy << ",\"remove\":" << c.remove << ",\"mkdir\":" << c.mkdir << "}";
+    }
+    out << ",\"phases\":{";
+    for (int p = 0; p < kPhases; p++) {
+        const PhaseSummary s = phase(static_cast<Phase>(p));
+        out << (p > 0 ? "," : "") << '"' << phase_name(static_cast<Phase>(p)) << "\":{\"calls\":" << s.calls
+            << ",\"total_ms\":" << ms(s.total) << ",\"p50_ms\":" << ms(s.p50) << ",\"p99_ms\":" << ms(s.p99) << "}";
+    }
+    out << "}}\n";
+}
+
+}
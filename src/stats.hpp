@@ -0,0 +1,105 @@
+#pragma once
+
+#include "core.hpp"
+#include "fs_backend.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace ft {
+
+// Counters and timings of one command run, for --stats.  Collection is
+// switched on by pointing Config::stats at one; without it every hook is a
+// null check.  Safe to share between threads (walk_tree() scans from
+// several).
+class RunStats {
+ public:
+    using Clock = std::chrono::steady_clock;
+
+    enum Phase {
+        // One scan_dir() call.
+        Scan,
+        // One ensure_disabled_dir_exists() call.
+        Mkdir,
+        // One rename of move_path().
+        Rename,
+        // One io_uring batch of renames in move_batch().
+        RenameBatch,
+        // One copy and remove of a cross-device move.
+        Copy,
+        kPhases,
+    };
+
+    struct PhaseSummary {
+        uint64_t calls{0};
+        Clock::duration total{};
+        Clock::duration p50{};
+        Clock::duration p99{};
+    };
+
+    // Times one call of a phase, from construction to destruction.  Does
+    // not read the clock without stats.
+    class Timer {
+     public:
+        Timer(RunStats* stats, Phase phase) : m_stats(stats), m_phase(phase) {
+            if (m_stats) {
+                m_start = Clock::now();
+            }
+        }
+        ~Timer() {
+            if (m_stats) {
+                m_stats->record(m_phase, Clock::now() - m_start);
+            }
+        }
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+
+     private:
+        RunStats* m_stats;
+        Phase m_phase;
+        Clock::time_point m_start{};
+    };
+
+    RunStats();
+
+    static const char* phase_name(Phase phase);
+
+    void count_entry(FileState state);
+    // bytes_copied is 0 for a rename.
+    void count_move(bool cross_device, std::uintmax_t bytes_copied = 0);
+    void record(Phase phase, Clock::duration d);
+    // Calls made to the filesystem, when they were counted.
+    void set_fs_calls(const CountingBackend::Counts& calls);
+
+    uint64_t entries(FileState state) const;
+    uint64_t moves(bool cross_device) const;
+    std::uintmax_t bytes_copied() const;
+    PhaseSummary phase(Phase phase) const;
+    // Since construction.
+    Clock::duration elapsed() const;
+
+    // Human-readable, phases without calls left out.
+    void write_text(std::ostream& out) const;
+    // One JSON object with every phase, durations in milliseconds.
+    void write_json(std::ostream& out) const;
+
+ private:
+    Clock::time_point m_start;
+    std::atomic<uint64_t> m_enabled{0};
+    std::atomic<uint64_t> m_disabled{0};
+    std::atomic<uint64_t> m_moves{0};
+    std::atomic<uint64_t> m_moves_xdev{0};
+    std::atomic<std::uintmax_t> m_bytes_copied{0};
+    std::optional<CountingBackend::Counts> m_fs_calls;
+
+    mutable std::mutex m_mu;
+    std::array<std::vector<Clock::duration>, kPhases> m_samples;
+};
+
+}
@@ -0,0 +1,160 @@
+#include "trace.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace ft {
+
+namespace detail {
+std::atomic<bool> g_tracing{false};
+}
+
+namespace {
+
+struct TraceEvent {
+    const char* name;
+    const char* category;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::duration dur;
+    long tid;
+    uint64_t count;
+    bool has_count;
+};
+
+struct TraceState {
+    std::mutex mu;
+    fs::path file;
+    std::chrono::steady_clock::time_point origin;
+    std::vector<TraceEvent> events;
+    bool registered{false};
+};
+
+TraceState& state() {
+    static TraceState s;
+    return s;
+}
+
+long thread_id() {
+    thread_local const long tid = static_cast<long>(::syscall(SYS_gettid));
+    return tid;
+}
+
+void write_json_string(std::ostream& out, const char* s) {
+    out << '"';
+    for (; *s; s++) {
+        const char c = *s;
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", static_cast<unsigned>(c));
+            out << buf;
+        } else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+// Microseconds with nanosecond digits, as trace viewers expect.
+void write_us(std::ostream& out, std::chrono::steady_clock::duration d) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.3f", std::chrono::duration<double, std::micro>(d).count());
+    out << buf;
+}
+
+}
+
+bool trace_start(const fs::path& file, std::string* err) {
+    {
+        // Fail now rather than after the run.
+        std::ofstream probe(file, std::ios::trunc);
+        if (!probe) {
+            if (err) {
+                *err = "cannot write trace file: " + file.string();
+            }
+            return false;
+        }
+    }
+
+    TraceState& s = state();
+    {
+        std::lock_guard<std::mutex> lk(s.mu);
+        s.file = file;
+        s.origin = std::chrono::steady_clock::now();
+        s.events.clear();
+        if (!s.registered) {
+            std::atexit(trace_stop);
+            s.registered = true;
+        }
+    }
+    detail::g_tracing.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+void trace_stop() {
+    if (!detail::g_tracing.exchange(false)) {
+        return;
+    }
+
+    TraceState& s = state();
+    std::vector<TraceEvent> events;
+    fs::path file;
+    std::chrono::steady_clock::time_point origin;
+    {
+        std::lock_guard<std::mutex> lk(s.mu);
+        events.swap(s.events);
+        file = s.file;
+        origin = s.origin;
+    }
+
+    std::ofstream out(file, std::ios::trunc);
+    const long pid = static_cast<long>(::getpid());
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << pid
+        << ",\"tid\":" << pid << ",\"args\":{\"name\":\"filetoggler\"}}";
+    for (const TraceEvent& e : events) {
+        out << ",\n{\"name\":";
+        write_json_string(out, e.name);
+        out << ",\"cat\":";
+        write_json_string(out, e.category);
+        out << ",\"ph\":\"X\",\"ts\":";
+        write_us(out, e.start - origin);
+        out << ",\"dur\":";
+        write_us(out, e.dur);
+        out << ",\"pid\":" << pid << ",\"tid\":" << e.tid;
+        if (e.has_count) {
+            out << ",\"args\":{\"count\":" << e.count << "}";
+        }
+        out << "}";
+    }
+    out << "\n]}\n";
+}
+
+void TraceSpan::begin(const char* name) {
+    m_name = name;
+    m_has_count = false;
+    m_start = std::chrono::steady_clock::now();
+}
+
+void TraceSpan::end() {
+    const auto now = std::chrono::steady_clock::now();
+    const char* name = m_name;
+    m_name = nullptr;
+    if (!trace_enabled()) {
+        return;
+    }
+    TraceState& s = state();
+    std::lock_guard<std::mutex> lk(s.mu);
+    s.events.push_back({name, m_category, m_start, now - m_start, thread_id(), m_count, m_has_count});
+}
+
+}
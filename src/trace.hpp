@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+namespace ft {
+
+// Scoped spans written as Chrome trace-event JSON, which opens in
+// ui.perfetto.dev and chrome://tracing.  Tracing is off until
+// trace_start(); a span then costs one relaxed load.  Events are kept in
+// memory and written by trace_stop(), which trace_start() also registers
+// with atexit().
+
+// Start collecting spans for file; false if it cannot be written.
+bool trace_start(const std::filesystem::path& file, std::string* err);
+// Write the collected spans and stop.  Does nothing when not tracing.
+void trace_stop();
+
+namespace detail {
+extern std::atomic<bool> g_tracing;
+}
+
+inline bool trace_enabled() {
+    return detail::g_tracing.load(std::memory_order_relaxed);
+}
+
+// One complete event on the calling thread, from construction to
+// destruction.  name and category must be string literals (they are kept
+// by pointer until trace_stop()).
+class TraceSpan {
+ public:
+    explicit TraceSpan(const char* name, const char* category = "core") : m_category(category) {
+        if (trace_enabled()) {
+            begin(name);
+        }
+    }
+    ~TraceSpan() {
+        if (m_name) {
+            end();
+        }
+    }
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    // End this span and start another at the same point, for functions
+    // that run in phases.
+    void next(const char* name) {
+        if (m_name) {
+            end();
+            begin(name);
+        }
+    }
+
+    // A count shown with the span, e.g. the number of rows.
+    void set_count(uint64_t n) {
+        m_count = n;
+        m_has_count = true;
+    }
+
+ private:
+    void begin(const char* name);
+    void end();
+
+    const char* m_name{nullptr};
+    const char* m_category;
+    std::chrono::steady_clock::time_point m_start{};
+    uint64_t m_count{0};
+    bool m_has_count{false};
+};
+
+}
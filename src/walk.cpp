@@ -0,0 +1,241 @@
+#include "walk.hpp"
+
+#include "fs_backend.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+
+namespace fs = std::filesystem;
+
+namespace ft {
+
+namespace {
+
+// Limits the number of directories open at once.
+class DirSlots {
+ public:
+    explicit DirSlots(unsigned n) : m_free(n) {}
+
+    void acquire() {
+        std::unique_lock<std::mutex> lk(m_mu);
+        m_cv.wait(lk, [this] { return m_free > 0; });
+        m_free--;
+    }
+
+    void release() {
+        {
+            std::lock_guard<std::mutex> lk(m_mu);
+            m_free++;
+        }
+        m_cv.notify_one();
+    }
+
+ private:
+    std::mutex m_mu;
+    std::condition_variable m_cv;
+    unsigned m_free;
+};
+
+// Each worker owns a deque: it pushes and pops new directories at the
+// back (depth first, cache friendly) and idle workers steal from the
+// front of a victim's deque (the oldest, usually largest subtrees).
+class WorkStealingPool {
+ public:
+    using Task = std::function<void(unsigned worker)>;
+
+    explicit WorkStealingPool(unsigned n) : m_queues(n) {
+        for (auto& q : m_queues) {
+            q = std::make_unique<Queue>();
+        }
+    }
+
+    void push(unsigned worker, Task t) {
+        m_pending.fetch_add(1, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lk(m_queues[worker]->mu);
+            m_queues[worker]->tasks.push_back(std::move(t));
+        }
+        {
+            // Under m_idle_mu so a worker between checking and sleeping
+            // cannot miss it.
+            std::lock_guard<std::mutex> lk(m_idle_mu);
+            m_queued.fetch_add(1, std::memory_order_relaxed);
+        }
+        m_idle_cv.notify_one();
+    }
+
+    // Runs until every pushed task, including tasks pushed by tasks, is done.
+    void run() {
+        std::vector<std::thread> threads;
+        for (unsigned i = 1; i < m_queues.size(); i++) {
+            threads.emplace_back([this, i] { work(i); });
+        }
+        work(0);
+        for (auto& t : threads) {
+            t.join();
+        }
+    }
+
+ private:
+    struct Queue {
+        std::mutex mu;
+        std::deque<Task> tasks;
+    };
+
+    bool pop_local(unsigned w, Task* out) {
+        Queue& q = *m_queues[w];
+        std::lock_guard<std::mutex> lk(q.mu);
+        if (q.tasks.empty()) {
+            return false;
+        }
+        *out = std::move(q.tasks.back());
+        q.tasks.pop_back();
+        m_queued.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    bool steal(unsigned w, Task* out) {
+        const size_t n = m_queues.size();
+        for (size_t k = 1; k < n; k++) {
+            Queue& q = *m_queues[(w + k) % n];
+            std::lock_guard<std::mutex> lk(q.mu);
+            if (!q.tasks.empty()) {
+                *out = std::move(q.tasks.front());
+                q.tasks.pop_front();
+                m_queued.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void work(unsigned w) {
+        for (;;) {
+            Task t;
+            if (pop_local(w, &t) || steal(w, &t)) {
+                t(w);
+                if (m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    // Pass through m_idle_mu so no worker is between its
+                    // check and its wait when this notify goes out.
+                    {
+                        std::lock_guard<std::mutex> lk(m_idle_mu);
+                    }
+                    m_idle_cv.notify_all();
+                }
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lk(m_idle_mu);
+            // Sleep until a task is queued somewhere or the last one is done.
+            m_idle_cv.wait(lk, [this] {
+                return m_queued.load(std::memory_order_relaxed) > 0 ||
+                       m_pending.load(std::memory_order_acquire) == 0;
+            });
+            if (m_pending.load(std::memory_order_acquire) == 0) {
+                return;
+            }
+        }
+    }
+
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::atomic<size_t> m_pending{0};
+    // Tasks sitting in the deques, not yet taken.
+    std::atomic<size_t> m_queued{0};
+    std::mutex m_idle_mu;
+    std::condition_variable m_idle_cv;
+};
+
+unsigned open_dir_limit(unsigned requested) {
+    unsigned limit = requested == 0 ? 1 : requested;
+    struct rlimit rl;
+    if (::getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY) {
+        // Each directory scan holds at most two fds (dir and disabled dir);
+        // leave the rest of the table to the caller.
+        const rlim_t cap = rl.rlim_cur / 4;
+        if (cap < limit) {
+            limit = static_cast<unsigned>(std::max<rlim_t>(cap, 1));
+        }
+    }
+    return limit;
+}
+
+// Real (non-symlink) directory check without following links.
+bool is_real_dir(FsBackend& backend, const fs::path& p) {
+    FsStat st;
+    return !backend.stat(p, false, &st) && st.type == FsType::Dir;
+}
+
+// Subdirectories of dir from readdir alone, for directories whose entries
+// are not wanted.
+void list_subdirs_by_dtype(FsBackend& backend, const fs::path& dir, const Config& cfg, std::vector<fs::path>* out) {
+    backend.read_dir(dir, [&](std::string_view name, FsType type) {
+        if (name == cfg.disabled_dir.native()) {
+            return true;
+        }
+        if (type == FsType::Dir || (type == FsType::Unknown && is_real_dir(backend, dir / name))) {
+            out->push_back(dir / name);
+        }
+        return true;
+    });
+}
+
+}
+
+void walk_tree(const fs::path& root, const Config& cfg, const WalkOptions& opts, const WalkVisitor& visit) {
+    unsigned threads = opts.threads;
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    FsBackend& backend = backend_of(cfg);
+    WorkStealingPool pool(threads);
+    DirSlots slots(open_dir_limit(opts.max_open_dirs));
+
+    std::function<void(unsigned, fs::path)> visit_dir;
+    visit_dir = [&](unsigned worker, fs::path dir) {
+        std::vector<fs::path> subdirs;
+
+        slots.acquire();
+        FsStat dd;
+        if (opts.disabled_only && (backend.stat(dir / cfg.disabled_dir, true, &dd) || dd.type != FsType::Dir)) {
+            list_subdirs_by_dtype(backend, dir, cfg, &subdirs);
+            slots.release();
+        } else {
+            EntryTable entries(dir, cfg);
+            scan_dir(dir, cfg, [&](const ScanEntry& e) {
+                entries.add(e.name, e.state, e.is_dir, e.size, e.mtime, e.meta_pending, e.is_symlink);
+                return true;
+            });
+            slots.release();
+
+            visit(entries);
+
+            // Checked after the visitor, which may have disabled some of them.
+            for (size_t i = 0; i < entries.size(); i++) {
+                if (entries.is_dir(i) && entries.state(i) == FileState::Enabled) {
+                    fs::path sub = entries.enabled_path(i);
+                    if (is_real_dir(backend, sub)) {
+                        subdirs.push_back(std::move(sub));
+                    }
+                }
+            }
+        }
+
+        for (auto& sub : subdirs) {
+            pool.push(worker, [&visit_dir, sub = std::move(sub)](unsigned w) { visit_dir(w, sub); });
+        }
+    };
+
+    pool.push(0, [&visit_dir, &root](unsigned w) { visit_dir(w, root); });
+    pool.run();
+}
+
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "core.hpp"
+
+#include <filesystem>
+#include <functional>
+
+namespace ft {
+
+struct WalkOptions {
+    // Worker threads; 0 means std::thread::hardware_concurrency().
+    unsigned threads{0};
+    // Upper bound on directories being read at the same time, i.e. on the
+    // directory file descriptors held open by the walk.
+    unsigned max_open_dirs{64};
+    // Only entries of directories that have a disabled dir are wanted.
+    // Directories without one are traversed by name and d_type only,
+    // without stat'ing or reporting their entries.
+    bool disabled_only{false};
+};
+
+// Receives the (unsorted) entries of one directory.  Called concurrently
+// from the worker threads, at most once per directory.
+using WalkVisitor = std::function<void(const EntryTable& entries)>;
+
+// Walk root and all its enabled subdirectories on a work-stealing thread
+// pool.  Symlinked directories and disabled directories are not descended.
+void walk_tree(const std::filesystem::path& root, const Config& cfg, const WalkOptions& opts, const WalkVisitor& visit);
+
+}
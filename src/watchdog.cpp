@@ -0,0 +1,157 @@
+#include "watchdog.hpp"
+
+#include <algorithm>
+#include <cerrno>
+
+#include <execinfo.h>
+
+namespace ft {
+
+namespace {
+
+constexpr int kStackSignal = SIGUSR2;
+constexpr int kMaxFrames = 64;
+// How long the stalled thread gets to run the handler.
+constexpr auto kDumpWait = std::chrono::seconds(1);
+
+// Read by the signal handler: lock-free atomics only.
+std::atomic<int> g_dump_fd{-1};
+// The stall whose stack is wanted, 0 once the handler has claimed it or
+// the report has given up on it, and the last stall whose stack was
+// written.  A signal that stayed pending past its report (the thread was
+// in the kernel) finds nothing to claim and writes nothing, so its frames
+// cannot land under a later line of the log.
+std::atomic<uint64_t> g_wanted{0};
+std::atomic<uint64_t> g_dumped{0};
+
+void dump_stack(int) {
+    const uint64_t stall = g_wanted.exchange(0);
+    if (stall == 0) {
+        return;
+    }
+    const int saved_errno = errno;
+    void* frames[kMaxFrames];
+    const int n = ::backtrace(frames, kMaxFrames);
+    const int fd = g_dump_fd.load();
+    if (fd >= 0) {
+        ::backtrace_symbols_fd(frames, n, fd);
+    }
+    g_dumped.store(stall);
+    errno = saved_errno;
+}
+
+}
+
+StallWatchdog::StallWatchdog(std::chrono::milliseconds threshold, int fd)
+    : m_threshold(threshold),
+      m_fd(fd),
+      m_watched(::pthread_self()),
+      m_last_beat(Clock::now().time_since_epoch().count()) {
+    // The first backtrace() loads libgcc, which must not happen inside the
+    // handler.
+    void* frames[1];
+    ::backtrace(frames, 1);
+
+    g_dump_fd.store(fd);
+    struct sigaction sa{};
+    sa.sa_handler = dump_stack;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    ::sigaction(kStackSignal, &sa, &m_old_action);
+
+    m_thread = std::thread([this] { run(); });
+}
+
+StallWatchdog::~StallWatchdog() {
+    {
+        std::lock_guard<std::mutex> lk(m_mu);
+        m_stop = true;
+    }
+    m_cv.notify_all();
+    m_thread.join();
+    ::sigaction(kStackSignal, &m_old_action, nullptr);
+    g_dump_fd.store(-1);
+}
+
+void StallWatchdog::heartbeat() {
+    const Clock::time_point now = Clock::now();
+    const Clock::time_point last{Clock::duration(m_last_beat.exchange(now.time_since_epoch().count()))};
+    if (m_stalled.exchange(false)) {
+        const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(now - last).count();
+        write_line("filetoggler: UI thread resumed after " + std::to_string(ms) + " ms\n");
+    }
+}
+
+void StallWatchdog::set_context(std::string context) {
+    std::lock_guard<std::mutex> lk(m_mu);
+    m_context = std::move(context);
+}
+
+void StallWatchdog::run() {
+    // Check a few times per threshold so a stall is reported within about
+    // 1.25 thresholds of the last heartbeat.
+    const auto poll = std::max<Clock::duration>(m_threshold / 4, std::chrono::milliseconds(10));
+    std::unique_lock<std::mutex> lk(m_mu);
+    while (!m_stop) {
+        m_cv.wait_for(lk, poll);
+        if (m_stop) {
+            break;
+        }
+        const Clock::time_point last{Clock::duration(m_last_beat.load())};
+        const Clock::duration since = Clock::now() - last;
+        if (since <= m_threshold || m_stalled.load()) {
+            continue;
+        }
+        m_stalled.store(true);
+        const uint64_t stall = m_stalls.fetch_add(1) + 1;
+        const std::string context = m_context;
+        lk.unlock();
+        report(stall, since, context);
+        lk.lock();
+    }
+}
+
+void StallWatchdog::report(uint64_t stall, Clock::duration stalled, const std::string& context) {
+    const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(stalled).count();
+    std::string head = "filetoggler: UI thread stalled for " + std::to_string(ms) + " ms";
+    if (!context.empty()) {
+        head += " in " + context;
+    }
+    write_line(head + "; its stack:\n");
+
+    // Stall numbers restart with each watchdog.
+    g_dumped.store(0);
+    g_wanted.store(stall);
+    if (::pthread_kill(m_watched, kStackSignal) == 0) {
+        const Clock::time_point deadline = Clock::now() + kDumpWait;
+        while (g_dumped.load() != stall && Clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    }
+    // Withdraw the request unless the handler has claimed it already; if
+    // it has, it is running and about to finish the stack.
+    uint64_t wanted = stall;
+    if (g_wanted.compare_exchange_strong(wanted, 0)) {
+        write_line("    (not captured: the thread is blocked in the kernel)\n");
+        return;
+    }
+    while (g_dumped.load() != stall) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+}
+
+void StallWatchdog::write_line(const std::string& line) const {
+    size_t off = 0;
+    while (off < line.size()) {
+        const ssize_t n = ::write(m_fd, line.data() + off, line.size() - off);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return;
+        }
+        off += static_cast<size_t>(n);
+    }
+}
+
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+
+namespace ft {
+
+// Reports stalls of one thread, the GUI thread.  That thread calls
+// heartbeat() from its event loop; when it has not for longer than the
+// threshold, a watchdog thread logs how long it has been stuck, the
+// context it last set (the directory being listed) and its stack.
+//
+// The stack is taken by interrupting the stalled thread with SIGUSR2 and
+// writing backtrace(3) from the handler, so a thread blocked inside a
+// system call that does not return to user space (a hung NFS stat) is
+// reported without one, and the stack it would have shown once it returns
+// is dropped.  One watchdog at a time.
+class StallWatchdog {
+ public:
+    // Watches the calling thread; reports are written to fd.
+    explicit StallWatchdog(std::chrono::milliseconds threshold, int fd = STDERR_FILENO);
+    ~StallWatchdog();
+    StallWatchdog(const StallWatchdog&) = delete;
+    StallWatchdog& operator=(const StallWatchdog&) = delete;
+
+    // From the watched thread, at least every threshold().  The end of a
+    // reported stall is logged too.
+    void heartbeat();
+    void set_context(std::string context);
+
+    std::chrono::milliseconds threshold() const { return m_threshold; }
+    // Stalls reported so far.
+    uint64_t stalls() const { return m_stalls.load(); }
+
+ private:
+    using Clock = std::chrono::steady_clock;
+
+    void run();
+    void report(uint64_t stall, Clock::duration stalled, const std::string& context);
+    void write_line(const std::string& line) const;
+
+    const std::chrono::milliseconds m_threshold;
+    const int m_fd;
+    const pthread_t m_watched;
+    struct sigaction m_old_action{};
+
+    // Clock::time_point of the last heartbeat, as its count.
+    std::atomic<Clock::rep> m_last_beat;
+    std::atomic<bool> m_stalled{false};
+    std::atomic<uint64_t> m_stalls{0};
+
+    std::mutex m_mu;
+    std::condition_variable m_cv;
+    bool m_stop{false};
+    std::string m_context;
+    std::thread m_thread;
+};
+
+}
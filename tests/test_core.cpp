@@ -1,12 +1,42 @@
+#include "../src/batch_io.hpp"
 #include "../src/core.hpp"
+#include "../src/daemon.hpp"
+#include "../src/disabled_index.hpp"
+#include "../src/du.hpp"
+#include "../src/fs_backend.hpp"
+#include "../src/list_format.hpp"
+#include "../src/manifest.hpp"
+#include "../src/name_search.hpp"
+#include "../src/row_format.hpp"
+#include "../src/select.hpp"
+#include "../src/stats.hpp"
+#include "../src/trace.hpp"
+#include "../src/walk.hpp"
+#include "../src/watchdog.hpp"
 
+#include <atomic>
 #include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <ctime>
 #include <filesystem>
 #include <fstream>
+#include <map>
 #include <iostream>
+#include <iterator>
+#include <mutex>
+#include <set>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <tuple>
 #include <vector>
 
+#include <fcntl.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 namespace fs = std::filesystem;
@@ -49,6 +79,28 @@ static void testDecorateUndecorate() {
 
     const auto no = ft::undecorate_disabled_name("xxx", cfg);
     assert(!no.has_value());
+
+    // The matcher agrees with undecorate_disabled_name() for every shape
+    // and returns slices of its input.
+    const std::vector<std::string> names = {"", ".", ".off", "..off", ".a.off", "a.off", ".a", "a", ".a.of", ".offx"};
+    for (const auto& [prefix, suffix] : std::vector<std::pair<std::string, std::string>>{
+             {"", ""}, {".", ""}, {"", ".off"}, {".", ".off"}, {".off", ".off"}}) {
+        ft::Config c;
+        c.disabled_prefix = prefix;
+        c.disabled_suffix = suffix;
+        const ft::DisabledNameMatcher undecorate(c);
+        for (const auto& n : names) {
+            const auto expect = ft::undecorate_disabled_name(n, c);
+            const auto got = undecorate(n);
+            assert(got.has_value() == expect.has_value());
+            if (got) {
+                assert(*got == *expect);
+                assert(got->data() >= n.data() && got->data() + got->size() <= n.data() + n.size());
+            }
+            const bool dispatched = undecorate.dispatch([&](const auto& match) { return match(n).has_value(); });
+            assert(dispatched == got.has_value());
+        }
+    }
 }
 
 static void testDisableEnableRoundtrip() {
@@ -76,6 +128,34 @@ static void testDisableEnableRoundtrip() {
     fs::remove_all(dir);
 }
 
+static void testToggleDanglingSymlink() {
+    fs::path dir = makeTempDir();
+
+    ft::Config cfg;
+    cfg.disabled_dir = ".disable.d";
+    cfg.verbosity = ft::Verbosity::Quiet;
+
+    fs::path link = dir / "dangling";
+    fs::create_symlink("nowhere", link);
+    const fs::path disabled = dir / cfg.disabled_dir / "dangling";
+
+    std::string err;
+    assert(ft::get_state(link, cfg) == ft::FileState::Enabled);
+
+    assert(ft::disable_one(link, cfg, &err));
+    assert(!fs::is_symlink(fs::symlink_status(link)));
+    assert(fs::is_symlink(fs::symlink_status(disabled)));
+    assert(fs::read_symlink(disabled) == "nowhere");
+    assert(ft::get_state(link, cfg) == ft::FileState::Disabled);
+
+    assert(ft::toggle_one(link, cfg, &err));
+    assert(fs::is_symlink(fs::symlink_status(link)));
+    assert(!fs::is_symlink(fs::symlink_status(disabled)));
+    assert(ft::get_state(link, cfg) == ft::FileState::Enabled);
+
+    fs::remove_all(dir);
+}
+
 static void testDisableWithPrefixSuffix() {
     fs::path dir = makeTempDir();
 
@@ -132,12 +212,1247 @@ static void testListDirShowsOriginalNames() {
     fs::remove_all(dir);
 }
 
+static void testEntryTableColumns() {
+    fs::path dir = makeTempDir();
+
+    ft::Config cfg;
+    cfg.disabled_dir = ".disable.d";
+    cfg.disabled_prefix = "__";
+    cfg.disabled_suffix = "~";
+
+    writeFile(dir / "b.txt", "bb");
+    writeFile(dir / ".hidden", "h");
+    writeFile(dir / cfg.disabled_dir / "__a.txt~", "aaa");
+
+    ft::EntryTable t = ft::scan_dir_table(dir, cfg);
+    assert(t.size() == 3);
+    assert(t.name(0) == ".hidden");
+    assert(t.name(1) == "a.txt");
+    assert(t.name(2) == "b.txt");
+    assert(t.state(1) == ft::FileState::Disabled);
+    assert(t.file_size(1) == 3);
+    assert(t.enabled_path(1) == dir / "a.txt");
+    assert(t.disabled_path(1) == dir / cfg.disabled_dir / "__a.txt~");
+
+    t.erase_if([&t](size_t i) { return t.name(i).starts_with('.'); });
+    assert(t.size() == 2);
+    assert(t.name(0) == "a.txt");
+
+    t.reverse();
+    assert(t.name(0) == "b.txt");
+    assert(t.state(0) == ft::FileState::Enabled);
+    assert(t.file_size(0) == 2);
+
+    const ft::FileEntry e = t.entry(1);
+    assert(e.display_name == "a.txt");
+    assert(e.disabled_path == dir / cfg.disabled_dir / "__a.txt~");
+
+    fs::remove_all(dir);
+}
+
+static void testNaturalNameOrder() {
+    auto key = [](std::string_view name, ft::NameOrder order) {
+        std::string k;
+        ft::append_name_key(name, order, &k);
+        return k;
+    };
+    using ft::NameOrder;
+    assert(key("mod10.conf", NameOrder::Bytes) == "mod10.conf");
+    assert(key("mod2.conf", NameOrder::Natural) < key("mod10.conf", NameOrder::Natural));
+    assert(key("mod9", NameOrder::Natural) < key("mod10", NameOrder::Natural));
+    // A run still sorts where a digit would: '.' < digits < letters.
+    assert(key("mod.conf", NameOrder::Natural) < key("mod1", NameOrder::Natural));
+    assert(key("mod1", NameOrder::Natural) < key("modA", NameOrder::Natural));
+    assert(key("v1.2.10", NameOrder::Natural) > key("v1.2.9", NameOrder::Natural));
+    assert(key("a007", NameOrder::Natural) == key("a7", NameOrder::Natural));
+    assert(key("a0", NameOrder::Natural) < key("a1", NameOrder::Natural));
+    assert(key("Mod2", NameOrder::Natural) < key("mod1", NameOrder::Natural));
+    assert(key("Mod2", NameOrder::NaturalIgnoreCase) > key("mod1", NameOrder::NaturalIgnoreCase));
+    // Runs longer than a one-byte count keep their order.
+    const std::string digits300(300, '9');
+    assert(key("x" + std::string(254, '9'), NameOrder::Natural) < key("x1" + std::string(254, '0'), NameOrder::Natural));
+    assert(key("x" + digits300, NameOrder::Natural) < key("x1" + digits300, NameOrder::Natural));
+
+    ft::Config cfg;
+    cfg.name_order = NameOrder::Natural;
+    ft::EntryTable t(fs::path("/nowhere"), cfg);
+    const auto now = fs::file_time_type::clock::now();
+    for (const char* name : {"mod10.conf", "mod2.conf", "mod1.conf", "mod02.conf", "Mod3.conf", "mod.conf"}) {
+        t.add(name, ft::FileState::Enabled, false, 0, now);
+    }
+    t.sort_by_name();
+    const std::vector<std::string_view> sorted = {"Mod3.conf", "mod.conf", "mod1.conf", "mod02.conf", "mod2.conf", "mod10.conf"};
+    for (size_t i = 0; i < t.size(); i++) {
+        assert(t.name(i) == sorted[i]);
+        assert(t.sort_key(i) == key(sorted[i], NameOrder::Natural));
+    }
+    // Keys follow their rows.
+    t.erase_if([&t](size_t i) { return t.name(i).starts_with("mod0"); });
+    t.reverse();
+    assert(t.name(0) == "mod10.conf");
+    assert(t.sort_key(0) == key("mod10.conf", NameOrder::Natural));
+}
+
+static void testScanDirStreamsMergedEntries() {
+    fs::path dir = makeTempDir();
+
+    ft::Config cfg;
+    cfg.disabled_dir = ".disable.d";
+
+    writeFile(dir / "a.txt", "a");
+    writeFile(dir / "both.txt", "enabled");
+    writeFile(dir / cfg.disabled_dir / "both.txt", "disabled!");
+    writeFile(dir / cfg.disabled_dir / "c.txt", "c");
+
+    std::vector<std::string> seen;
+    bool complete = ft::scan_dir(dir, cfg, [&](const ft::ScanEntry& e) {
+        seen.emplace_back(e.name);
+        if (e.name == "both.txt") {
+            assert(e.state == ft::FileState::Disabled);
+            assert(e.size == 9);
+        }
+        if (e.name == "c.txt") {
+            assert(e.state == ft::FileState::Disabled);
+        }
+        return true;
+    });
+    assert(complete);
+    assert(seen.size() == 3);
+
+    int visits = 0;
+    complete = ft::scan_dir(dir, cfg, [&](const ft::ScanEntry&) {
+        visits++;
+        return false;
+    });
+    assert(!complete);
+    assert(visits == 1);
+
+    fs::remove_all(dir);
+}
+
+static void testWalkTreeVisitsEveryDirectory() {
+    fs::path dir = makeTempDir();
+
+    ft::Config cfg;
+    cfg.disabled_dir = ".disable.d";
+
+    writeFile(dir / "top.txt", "t");
+    writeFile(dir / "a" / "b" / "deep.txt", "d");
+    writeFile(dir / "c" / cfg.disabled_dir / "off.txt", "o");
+    fs::create_directory_symlink("..", dir / "a" / "loop");
+
+    std::mutex mu;
+    std::set<std::string> seen;
+    ft::WalkOptions wo;
+    wo.threads = 4;
+    ft::walk_tree(dir, cfg, wo, [&](const ft::EntryTable& t) {
+        std::lock_guard<std::mutex> lk(mu);
+        for (size_t i = 0; i < t.size(); i++) {
+            seen.insert(fs::relative(t.enabled_path(i), dir).string());
+        }
+    });
+    assert(seen.count("top.txt"));
+    assert(seen.count("a/b/deep.txt"));
+    assert(seen.count("c/off.txt"));
+    assert(!seen.count("a/loop/top.txt"));
+
+    // Only directories with a disabled dir are reported in disabled-only mode.
+    std::set<fs::path> visited;
+    wo.disabled_only = true;
+    ft::walk_tree(dir, cfg, wo, [&](const ft::EntryTable& t) {
+        std::lock_guard<std::mutex> lk(mu);
+        visited.insert(t.dir());
+    });
+    assert(visited.size() == 1);
+    assert(*visited.begin() == dir / "c");
+
+    fs::remove_all(dir);
+}
+
+static void testNameSelector() {
+    ft::NameSelector sel;
+    sel.add_match_glob("*.conf");
+    sel.add_exclude_glob("base.conf");
+    assert(sel.selects("a.conf"));
+    assert(!sel.selects("base.conf"));
+    assert(!sel.selects("a.txt"));
+    assert(!sel.selects("conf"));
+    // Like a shell glob, a wildcard does not match a leading dot.
+    assert(!sel.selects(".hidden.conf"));
+
+    ft::NameSelector re;
+    re.add_match_regex("^mod[0-9]+\\.conf$");
+    re.add_match_regex("x|y");
+    assert(re.selects("mod12.conf"));
+    assert(!re.selects("mod.conf"));
+    assert(re.selects("only-y"));
+
+    ft::NameSelector opt;
+    opt.add_match_regex("^abc?d");
+    assert(opt.selects("abd"));
+
+    ft::NameSelector none;
+    assert(none.empty());
+    assert(none.selects("anything"));
+}
+
+static void testBatchIoMatchesSync() {
+    fs::path dir = makeTempDir();
+
+    ft::Config cfg;
+    cfg.disabled_dir = ".disable.d";
+    cfg.verbosity = ft::Verbosity::Quiet;
+
+    for (int i = 0; i < 10; i++) {
+        writeFile(dir / ("f" + std::to_string(i)), std::string(static_cast<size_t>(i), 'x'));
+    }
+    fs::create_directory(dir / "sub");
+    writeFile(dir / cfg.disabled_dir / "f3", "disabled copy");
+    writeFile(dir / cfg.disabled_dir / "gone", "g");
+    fs::create_symlink("nowhere", dir / "dangling");
+    // Its stat fails (ELOOP); the disabled copy is still listed.
+    fs::create_symlink("loop", dir / "loop");
+    writeFile(dir / cfg.disabled_dir / "loop", "disabled loop");
+
+    using Row = std::tuple<ft::FileState, bool, std::uintmax_t, fs::file_time_type>;
+    auto scan = [&](unsigned depth) {
+        ft::Config c = cfg;
+        c.io_queue_depth = depth;
+        std::map<std::string, Row> rows;
+        ft::scan_dir(dir, c, [&](const ft::ScanEntry& e) {
+            rows[std::string(e.name)] = Row{e.state, e.is_dir, e.size, e.mtime};
+            return true;
+        });
+        return rows;
+    };
+    const auto sync = scan(0);
+    assert(sync.size() == 14);
+    assert(std::get<0>(sync.at("loop")) == ft::FileState::Disabled);
+    assert(std::get<2>(sync.at("dangling")) == 0);
+    assert(std::get<0>(sync.at("f3")) == ft::FileState::Disabled);
+    assert(std::get<2>(sync.at("f3")) == 13);
+    assert(scan(4) == sync);
+    assert(scan(256) == sync);
+
+    ft::BatchIo io(8);
+    std::vector<ft::StatResult> st;
+    io.stat({dir / "f5", dir / "sub", dir / "missing"}, &st);
+    assert(st[0].error == 0 && st[0].size == 5 && !st[0].is_dir);
+    assert(st[1].error == 0 && st[1].is_dir);
+    assert(st[2].error == ENOENT);
+
+    ft::Config batched = cfg;
+    batched.io_queue_depth = 4;
+    std::vector<ft::MoveOp> ops;
+    for (int i = 0; i < 10; i++) {
+        if (i != 3) {
+            const std::string n = "f" + std::to_string(i);
+            ops.push_back({dir / n, dir / cfg.disabled_dir / n});
+        }
+    }
+    ops.push_back({dir / "missing", dir / cfg.disabled_dir / "missing"});
+    std::vector<std::string> errs;
+    std::vector<size_t> failed;
+    assert(ft::move_batch(ops, batched, &errs, &failed) == 1);
+    assert(failed.size() == 1 && failed[0] == ops.size() - 1);
+    assert(existsRegular(dir / cfg.disabled_dir / "f9"));
+    assert(!fs::exists(dir / "f0"));
+
+    // Moves of the same file in one batch happen in order: there, back and
+    // there again, without errors, however the ring schedules them.
+    const fs::path en = dir / "f0";
+    const fs::path dis = dir / cfg.disabled_dir / "f0";
+    writeFile(dir / "h", "h");
+    const std::vector<ft::MoveOp> enable = {{dis, en}, {en, dis}, {dis, en}, {dir / "h", dir / "h2"}, {dir / "h2", dir / "h"}};
+    const std::vector<ft::MoveOp> disable = {{en, dis}, {dis, en}, {en, dis}};
+    for (int round = 0; round < 20; round++) {
+        assert(ft::move_batch(enable, batched, nullptr, nullptr) == 0);
+        assert(existsRegular(en) && !fs::exists(dis) && existsRegular(dir / "h"));
+        assert(ft::move_batch(disable, batched, nullptr, nullptr) == 0);
+        assert(existsRegular(dis) && !fs::exists(en));
+    }
+
+    fs::remove_all(dir);
+}
+
+static void testDeadlineScanPlaceholders() {
+    fs::path dir = makeTempDir();
+
+    ft::Config cfg;
+    cfg.disabled_dir = ".disable.d";
+    writeFile(dir / "a.txt", "aaa");
+    writeFile(dir / cfg.disabled_dir / "b.txt", "bb");
+    fs::create_directory(dir / "sub");
+
+    // Names only: nothing is stat'ed up front; the probes report later.
+    ft::Config names = cfg;
+    names.meta_scan = ft::MetaScan::NamesOnly;
+    std::mutex mu;
+    std::condition_variable cv;
+    std::map<std::string, std::uintmax_t> late;
+    ft::EntryTable t = ft::scan_dir_table(dir, names, [&](const ft::ScanEntry& e) {
+        std::lock_guard<std::mutex> lk(mu);
+        assert(!e.meta_pending && e.state != ft::FileState::Missing);
+        late[std::string(e.name)] = e.size;
+        cv.notify_all();
+    });
+    assert(t.size() == 3);
+    for (size_t i = 0; i < t.size(); i++) {
+        assert(t.meta_pending(i));
+        assert(t.is_dir(i) == (t.name(i) == "sub"));
+    }
+    {
+        std::unique_lock<std::mutex> lk(mu);
+        assert(cv.wait_for(lk, std::chrono::seconds(10), [&] { return late.size() == 3; }));
+    }
+    assert(late["a.txt"] == 3 && late["b.txt"] == 2);
+    t.set_meta(0, false, 1, {});
+    assert(!t.meta_pending(0));
+
+    // The recursive walk keeps the placeholders' pending flag.
+    size_t walked = 0;
+    ft::walk_tree(dir, names, {}, [&](const ft::EntryTable& entries) {
+        std::lock_guard<std::mutex> lk(mu);
+        for (size_t i = 0; i < entries.size(); i++) {
+            assert(entries.meta_pending(i));
+            walked++;
+        }
+    });
+    assert(walked == 3);
+
+    // A generous deadline behaves like a plain scan.
+    ft::Config deadline = cfg;
+    deadline.meta_scan = ft::MetaScan::Full;
+    deadline.probe_timeout_ms = 10000;
+    t = ft::scan_dir_table(dir, deadline);
+    assert(t.size() == 3);
+    for (size_t i = 0; i < t.size(); i++) {
+        assert(!t.meta_pending(i));
+        if (t.name(i) == "b.txt") {
+            assert(t.state(i) == ft::FileState::Disabled && t.file_size(i) == 2);
+        }
+    }
+
+    fs::remove_all(dir);
+}
+
+// Probes that never return tie up their workers; the pool replaces them,
+// so a later scan of another directory still gets its metadata.
+static void testStuckProbesReplaced() {
+    struct HangingBackend : ft::MemoryBackend {
+        std::mutex mu;
+        std::condition_variable cv;
+        bool released{false};
+
+        std::error_code stat(const fs::path& p, bool follow, ft::FsStat* out) override {
+            if (p.parent_path() == "/hung" && p.filename().native().front() == 'f') {
+                std::unique_lock<std::mutex> lk(mu);
+                cv.wait(lk, [this] { return released; });
+            }
+            return MemoryBackend::stat(p, follow, out);
+        }
+    };
+    // Leaked: the stuck workers still hold it when the test returns.
+    auto* mem = new HangingBackend();
+    const size_t kHung = 20;
+    for (size_t i = 0; i < kHung; i++) {
+        mem->add_file("/hung/f" + std::to_string(i), 1);
+    }
+    mem->add_file("/ok/a", 3);
+    mem->add_file("/ok/b", 4);
+
+    ft::Config cfg;
+    cfg.verbosity = ft::Verbosity::Quiet;
+    cfg.backend = mem;
+    cfg.meta_scan = ft::MetaScan::Full;
+    cfg.probe_timeout_ms = 50;
+
+    ft::EntryTable t = ft::scan_dir_table("/hung", cfg);
+    assert(t.size() == kHung);
+    for (size_t i = 0; i < t.size(); i++) {
+        assert(t.meta_pending(i));
+    }
+
+    t = ft::scan_dir_table("/ok", cfg);
+    assert(t.size() == 2);
+    for (size_t i = 0; i < t.size(); i++) {
+        assert(!t.meta_pending(i));
+        assert(t.file_size(i) == (t.name(i) == "a" ? 3u : 4u));
+    }
+
+    {
+        std::lock_guard<std::mutex> lk(mem->mu);
+        mem->released = true;
+    }
+    mem->cv.notify_all();
+
+    // Slow but healthy: a deadline runs from when a worker starts the
+    // probe, so entries queued behind their neighbours are not cut short.
+    ft::MemoryBackend slow;
+    for (size_t i = 0; i < 64; i++) {
+        slow.add_file("/slow/f" + std::to_string(i), 1);
+    }
+    ft::MemoryBackend::Latency latency;
+    latency.stat = std::chrono::milliseconds(10);
+    slow.set_latency(latency);
+    cfg.backend = &slow;
+    cfg.probe_timeout_ms = 200;
+    t = ft::scan_dir_table("/slow", cfg);
+    assert(t.size() == 64);
+    for (size_t i = 0; i < t.size(); i++) {
+        assert(!t.meta_pending(i));
+    }
+}
+
+static void testSymlinkScanModes() {
+    fs::path dir = makeTempDir();
+
+    ft::Config cfg;
+    cfg.disabled_dir = ".disable.d";
+    writeFile(dir / "a.txt", "aaa");
+    fs::create_directory(dir / "sub");
+    fs::create_symlink("a.txt", dir / "to-file");
+    fs::create_directory_symlink("sub", dir / "to-dir");
+    fs::create_symlink("missing", dir / "dangling");
+
+    auto find = [](const ft::EntryTable& t, std::string_view name) {
+        for (size_t i = 0; i < t.size(); i++) {
+            if (t.name(i) == name) {
+                return i;
+            }
+        }
+        assert(false);
+        return t.size();
+    };
+
+    ft::Config batched = cfg;
+    batched.io_queue_depth = 4;
+    ft::Config deadline = cfg;
+    deadline.meta_scan = ft::MetaScan::Full;
+    deadline.probe_timeout_ms = 10000;
+    for (ft::Config c : {cfg, batched, deadline}) {
+        // Following: targets are stat'ed and a dangling link is still listed.
+        ft::EntryTable t = ft::scan_dir_table(dir, c);
+        assert(t.size() == 5);
+        assert(!t.is_symlink(find(t, "to-file")) && t.file_size(find(t, "to-file")) == 3);
+        assert(t.is_dir(find(t, "to-dir")) && !t.is_symlink(find(t, "to-dir")));
+        assert(t.is_symlink(find(t, "dangling")) && !t.is_dir(find(t, "dangling")));
+
+        // Not following: every link is a link of size 0.
+        c.follow_symlinks = false;
+        t = ft::scan_dir_table(dir, c);
+        assert(t.size() == 5);
+        for (const char* link : {"to-file", "to-dir", "dangling"}) {
+            const size_t i = find(t, link);
+            assert(t.is_symlink(i) && !t.is_dir(i) && t.file_size(i) == 0);
+        }
+        assert(!t.is_symlink(find(t, "a.txt")) && t.is_dir(find(t, "sub")));
+    }
+
+    auto link = ft::resolve_link(dir / "to-dir");
+    assert(link && link->target == "sub" && link->is_dir && !link->dangling);
+    link = ft::resolve_link(dir / "dangling");
+    assert(link && link->dangling);
+    assert(!ft::resolve_link(dir / "a.txt"));
+
+    fs::remove_all(dir);
+}
+
+static void testTreeSizes() {
+    fs::path dir = makeTempDir();
+
+    writeFile(dir / "a" / "one", std::string(100, 'x'));
+    writeFile(dir / "a" / "b" / "two", std::string(20, 'x'));
+    writeFile(dir / "a" / "b" / "c" / "three", std::string(3, 'x'));
+    fs::create_hard_link(dir / "a" / "one", dir / "a" / "b" / "one-again");
+    fs::create_symlink("one", dir / "a" / "link");
+    writeFile(dir / "other", std::string(7, 'x'));
+
+    ft::DuCache cache;
+    std::atomic<bool> cancel{false};
+    ft::TreeSize t = ft::measure_tree(dir / "a", cache, cancel);
+    assert(t.complete);
+    assert(t.bytes == 123 && t.files == 3 && t.dirs == 3);
+    assert(cache.size() == 3);
+
+    // Cached by mtime: a file grown in place is not seen until its
+    // directory changes.
+    writeFile(dir / "a" / "b" / "c" / "three", std::string(5, 'x'));
+    assert(ft::measure_tree(dir / "a", cache, cancel).bytes == 123);
+    writeFile(dir / "a" / "b" / "c" / "four", "4444");
+    // Directory mtimes may be coarser than the time this test takes.
+    fs::last_write_time(dir / "a" / "b" / "c", fs::last_write_time(dir / "a" / "b" / "c") + std::chrono::seconds(1));
+    assert(ft::measure_tree(dir / "a", cache, cancel).bytes == 129);
+
+    cancel = true;
+    assert(!ft::measure_tree(dir / "a", cache, cancel).complete);
+
+    // Not a directory: an empty tree.
+    cancel = false;
+    t = ft::measure_tree(dir / "other", cache, cancel);
+    assert(t.complete && t.bytes == 0);
+
+    ft::DuEngine du(2);
+    std::mutex mu;
+    std::condition_variable cv;
+    std::map<size_t, ft::TreeSize> done;
+    du.start({dir / "a", dir / "a" / "b", dir / "missing"}, [&](size_t root, const ft::TreeSize& size) {
+        if (size.complete) {
+            std::lock_guard<std::mutex> lk(mu);
+            done[root] = size;
+            cv.notify_all();
+        }
+    });
+    {
+        std::unique_lock<std::mutex> lk(mu);
+        assert(cv.wait_for(lk, std::chrono::seconds(10), [&] { return done.size() == 3; }));
+    }
+    // b holds the other link to a/one.
+    assert(done[0].bytes == 129 && done[1].bytes == 129 && done[2].bytes == 0);
+
+    fs::remove_all(dir);
+}
+
+static void testEntryNameIndex() {
+    ft::Config cfg;
+    ft::EntryTable t(fs::path("/nowhere"), cfg);
+    const auto now = fs::file_time_type::clock::now();
+    // Reverse name order, so the lowest matching row is the last in name
+    // order and lies in another block of the index.
+    for (int i = 199; i >= 0; i--) {
+        char name[16];
+        std::snprintf(name, sizeof(name), "f%03d", i);
+        t.add(name, ft::FileState::Enabled, false, 0, now);
+    }
+    t.add("g", ft::FileState::Enabled, false, 0, now);
+
+    ft::EntryNameIndex index;
+    index.rebuild(t);
+    assert(index.find("f000") == 199);
+    assert(index.find("f199") == 0);
+    assert(index.find("g") == 200);
+    assert(index.find("f") == ft::EntryNameIndex::npos);
+
+    assert(index.first_with_prefix("f") == 0);
+    assert(index.first_with_prefix("f00") == 190);
+    assert(index.first_with_prefix("f1") == 0);
+    assert(index.first_with_prefix("f05") == 140);
+    assert(index.first_with_prefix("g") == 200);
+    assert(index.first_with_prefix("h") == ft::EntryNameIndex::npos);
+    assert(index.first_with_prefix("") == 0);
+
+    t.reverse();
+    index.rebuild(t);
+    assert(index.find("g") == 0);
+    assert(index.first_with_prefix("f1") == 101);
+}
+
+static void testNameSearch() {
+    // find_substring() against string_view::find, with needles that span
+    // SIMD blocks, sit at either end, or share their first and last bytes
+    // with near misses.
+    std::string hay;
+    for (int i = 0; i < 500; i++) {
+        hay.push_back("abcab"[(i * 7 + i / 13) % 5]);
+    }
+    hay += "xyzzy";
+    const std::string_view h(hay);
+    for (std::string_view needle : {"a", "x", "ab", "aa", "abca", "acab", "cabcab", "xyzzy", "zy", "y", "q", "",
+                                    "bcabcabcabcabcabcab", "abcabcabcabcabcabcabcabcabcabcabcabx"}) {
+        for (size_t from : {size_t{0}, size_t{1}, size_t{15}, size_t{17}, size_t{250}, h.size() - 3, h.size(), h.size() + 1}) {
+            assert(ft::find_substring(h, needle, from) == h.find(needle, from));
+        }
+    }
+
+    ft::Config cfg;
+    ft::EntryTable t(fs::path("/nowhere"), cfg);
+    const auto now = fs::file_time_type::clock::now();
+    for (const char* name : {"Makefile", "main.cpp", "MAIN.h", "readme", "domain.conf", "man"}) {
+        t.add(name, ft::FileState::Enabled, false, 0, now);
+    }
+    ft::NameSearch search;
+    search.rebuild(t);
+    using Rows = std::vector<uint32_t>;
+    assert(search.filter("") == Rows({0, 1, 2, 3, 4, 5}));
+    // Case-insensitive, and one row per name however often it matches.
+    assert(search.filter("ma") == Rows({0, 1, 2, 4, 5}));
+    // Narrowed from the previous rows.
+    assert(search.filter("mai") == Rows({1, 2, 4}));
+    assert(search.filter("main.") == Rows({1, 2, 4}));
+    assert(search.filter("MAIN.C") == Rows({1, 4}));
+    // Shorter again: back to the whole buffer.
+    assert(search.filter("e") == Rows({0, 3}));
+    // No match across the end of a name.
+    assert(search.filter("emai").empty());
+    assert(search.filter(std::string_view("a\0m", 3)).empty());
+    assert(search.filter("") == Rows({0, 1, 2, 3, 4, 5}));
+}
+
+static void testRowFormatting() {
+    assert(ft::format_size(0) == "0 B");
+    assert(ft::format_size(1023) == "1023 B");
+    assert(ft::format_size(1024) == "1.00 KB");
+    assert(ft::format_size(1536) == "1.50 KB");
+    assert(ft::format_size(5ull << 40) == "5.00 TB");
+    assert(ft::format_size(2000ull << 40) == "2,000.00 TB");
+
+    // Same text as ctime(3), minus the newline, across minutes and days.
+    ft::TimeFormatter tf;
+    for (std::time_t t : {std::time_t(0), std::time_t(59), std::time_t(60), std::time_t(86399),
+                          std::time_t(1700000000), std::time_t(1700000059), std::time_t(1700000000),
+                          std::time_t(-61), std::time_t(1793000000)}) {
+        char buf[32];
+        assert(::ctime_r(&t, buf));
+        std::string expected(buf);
+        expected.pop_back();
+        assert(tf.format(t) == expected);
+    }
+
+    ft::Config cfg;
+    ft::EntryTable t(fs::path("/nowhere"), cfg);
+    const auto mtime = std::chrono::file_clock::from_sys(std::chrono::sys_seconds(std::chrono::seconds(1700000000)));
+    t.add("f", ft::FileState::Enabled, false, 2048, mtime);
+    t.add("d", ft::FileState::Enabled, true, 0, mtime);
+    t.add("p", ft::FileState::Enabled, false, 0, mtime, true);
+
+    ft::EntryCells cells;
+    cells.reset(t.size());
+    assert(cells.size(t, 0) == "2.00 KB");
+    assert(cells.mtime(t, 0) == tf.format(std::time_t(1700000000)));
+    assert(cells.size(t, 1).empty());
+    assert(cells.size(t, 2) == "\xe2\x80\xa6" && cells.mtime(t, 2) == "\xe2\x80\xa6");
+
+    // Cached until invalidated.
+    t.set_tree_size(1, 4096, false);
+    assert(cells.size(t, 1).empty());
+    cells.invalidate(1);
+    assert(cells.size(t, 1) == "4.00 KB\xe2\x80\xa6");
+    t.set_meta(2, false, 10, mtime);
+    cells.invalidate(2);
+    assert(cells.size(t, 2) == "10 B");
+}
+
+static void testListFormatEscaping() {
+    auto tsv = [](std::string_view s) {
+        std::ostringstream out;
+        ft::write_tsv_field(out, s);
+        return out.str();
+    };
+    auto json = [](std::string_view s) {
+        std::ostringstream out;
+        ft::write_json_string(out, s);
+        return out.str();
+    };
+
+    assert(tsv("a\tb\nc\\d\re") == "a\\tb\\nc\\\\d\\re");
+    assert(tsv("caf\xc3\xa9 \xff") == "caf\xc3\xa9 \xff");
+
+    assert(json("a\tb\nc\\d\"e") == "\"a\\tb\\nc\\\\d\\\"e\"");
+    assert(json(std::string_view("\x01\0", 2)) == "\"\\u0001\\u0000\"");
+    // Valid UTF-8 passes through, up to four-byte sequences.
+    assert(json("caf\xc3\xa9 \xe2\x82\xac \xf0\x9f\x98\x80") == "\"caf\xc3\xa9 \xe2\x82\xac \xf0\x9f\x98\x80\"");
+    // Each byte that starts no valid sequence becomes U+FFFD.
+    assert(json("a\xff" "b") == "\"a\\ufffd" "b\"");
+    assert(json("\x80") == "\"\\ufffd\"");                      // stray continuation
+    assert(json("\xc0\xaf") == "\"\\ufffd\\ufffd\"");             // overlong '/'
+    assert(json("\xed\xa0\x80") == "\"\\ufffd\\ufffd\\ufffd\"");   // surrogate
+    assert(json("\xf4\x90\x80\x80") == "\"\\ufffd\\ufffd\\ufffd\\ufffd\""); // past U+10FFFF
+    assert(json("\xe2\x82") == "\"\\ufffd\\ufffd\"");             // truncated
+
+    ft::ScanEntry e;
+    e.name = "x\ty\xff";
+    e.state = ft::FileState::Disabled;
+    e.meta_pending = true;
+    std::ostringstream out;
+    ft::write_list_entry(out, "d/", e, ft::ListFormat::Tsv);
+    ft::write_list_entry(out, "d/", e, ft::ListFormat::Json);
+    assert(out.str() == "disabled\tfile\t-\t-\td/x\\ty\xff\n"
+                        "{\"name\":\"d/x\\ty\\ufffd\",\"state\":\"disabled\",\"type\":\"file\",\"size\":null,\"mtime\":null}\n");
+}
+
+static void testMemoryBackend() {
+    ft::MemoryBackend mem;
+    const auto t0 = std::chrono::file_clock::from_sys(std::chrono::sys_seconds(std::chrono::seconds(1700000000)));
+    mem.add_file("/d/a.conf", 3, t0);
+    mem.add_file("/d/.disable.d/b.conf.off", 5, t0);
+    mem.add_file("/d/sub/inner", 1);
+    mem.add_symlink("/d/l", "a.conf");
+    mem.add_symlink("/d/dangling", "missing");
+
+    ft::Config cfg;
+    cfg.verbosity = ft::Verbosity::Quiet;
+    cfg.disabled_suffix = ".off";
+    cfg.backend = &mem;
+
+    ft::EntryTable t = ft::scan_dir_table("/d", cfg);
+    std::map<std::string, size_t> rows;
+    for (size_t i = 0; i < t.size(); i++) {
+        rows[std::string(t.name(i))] = i;
+    }
+    assert(rows.size() == 5);
+    assert(t.state(rows["a.conf"]) == ft::FileState::Enabled && t.file_size(rows["a.conf"]) == 3);
+    assert(t.mtime(rows["a.conf"]) == t0);
+    assert(t.state(rows["b.conf"]) == ft::FileState::Disabled && t.file_size(rows["b.conf"]) == 5);
+    assert(t.is_dir(rows["sub"]));
+    assert(!t.is_symlink(rows["l"]) && t.file_size(rows["l"]) == 3);
+    assert(t.is_symlink(rows["dangling"]));
+
+    std::string err;
+    assert(ft::disable_one("/d/a.conf", cfg, &err));
+    assert(!mem.exists("/d/a.conf") && mem.exists("/d/.disable.d/a.conf.off"));
+    assert(ft::toggle_one("/d/b.conf", cfg, &err));
+    assert(mem.exists("/d/b.conf"));
+    assert(ft::rename_one("/d/a.conf", "c.conf", cfg, &err));
+    assert(mem.exists("/d/.disable.d/c.conf.off"));
+    assert(!ft::enable_one("/d/a.conf", cfg, &err));
+    assert(ft::get_state("/d/c.conf", cfg) == ft::FileState::Disabled);
+
+    // A disabled dir is created on first use, and directories move with
+    // their contents.
+    mem.add_file("/e/x", 1);
+    assert(ft::disable_one("/e/x", cfg, &err));
+    assert(mem.exists("/e/.disable.d/x.off"));
+    assert(ft::disable_one("/d/sub", cfg, &err));
+    assert(mem.exists("/d/.disable.d/sub.off/inner") && !mem.exists("/d/sub"));
+    assert(ft::get_state("/d/sub", cfg) == ft::FileState::Disabled);
+
+    // The recursive walk goes through the backend too, with or without
+    // the entries of directories lacking a disabled dir.
+    mem.add_file("/d/sub2/deep/z", 1);
+    mem.add_file("/d/sub2/deep/.disable.d/y.off", 1);
+    for (bool disabled_only : {false, true}) {
+        ft::WalkOptions wo;
+        wo.disabled_only = disabled_only;
+        std::mutex mu;
+        std::set<std::string> dirs;
+        ft::walk_tree("/d", cfg, wo, [&](const ft::EntryTable& entries) {
+            std::lock_guard<std::mutex> lk(mu);
+            dirs.insert(entries.dir().string());
+        });
+        if (disabled_only) {
+            assert((dirs == std::set<std::string>{"/d", "/d/sub2/deep"}));
+        } else {
+            assert((dirs == std::set<std::string>{"/d", "/d/sub2", "/d/sub2/deep"}));
+        }
+    }
+
+    // Every call pays its latency.
+    ft::MemoryBackend::Latency latency;
+    latency.stat = std::chrono::milliseconds(2);
+    mem.set_latency(latency);
+    const auto start = std::chrono::steady_clock::now();
+    ft::scan_dir_table("/e", cfg);
+    assert(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(2));
+}
+
+// Filesystem calls per operation, counted at the backend.  Raise a budget
+// only for a change that needs the extra calls.
+static void testSyscallBudgets() {
+    fs::path dir = makeTempDir();
+    const size_t kEnabled = 200;
+    const size_t kDisabled = 50;
+    for (size_t i = 0; i < kEnabled; i++) {
+        writeFile(dir / ("e" + std::to_string(i)), "x");
+    }
+    for (size_t i = 0; i < kDisabled; i++) {
+        writeFile(dir / ".disable.d" / ("d" + std::to_string(i)), "x");
+    }
+    const size_t n = kEnabled + kDisabled;
+
+    ft::CountingBackend counting(ft::posix_backend());
+    ft::Config cfg;
+    cfg.verbosity = ft::Verbosity::Quiet;
+    cfg.backend = &counting;
+
+    // Scans: one stat per entry, one readdir per directory.
+    for (ft::MetaScan mode : {ft::MetaScan::Full, ft::MetaScan::Auto}) {
+        for (unsigned timeout : {0u, 10000u}) {
+            cfg.meta_scan = mode;
+            cfg.probe_timeout_ms = timeout;
+            counting.reset();
+            assert(ft::scan_dir_table(dir, cfg).size() == n);
+            const auto c = counting.counts();
+            assert(c.stat + c.lstat <= n + 2);
+            assert(c.read_dir <= 2);
+            assert(c.rename == 0 && c.copy == 0 && c.remove == 0 && c.mkdir == 0);
+        }
+    }
+    cfg.meta_scan = ft::MetaScan::Auto;
+    cfg.probe_timeout_ms = 0;
+
+    cfg.follow_symlinks = false;
+    counting.reset();
+    ft::scan_dir_table(dir, cfg);
+    assert(counting.counts().stat == 0 && counting.counts().lstat <= n + 2);
+    cfg.follow_symlinks = true;
+
+    // Completion lists names only: no stat at all.
+    ft::Config names_cfg = cfg;
+    names_cfg.meta_scan = ft::MetaScan::NamesOnly;
+    counting.reset();
+    size_t seen = 0;
+    ft::scan_dir(dir, names_cfg, [&](const ft::ScanEntry&) {
+        seen++;
+        return true;
+    });
+    assert(seen == n);
+    assert(counting.counts().stat == 0 && counting.counts().lstat == 0);
+    assert(counting.counts().read_dir <= 2);
+
+    // Toggling: one rename and a few existence checks.
+    std::string err;
+    for (const char* name : {"e1", "e1", "d1", "d1"}) {
+        counting.reset();
+        assert(ft::toggle_one(dir / name, cfg, &err));
+        const auto c = counting.counts();
+        assert(c.rename == 1 && c.copy == 0 && c.remove == 0 && c.mkdir == 0);
+        assert(c.stat + c.lstat <= 3);
+        assert(c.read_dir == 0);
+    }
+    counting.reset();
+    assert(ft::disable_one(dir / "e2", cfg, &err));
+    assert(counting.counts().rename == 1 && counting.counts().stat <= 2);
+    counting.reset();
+    assert(ft::enable_one(dir / "e2", cfg, &err));
+    assert(counting.counts().rename == 1 && counting.counts().stat <= 1);
+    counting.reset();
+    assert(ft::rename_one(dir / "e3", "renamed", cfg, &err));
+    assert(counting.counts().rename == 1 && counting.counts().stat <= 2);
+
+    // A single-entry probe stats the entry and its disabled copy.
+    counting.reset();
+    ft::ScanEntry e;
+    assert(ft::probe_entry(dir, "e4", cfg, &e));
+    assert(counting.counts().stat + counting.counts().lstat <= 3);
+
+    fs::remove_all(dir);
+}
+
+static void testDisabledCountIndex() {
+    fs::path dir = makeTempDir();
+
+    ft::Config cfg;
+    cfg.disabled_dir = ".disable.d";
+    cfg.disabled_suffix = ".off";
+    writeFile(dir / "a" / cfg.disabled_dir / "x.off", "x");
+    writeFile(dir / "a" / cfg.disabled_dir / "y.off", "y");
+    writeFile(dir / "a" / cfg.disabled_dir / "stray", "not decorated");
+    fs::create_directories(dir / "b");
+
+    assert(ft::count_disabled_entries(dir / "a", cfg) == 2);
+    assert(ft::count_disabled_entries(dir / "b", cfg) == 0);
+
+    ft::DisabledCountIndex index(cfg);
+    std::mutex mu;
+    std::condition_variable cv;
+    std::map<std::string, size_t> counts;
+    index.request({dir / "a", dir / "b", dir / "missing"}, [&](const fs::path& d, size_t n) {
+        std::lock_guard<std::mutex> lk(mu);
+        counts[d.filename().string()] = n;
+        cv.notify_all();
+    });
+    {
+        std::unique_lock<std::mutex> lk(mu);
+        assert(cv.wait_for(lk, std::chrono::seconds(10), [&] { return counts.size() == 3; }));
+    }
+    assert(counts["a"] == 2 && counts["b"] == 0 && counts["missing"] == 0);
+
+    // A move into the disabled dir changes its mtime and the count.
+    writeFile(dir / "a" / "z", "z");
+    std::string err;
+    assert(ft::disable_one(dir / "a" / "z", cfg, &err));
+    const fs::path dd = dir / "a" / cfg.disabled_dir;
+    fs::last_write_time(dd, fs::last_write_time(dd) + std::chrono::seconds(1));
+    assert(index.count(dir / "a") == 3);
+    assert(index.count(dir / "b") == 0);
+
+    fs::remove_all(dir);
+}
+
+static void testRunStats() {
+    ft::MemoryBackend mem;
+    for (int i = 0; i < 6; i++) {
+        mem.add_file("/d/e" + std::to_string(i), 1);
+    }
+    for (int i = 0; i < 4; i++) {
+        mem.add_file("/d/.disable.d/d" + std::to_string(i), 1);
+    }
+
+    ft::RunStats stats;
+    ft::Config cfg;
+    cfg.verbosity = ft::Verbosity::Quiet;
+    cfg.backend = &mem;
+    cfg.stats = &stats;
+
+    ft::EntryTable t = ft::scan_dir_table("/d", cfg);
+    assert(stats.entries(ft::FileState::Enabled) == 6 && stats.entries(ft::FileState::Disabled) == 4);
+    assert(stats.phase(ft::RunStats::Scan).calls == 1);
+
+    std::vector<ft::MoveOp> ops;
+    for (size_t i = 0; i < t.size(); i++) {
+        if (t.state(i) == ft::FileState::Enabled) {
+            ops.push_back({t.enabled_path(i), t.disabled_path(i)});
+        }
+    }
+    ft::ensure_disabled_dir_exists("/d", cfg, false);
+    assert(ft::move_batch(ops, cfg, nullptr) == 0);
+    assert(stats.moves(false) == 6 && stats.moves(true) == 0 && stats.bytes_copied() == 0);
+    assert(stats.phase(ft::RunStats::Rename).calls == 6);
+    assert(stats.phase(ft::RunStats::Mkdir).calls == 1);
+
+    // Nearest-rank percentiles.
+    ft::RunStats lat;
+    for (int ms = 100; ms >= 1; ms--) {
+        lat.record(ft::RunStats::Copy, std::chrono::milliseconds(ms));
+    }
+    const auto copy = lat.phase(ft::RunStats::Copy);
+    assert(copy.calls == 100);
+    assert(copy.p50 == std::chrono::milliseconds(50) && copy.p99 == std::chrono::milliseconds(99));
+    assert(copy.total == std::chrono::milliseconds(5050));
+    assert(lat.phase(ft::RunStats::Scan).calls == 0);
+
+    std::ostringstream json;
+    stats.write_json(json);
+    assert(json.str().find("\"same_device\":6") != std::string::npos);
+    assert(json.str().find("\"rename_batch\":{\"calls\":0") != std::string::npos);
+}
+
+static void testTraceFile() {
+    fs::path dir = makeTempDir();
+    writeFile(dir / "a", "x");
+    const fs::path file = dir / "trace.json";
+
+    { ft::TraceSpan before("before_start"); }
+    std::string err;
+    assert(!ft::trace_start(dir / "missing" / "trace.json", &err) && !err.empty());
+    assert(ft::trace_start(file, &err));
+    {
+        ft::TraceSpan span("outer", "test");
+        span.set_count(3);
+        span.next("second");
+    }
+    std::thread([] { ft::TraceSpan span("worker", "test"); }).join();
+    ft::Config cfg;
+    cfg.verbosity = ft::Verbosity::Quiet;
+    ft::scan_dir_table(dir, cfg);
+    ft::trace_stop();
+    { ft::TraceSpan after("after_stop"); }
+    assert(!ft::trace_enabled());
+
+    std::ifstream in(file);
+    const std::string json((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    assert(json.starts_with("{\"displayTimeUnit\":\"ms\",\"traceEvents\":["));
+    assert(json.ends_with("]}\n"));
+    assert(json.find("\"name\":\"outer\",\"cat\":\"test\",\"ph\":\"X\"") != std::string::npos);
+    assert(json.find("\"args\":{\"count\":3}") != std::string::npos);
+    assert(json.find("\"second\"") != std::string::npos);
+    assert(json.find("\"worker\"") != std::string::npos);
+    assert(json.find("\"scan_dir\"") != std::string::npos);
+    assert(json.find("before_start") == std::string::npos && json.find("after_stop") == std::string::npos);
+    fs::remove_all(dir);
+}
+
+static void testStallWatchdog() {
+    fs::path dir = makeTempDir();
+    const fs::path log = dir / "stalls.log";
+    const int fd = ::open(log.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    assert(fd >= 0);
+    {
+        ft::StallWatchdog watchdog(std::chrono::milliseconds(100), fd);
+        watchdog.set_context("/some/dir");
+        for (int i = 0; i < 10; i++) {
+            watchdog.heartbeat();
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        assert(watchdog.stalls() == 0);
+
+        // Busy without heartbeats: one report, however long it lasts.
+        std::this_thread::sleep_for(std::chrono::milliseconds(400));
+        assert(watchdog.stalls() == 1);
+        watchdog.heartbeat();
+    }
+    ::close(fd);
+
+    std::ifstream in(log);
+    const std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    assert(text.find("UI thread stalled for ") != std::string::npos);
+    assert(text.find(" in /some/dir") != std::string::npos);
+    // backtrace_symbols_fd() frames: "binary(symbol+offset)[address]".
+    assert(text.find(")[0x") != std::string::npos);
+    assert(text.find("UI thread resumed after ") != std::string::npos);
+
+    // A thread that cannot take the signal in time, as one blocked in the
+    // kernel: no stack, and none appended when it finally runs the handler.
+    const fs::path late_log = dir / "late.log";
+    const int late_fd = ::open(late_log.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    assert(late_fd >= 0);
+    {
+        ft::StallWatchdog watchdog(std::chrono::milliseconds(100), late_fd);
+        sigset_t usr2, old;
+        sigemptyset(&usr2);
+        sigaddset(&usr2, SIGUSR2);
+        ::pthread_sigmask(SIG_BLOCK, &usr2, &old);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+        assert(watchdog.stalls() == 1);
+        ::pthread_sigmask(SIG_SETMASK, &old, nullptr);
+        watchdog.heartbeat();
+    }
+    ::close(late_fd);
+    std::ifstream late_in(late_log);
+    const std::string late_text((std::istreambuf_iterator<char>(late_in)), std::istreambuf_iterator<char>());
+    assert(late_text.find("(not captured") != std::string::npos);
+    assert(late_text.find(")[0x") == std::string::npos);
+    fs::remove_all(dir);
+}
+
+static void testScanNameFilter() {
+    fs::path dir = makeTempDir();
+    for (int i = 0; i < 10; i++) {
+        writeFile(dir / ("keep" + std::to_string(i)), "x");
+        writeFile(dir / ("noise" + std::to_string(i) + ".swp"), "x");
+        writeFile(dir / ".disable.d" / ("off" + std::to_string(i) + ".swp"), "x");
+    }
+    writeFile(dir / ".disable.d" / "keep0", "x");
+    writeFile(dir / ".disable.d" / "off", "x");
+
+    ft::CountingBackend counting(ft::posix_backend());
+    ft::Config cfg;
+    cfg.verbosity = ft::Verbosity::Quiet;
+    cfg.backend = &counting;
+    cfg.name_filter = [](std::string_view name) { return !name.ends_with(".swp"); };
+
+    // Sync, deadline and names-only scans: rejected names are never stat'ed.
+    for (auto [mode, timeout] : {std::pair{ft::MetaScan::Full, 0u}, std::pair{ft::MetaScan::Full, 10000u},
+                                 std::pair{ft::MetaScan::NamesOnly, 0u}}) {
+        cfg.meta_scan = mode;
+        cfg.probe_timeout_ms = timeout;
+        counting.reset();
+        ft::EntryTable t = ft::scan_dir_table(dir, cfg);
+        assert(t.size() == 11);
+        for (size_t i = 0; i < t.size(); i++) {
+            assert(!t.name(i).ends_with(".swp"));
+            assert(t.state(i) == (t.name(i) == "keep0" || t.name(i) == "off" ? ft::FileState::Disabled : ft::FileState::Enabled));
+        }
+        const auto c = counting.counts();
+        assert(c.stat + c.lstat <= (mode == ft::MetaScan::NamesOnly ? 0u : 11u + 2u));
+    }
+
+    // The io_uring scan bypasses the backend; it filters all the same.
+    cfg.meta_scan = ft::MetaScan::Full;
+    cfg.probe_timeout_ms = 0;
+    cfg.io_queue_depth = 8;
+    assert(ft::scan_dir_table(dir, cfg).size() == 11);
+    fs::remove_all(dir);
+}
+
+static std::set<std::string> manifestNames(const ft::DisabledManifest& m) {
+    std::set<std::string> names;
+    for (size_t i = 0; i < m.size(); i++) {
+        names.insert(std::string(m.name(i)));
+    }
+    return names;
+}
+
+static void testManifestTracksMoves() {
+    fs::path dir = makeTempDir();
+
+    ft::Config cfg;
+    cfg.disabled_dir = ".disable.d";
+    cfg.disabled_suffix = ".off";
+    cfg.manifest = true;
+
+    writeFile(dir / "a.txt", "a");
+    writeFile(dir / "b.txt", "b");
+    std::string err;
+    assert(ft::disable_one(dir / "a.txt", cfg, &err));
+    assert(ft::disable_one(dir / "b.txt", cfg, &err));
+    assert(existsRegular(dir / cfg.disabled_dir / std::string(ft::kManifestName)));
+
+    ft::DisabledManifest m;
+    assert(m.open(dir, cfg));
+    assert((manifestNames(m) == std::set<std::string>{"a.txt", "b.txt"}));
+
+    // Maintained in place by the core operations.
+    assert(ft::enable_one(dir / "a.txt", cfg, &err));
+    assert(ft::rename_one(dir / "b.txt", "c.txt", cfg, &err));
+    assert(m.open(dir, cfg));
+    assert((manifestNames(m) == std::set<std::string>{"c.txt"}));
+
+    // Moves are appended; the file is rewritten only once they outgrow
+    // the names, so it stays small however many toggles are made.
+    writeFile(dir / "f.txt", "f");
+    for (int i = 0; i < 500; i++) {
+        assert(ft::toggle_one(dir / "f.txt", cfg, &err));
+    }
+    assert(m.open(dir, cfg));
+    assert((manifestNames(m) == std::set<std::string>{"c.txt"}));
+    assert(fs::file_size(dir / cfg.disabled_dir / std::string(ft::kManifestName)) < 3 * 4096);
+
+    // So are batches, synchronous and through io_uring alike.
+    writeFile(dir / "g.txt", "g");
+    writeFile(dir / "h.txt", "h");
+    const fs::path dd = dir / cfg.disabled_dir;
+    std::vector<ft::MoveOp> batch{{dir / "g.txt", dd / "g.txt.off"}, {dir / "h.txt", dd / "h.txt.off"},
+                                  {dd / "c.txt.off", dir / "c.txt"}};
+    assert(ft::move_batch(batch, cfg, nullptr) == 0);
+    assert(m.open(dir, cfg));
+    assert((manifestNames(m) == std::set<std::string>{"g.txt", "h.txt"}));
+    ft::Config batched = cfg;
+    batched.io_queue_depth = 4;
+    batch = {{dd / "g.txt.off", dir / "g.txt"}, {dir / "c.txt", dd / "c.txt.off"}};
+    assert(ft::move_batch(batch, batched, nullptr) == 0);
+    assert(m.open(dir, cfg));
+    assert((manifestNames(m) == std::set<std::string>{"c.txt", "h.txt"}));
+    // A failed move leaves a manifest that matches the directory.
+    batch = {{dd / "h.txt.off", dir / "h.txt"}, {dir / "missing.txt", dd / "missing.txt.off"}};
+    assert(ft::move_batch(batch, cfg, nullptr) == 1);
+    assert(m.open(dir, cfg));
+    assert((manifestNames(m) == std::set<std::string>{"c.txt"}));
+
+    // Another decoration does not accept it.
+    ft::Config other = cfg;
+    other.disabled_suffix = ".bak";
+    assert(!m.open(dir, other));
+
+    // A change behind its back makes it stale.  Readers list the disabled
+    // dir instead and leave the manifest alone; the next move rebuilds it.
+    writeFile(dir / cfg.disabled_dir / "d.txt.off", "d");
+    assert(!m.open(dir, cfg));
+    const auto manifest_mtime = fs::last_write_time(dir / cfg.disabled_dir / std::string(ft::kManifestName));
+    std::set<std::string> disabled;
+    ft::scan_dir(dir, cfg, [&](const ft::ScanEntry& e) {
+        if (e.state == ft::FileState::Disabled) {
+            disabled.insert(std::string(e.name));
+        }
+        return true;
+    });
+    assert((disabled == std::set<std::string>{"c.txt", "d.txt"}));
+    assert(!m.open(dir, cfg));
+    assert(fs::last_write_time(dir / cfg.disabled_dir / std::string(ft::kManifestName)) == manifest_mtime);
+    writeFile(dir / "e.txt", "e");
+    assert(ft::disable_one(dir / "e.txt", cfg, &err));
+    assert(m.open(dir, cfg));
+    assert((manifestNames(m) == std::set<std::string>{"c.txt", "d.txt", "e.txt"}));
+
+    // Without a suffix the manifest would look like a disabled entry.
+    ft::Config plain;
+    plain.disabled_dir = cfg.disabled_dir;
+    ft::scan_dir(dir, plain, [&](const ft::ScanEntry& e) {
+        assert(!ft::is_manifest_name(e.name));
+        return true;
+    });
+
+    fs::remove_all(dir);
+}
+
+static void testDaemonPipelinedRequests() {
+    fs::path dir = makeTempDir();
+    const fs::path sock = dir / "d.sock";
+
+    ft::Config cfg;
+    cfg.disabled_dir = ".disable.d";
+    cfg.verbosity = ft::Verbosity::Quiet;
+
+    fs::create_directory(dir / "w");
+    writeFile(dir / "w" / "a.txt", "a");
+    writeFile(dir / "w" / "b.txt", "b");
+
+    pid_t pid = ::fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+        ::_exit(ft::run_daemon(sock, cfg));
+    }
+
+    std::unique_ptr<ft::DaemonClient> client;
+    for (int i = 0; i < 200 && !client; i++) {
+        client = ft::DaemonClient::connect(sock, cfg);
+        if (!client) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+    assert(client);
+
+    const std::string w = (dir / "w").string();
+    client->send({"DISABLE", w + "/a.txt"});
+    client->send({"TOGGLE", w + "/b.txt"});
+    client->send({"ENABLE", w + "/missing.txt"});
+    client->send({"STATE", w + "/a.txt"});
+    std::vector<std::vector<std::string>> data;
+    std::string err;
+    assert(client->receive(nullptr, &err));
+    assert(client->receive(nullptr, &err));
+    assert(!client->receive(nullptr, &err));
+    assert(client->receive(&data, &err));
+    assert(data.size() == 1 && data[0][0] == "disabled");
+    assert(existsRegular(dir / "w" / cfg.disabled_dir / "a.txt"));
+    assert(existsRegular(dir / "w" / cfg.disabled_dir / "b.txt"));
+
+    // Changes made behind the daemon's back show up through inotify.
+    writeFile(dir / "w" / "c.txt", "c");
+    bool seen = false;
+    for (int i = 0; i < 200 && !seen; i++) {
+        data.clear();
+        client->send({"LIST", w});
+        assert(client->receive(&data, &err));
+        for (const auto& row : data) {
+            seen = seen || (row.size() == 5 && row[4] == "c.txt" && row[0] == "enabled");
+        }
+        if (!seen) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+    assert(seen);
+
+    ft::Config other = cfg;
+    other.disabled_prefix = "~";
+    assert(!ft::DaemonClient::connect(sock, other));
+    other = cfg;
+    other.manifest = true;
+    assert(!ft::DaemonClient::connect(sock, other));
+    other = cfg;
+    other.follow_symlinks = false;
+    assert(!ft::DaemonClient::connect(sock, other));
+
+    client.reset();
+    ::kill(pid, SIGTERM);
+    int status = 0;
+    ::waitpid(pid, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    assert(!fs::exists(sock));
+
+    fs::remove_all(dir);
+}
+
 int main() {
     try {
         testDecorateUndecorate();
         testDisableEnableRoundtrip();
+        testToggleDanglingSymlink();
         testDisableWithPrefixSuffix();
         testListDirShowsOriginalNames();
+        testEntryTableColumns();
+        testNaturalNameOrder();
+        testScanDirStreamsMergedEntries();
+        testWalkTreeVisitsEveryDirectory();
+        testNameSelector();
+        testBatchIoMatchesSync();
+        testDeadlineScanPlaceholders();
+        testStuckProbesReplaced();
+        testSymlinkScanModes();
+        testTreeSizes();
+        testDisabledCountIndex();
+        testEntryNameIndex();
+        testNameSearch();
+        testRowFormatting();
+        testListFormatEscaping();
+        testMemoryBackend();
+        testSyscallBudgets();
+        testScanNameFilter();
+        testRunStats();
+        testTraceFile();
+        testStallWatchdog();
+        testManifestTracksMoves();
+        testDaemonPipelinedRequests();
     } catch (const std::exception& e) {
         std::cerr << "test failure: " << e.what() << "\n";
         return 1;